@@ -0,0 +1,65 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_TRANSCODER_PRIVATE_H
+#define __GST_TRANSCODER_PRIVATE_H
+
+#include "gsttranscoder.h"
+
+G_BEGIN_DECLS
+
+G_GNUC_INTERNAL
+GArray * gst_transcoder_segments_find_boundaries (const gchar * uri,
+                                                  guint n_segments,
+                                                  GError ** error);
+
+G_GNUC_INTERNAL
+gboolean gst_transcoder_segments_find_cut_keyframes (const gchar * uri,
+                                                     GstClockTime start,
+                                                     GstClockTime stop,
+                                                     GstClockTime * first_keyframe,
+                                                     GstClockTime * last_keyframe,
+                                                     GstCaps ** video_caps,
+                                                     GError ** error);
+
+G_GNUC_INTERNAL
+gboolean gst_transcoder_segments_check_compatible (GPtrArray * uris,
+                                                   gboolean * compatible,
+                                                   GError ** error);
+
+G_GNUC_INTERNAL
+gboolean gst_transcoder_segments_join            (GPtrArray * uris,
+                                                  const gchar * dest_uri,
+                                                  GstEncodingProfile * profile,
+                                                  GError ** error);
+
+G_GNUC_INTERNAL
+GstTranscoder * gst_transcoder_new_for_pipeline  (GstElement * pipeline,
+                                                  const gchar * source_uri,
+                                                  const gchar * dest_uri,
+                                                  GstEncodingProfile * profile,
+                                                  GMainContext * context);
+
+G_GNUC_INTERNAL
+GstElement * gst_transcoder_take_pipeline        (GstTranscoder * self);
+
+G_END_DECLS
+
+#endif
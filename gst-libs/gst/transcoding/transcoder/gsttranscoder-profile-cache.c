@@ -0,0 +1,274 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Process wide cache of deserialized encoding profiles: deserializing a
+ * target name loads and parses the .gep files from disk, so each profile
+ * string is only deserialized once and callers get copies of it. */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+
+#include "gsttranscoder.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_transcoder_profile_cache_debug);
+#define GST_CAT_DEFAULT gst_transcoder_profile_cache_debug
+
+/* Do not check the encoding target files more often than that */
+#define TARGETS_CHECK_INTERVAL (G_USEC_PER_SEC)
+
+static GMutex cache_lock;
+/* profile string -> GstEncodingProfile */
+static GHashTable *profiles = NULL;
+static gchar *targets_stamp = NULL;
+static gint64 last_targets_check = 0;
+static guint64 n_hits = 0;
+static guint64 n_misses = 0;
+
+static void
+checksum_target_files (GChecksum * checksum, const gchar * dirname)
+{
+  const gchar *name;
+  GStatBuf st;
+  GDir *dir = g_dir_open (dirname, 0, NULL);
+
+  if (!dir)
+    return;
+
+  while ((name = g_dir_read_name (dir))) {
+    gchar *path = g_build_filename (dirname, name, NULL);
+
+    if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
+      checksum_target_files (checksum, path);
+    } else if (g_str_has_suffix (name, ".gep") && !g_stat (path, &st)) {
+      gchar *entry = g_strdup_printf ("%s:%" G_GINT64_FORMAT ";", path,
+          (gint64) st.st_mtime);
+
+      g_checksum_update (checksum, (const guchar *) entry, -1);
+      g_free (entry);
+    }
+    g_free (path);
+  }
+
+  g_dir_close (dir);
+}
+
+/**
+ * gst_transcoder_checksum_encoding_targets:
+ * @checksum: A #GChecksum
+ *
+ * Feeds @checksum with the path and modification time of every encoding
+ * target file, in the directories of the GST_ENCODING_TARGET_PATH
+ * environment variable and in the user and system data directories, so
+ * that the resulting digest changes whenever an encoding target is added,
+ * removed or modified.
+ */
+void
+gst_transcoder_checksum_encoding_targets (GChecksum * checksum)
+{
+  gchar *dir;
+  const gchar *target_path;
+  const gchar *const *dirs;
+
+  g_return_if_fail (checksum);
+
+  target_path = g_getenv ("GST_ENCODING_TARGET_PATH");
+  if (target_path) {
+    guint i;
+    gchar **paths = g_strsplit (target_path, G_SEARCHPATH_SEPARATOR_S, -1);
+
+    for (i = 0; paths[i]; i++)
+      checksum_target_files (checksum, paths[i]);
+    g_strfreev (paths);
+  }
+
+  dir = g_build_filename (g_get_user_data_dir (), "gstreamer-1.0",
+      "encoding-profiles", NULL);
+  checksum_target_files (checksum, dir);
+  g_free (dir);
+
+  for (dirs = g_get_system_data_dirs (); *dirs; dirs++) {
+    dir = g_build_filename (*dirs, "gstreamer-1.0", "encoding-profiles",
+        NULL);
+    checksum_target_files (checksum, dir);
+    g_free (dir);
+  }
+}
+
+/* Identifies the state of the encoding target directories */
+static gchar *
+compute_targets_stamp (void)
+{
+  gchar *res;
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_MD5);
+
+  gst_transcoder_checksum_encoding_targets (checksum);
+  res = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return res;
+}
+
+/* Must be called with the cache lock */
+static void
+check_targets (void)
+{
+  gchar *stamp;
+  gint64 now = g_get_monotonic_time ();
+
+  if (last_targets_check && now - last_targets_check < TARGETS_CHECK_INTERVAL)
+    return;
+
+  last_targets_check = now;
+  stamp = compute_targets_stamp ();
+  if (g_strcmp0 (stamp, targets_stamp)) {
+    if (targets_stamp) {
+      GST_INFO ("Encoding targets changed, invalidating %u cached profiles",
+          g_hash_table_size (profiles));
+      g_hash_table_remove_all (profiles);
+    }
+
+    g_free (targets_stamp);
+    targets_stamp = stamp;
+  } else {
+    g_free (stamp);
+  }
+}
+
+static GstEncodingProfile *
+deserialize_profile (const gchar * profile_string)
+{
+  GstEncodingProfile *profile;
+  GValue value = G_VALUE_INIT;
+
+  g_value_init (&value, GST_TYPE_ENCODING_PROFILE);
+
+  if (!gst_value_deserialize (&value, profile_string)) {
+    g_value_unset (&value);
+
+    return NULL;
+  }
+
+  profile = g_value_dup_object (&value);
+  g_value_unset (&value);
+
+  return profile;
+}
+
+/**
+ * gst_transcoder_profile_cache_get:
+ * @profile_string: A serialized #GstEncodingProfile or the name of an
+ * encoding target, optionally followed by "/<profile name>"
+ *
+ * Gets the #GstEncodingProfile described by @profile_string. The string is
+ * only deserialized the first time, later calls return copies of the
+ * cached profile so each caller can modify its own. The cache is
+ * invalidated when the encoding target files change on disk.
+ *
+ * This function is thread safe.
+ *
+ * Returns: (transfer full) (nullable): A new copy of the profile, %NULL if
+ * @profile_string could not be deserialized
+ */
+GstEncodingProfile *
+gst_transcoder_profile_cache_get (const gchar * profile_string)
+{
+  GstEncodingProfile *profile;
+
+  g_return_val_if_fail (profile_string, NULL);
+
+  g_mutex_lock (&cache_lock);
+  if (!profiles) {
+    GST_DEBUG_CATEGORY_INIT (gst_transcoder_profile_cache_debug,
+        "gst-transcoder-profile-cache", 0, "GstTranscoder profile cache");
+    profiles = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_object_unref);
+  }
+  check_targets ();
+
+  profile = g_hash_table_lookup (profiles, profile_string);
+  if (profile) {
+    n_hits++;
+    profile = gst_encoding_profile_copy (profile);
+    g_mutex_unlock (&cache_lock);
+
+    return profile;
+  }
+  n_misses++;
+  g_mutex_unlock (&cache_lock);
+
+  GST_DEBUG ("Deserializing %s", profile_string);
+  profile = deserialize_profile (profile_string);
+  if (!profile)
+    return NULL;
+
+  g_mutex_lock (&cache_lock);
+  if (!g_hash_table_contains (profiles, profile_string))
+    g_hash_table_insert (profiles, g_strdup (profile_string),
+        gst_encoding_profile_copy (profile));
+  g_mutex_unlock (&cache_lock);
+
+  return profile;
+}
+
+/**
+ * gst_transcoder_profile_cache_clear:
+ *
+ * Drops all the cached profiles.
+ */
+void
+gst_transcoder_profile_cache_clear (void)
+{
+  g_mutex_lock (&cache_lock);
+  if (profiles)
+    g_hash_table_remove_all (profiles);
+  g_mutex_unlock (&cache_lock);
+}
+
+/**
+ * gst_transcoder_profile_cache_get_stats:
+ *
+ * Get the statistics of the profile cache, the returned
+ * `transcoder-profile-cache-stats` structure contains the following
+ * fields:
+ *
+ * - "hits" G_TYPE_UINT64: The number of lookups served from the cache
+ * - "misses" G_TYPE_UINT64: The number of lookups which had to
+ *   deserialize the profile
+ * - "size" G_TYPE_UINT: The number of profiles currently cached
+ *
+ * Returns: (transfer full): The statistics of the profile cache
+ */
+GstStructure *
+gst_transcoder_profile_cache_get_stats (void)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&cache_lock);
+  stats = gst_structure_new ("transcoder-profile-cache-stats",
+      "hits", G_TYPE_UINT64, n_hits,
+      "misses", G_TYPE_UINT64, n_misses,
+      "size", G_TYPE_UINT, profiles ? g_hash_table_size (profiles) : 0, NULL);
+  g_mutex_unlock (&cache_lock);
+
+  return stats;
+}
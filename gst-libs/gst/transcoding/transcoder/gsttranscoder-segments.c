@@ -0,0 +1,783 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Helpers to transcode a file as several segments in parallel: the input
+ * is split at video keyframes so that each segment can be decoded on its
+ * own, and the transcoded segments are concatenated back without
+ * re-encoding. */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gsttranscoder-private.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gst_transcoder_debug);
+#define GST_CAT_DEFAULT gst_transcoder_debug
+
+/* How long the segments have to expose their streams before joining them */
+#define JOIN_EXPOSE_TIMEOUT (30 * GST_SECOND)
+
+/* Waits at most @timeout for a message of @types, returns %FALSE on errors
+ * and on timeout */
+static gboolean
+wait_for_message (GstElement * pipeline, GstMessageType types,
+    GstClockTime timeout, GError ** error)
+{
+  GstMessage *msg;
+  gboolean res = TRUE;
+  GstBus *bus = gst_element_get_bus (pipeline);
+
+  msg = gst_bus_timed_pop_filtered (bus, timeout, types | GST_MESSAGE_ERROR);
+
+  if (!msg) {
+    GST_WARNING_OBJECT (pipeline, "Timed out after %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (timeout));
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Timed out waiting for %s", gst_message_type_get_name (types));
+    gst_object_unref (bus);
+
+    return FALSE;
+  }
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    GError *err = NULL;
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    GST_WARNING_OBJECT (pipeline, "Error: %s (%s)", err->message, debug);
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "%s", err->message);
+
+    g_clear_error (&err);
+    g_free (debug);
+    res = FALSE;
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  return res;
+}
+
+static void
+source_pad_added_cb (GstElement * src, GstPad * pad, GstElement * parsebin)
+{
+  GstPad *sinkpad = gst_element_get_static_pad (parsebin, "sink");
+
+  if (!gst_pad_is_linked (sinkpad) &&
+      gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)
+    GST_ELEMENT_ERROR (src, CORE, PAD, (NULL),
+        ("Could not link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, pad,
+            sinkpad));
+
+  gst_object_unref (sinkpad);
+}
+
+static const gchar *
+get_media_type (GstPad * pad)
+{
+  const gchar *media_type = "other";
+  GstCaps *caps = gst_pad_query_caps (pad, NULL);
+
+  if (!gst_caps_is_empty (caps) && !gst_caps_is_any (caps)) {
+    const gchar *name =
+        gst_structure_get_name (gst_caps_get_structure (caps, 0));
+
+    if (g_str_has_prefix (name, "video/"))
+      media_type = "video";
+    else if (g_str_has_prefix (name, "audio/"))
+      media_type = "audio";
+  }
+  gst_caps_unref (caps);
+
+  return media_type;
+}
+
+/*********** Keyframe boundaries ***********/
+typedef struct
+{
+  GMutex lock;
+
+  GstElement *pipeline;
+  gboolean has_video;
+  /* The parsed video stream, to get its caps once prerolled */
+  GstPad *video_pad;
+  /* Whether the next buffer is the first one after a seek */
+  gboolean armed;
+  GstClockTime keyframe;
+} BoundariesProbe;
+
+static GstPadProbeReturn
+keyframe_probe_cb (GstPad * pad, GstPadProbeInfo * info,
+    BoundariesProbe * probe)
+{
+  GstBuffer *buffer;
+  GstEvent *event;
+  GstClockTime ts;
+
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP) {
+      g_mutex_lock (&probe->lock);
+      probe->armed = TRUE;
+      g_mutex_unlock (&probe->lock);
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  g_mutex_lock (&probe->lock);
+  if (probe->armed) {
+    ts = GST_BUFFER_PTS_IS_VALID (buffer) ? GST_BUFFER_PTS (buffer) :
+        GST_BUFFER_DTS (buffer);
+
+    event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0);
+    if (event) {
+      const GstSegment *segment;
+
+      gst_event_parse_segment (event, &segment);
+      ts = gst_segment_to_stream_time (segment, GST_FORMAT_TIME, ts);
+      gst_event_unref (event);
+    }
+
+    probe->keyframe = ts;
+    probe->armed = FALSE;
+  }
+  g_mutex_unlock (&probe->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+boundaries_pad_added_cb (GstElement * parsebin, GstPad * pad,
+    BoundariesProbe * probe)
+{
+  GstPad *sinkpad;
+  GstElement *sink = gst_element_factory_make ("fakesink", NULL);
+
+  g_object_set (sink, "sync", FALSE, NULL);
+  gst_bin_add (GST_BIN (probe->pipeline), sink);
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+
+  g_mutex_lock (&probe->lock);
+  if (!probe->has_video && !g_strcmp0 (get_media_type (pad), "video")) {
+    probe->has_video = TRUE;
+    probe->video_pad = gst_object_ref (pad);
+    gst_pad_add_probe (sinkpad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH,
+        (GstPadProbeCallback) keyframe_probe_cb, probe, NULL);
+  }
+  g_mutex_unlock (&probe->lock);
+
+  gst_pad_link (pad, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_element_sync_state_with_parent (sink);
+}
+
+/* Prerolls a parsing pipeline for @uri, returns the duration of the media
+ * or %GST_CLOCK_TIME_NONE on error */
+static GstClockTime
+probe_open (BoundariesProbe * probe, const gchar * uri, GError ** error)
+{
+  gint64 duration;
+  GstStateChangeReturn ret;
+  GstElement *src, *parsebin;
+
+  g_mutex_init (&probe->lock);
+  probe->keyframe = GST_CLOCK_TIME_NONE;
+  probe->pipeline = gst_pipeline_new ("segments-probe");
+
+  src = gst_element_factory_make ("urisourcebin", NULL);
+  parsebin = gst_element_factory_make ("parsebin", NULL);
+  if (!src || !parsebin) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Missing urisourcebin or parsebin, check your installation");
+    if (src)
+      gst_object_unref (src);
+    if (parsebin)
+      gst_object_unref (parsebin);
+
+    return GST_CLOCK_TIME_NONE;
+  }
+
+  g_object_set (src, "uri", uri, NULL);
+  gst_bin_add_many (GST_BIN (probe->pipeline), src, parsebin, NULL);
+  g_signal_connect (src, "pad-added", G_CALLBACK (source_pad_added_cb),
+      parsebin);
+  g_signal_connect (parsebin, "pad-added",
+      G_CALLBACK (boundaries_pad_added_cb), probe);
+
+  ret = gst_element_set_state (probe->pipeline, GST_STATE_PAUSED);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Could not open %s", uri);
+    return GST_CLOCK_TIME_NONE;
+  } else if (ret == GST_STATE_CHANGE_NO_PREROLL) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Live streams can not be split in segments");
+    return GST_CLOCK_TIME_NONE;
+  } else if (ret == GST_STATE_CHANGE_ASYNC &&
+      !wait_for_message (probe->pipeline, GST_MESSAGE_ASYNC_DONE,
+          GST_CLOCK_TIME_NONE, error)) {
+    return GST_CLOCK_TIME_NONE;
+  }
+
+  if (!gst_element_query_duration (probe->pipeline, GST_FORMAT_TIME,
+          &duration) || duration <= 0) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Could not get the duration of %s", uri);
+    return GST_CLOCK_TIME_NONE;
+  }
+
+  return duration;
+}
+
+static void
+probe_close (BoundariesProbe * probe)
+{
+  gst_element_set_state (probe->pipeline, GST_STATE_NULL);
+  gst_object_unref (probe->pipeline);
+  if (probe->video_pad)
+    gst_object_unref (probe->video_pad);
+  g_mutex_clear (&probe->lock);
+}
+
+/* Sets @keyframe to the video keyframe closest to @target in the direction
+ * given by the @snap flag, %GST_CLOCK_TIME_NONE if there is none. Returns
+ * %FALSE on errors */
+static gboolean
+probe_seek_keyframe (BoundariesProbe * probe, const gchar * uri,
+    GstClockTime target, GstSeekFlags snap, GstClockTime * keyframe,
+    GError ** error)
+{
+  g_mutex_lock (&probe->lock);
+  probe->armed = FALSE;
+  probe->keyframe = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&probe->lock);
+
+  if (!gst_element_seek_simple (probe->pipeline, GST_FORMAT_TIME,
+          GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT | snap, target)) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "%s is not seekable", uri);
+    return FALSE;
+  }
+
+  if (!wait_for_message (probe->pipeline, GST_MESSAGE_ASYNC_DONE,
+          GST_CLOCK_TIME_NONE, error))
+    return FALSE;
+
+  g_mutex_lock (&probe->lock);
+  *keyframe = probe->keyframe;
+  g_mutex_unlock (&probe->lock);
+
+  return TRUE;
+}
+
+/*
+ * gst_transcoder_segments_find_boundaries:
+ * @uri: The URI of the media to split
+ * @n_segments: The wanted number of segments
+ * @error: The error to set when the media can not be split
+ *
+ * Computes the boundaries of at most @n_segments segments of roughly the
+ * same duration, each starting on a video keyframe. Segments shorter than
+ * a GOP are merged with the previous one so fewer segments can be
+ * returned.
+ *
+ * Returns: (transfer full): The start time of each segment, followed by
+ * the duration of the media, %NULL on error.
+ */
+GArray *
+gst_transcoder_segments_find_boundaries (const gchar * uri, guint n_segments,
+    GError ** error)
+{
+  guint i;
+  GstClockTime duration;
+  GArray *boundaries = NULL;
+  GstClockTime boundary = 0;
+  BoundariesProbe probe = { {0,}, };
+
+  duration = probe_open (&probe, uri, error);
+  if (!GST_CLOCK_TIME_IS_VALID (duration))
+    goto done;
+
+  boundaries = g_array_new (FALSE, FALSE, sizeof (GstClockTime));
+  g_array_append_val (boundaries, boundary);
+
+  for (i = 1; i < n_segments; i++) {
+    GstClockTime target = gst_util_uint64_scale (duration, i, n_segments);
+
+    if (probe.has_video && !probe_seek_keyframe (&probe, uri, target,
+            GST_SEEK_FLAG_SNAP_BEFORE, &target, error))
+      goto failed;
+
+    if (!GST_CLOCK_TIME_IS_VALID (target) || target <= boundary) {
+      GST_DEBUG ("No new keyframe for segment %u", i);
+      continue;
+    }
+
+    GST_DEBUG ("Segment %u starts at %" GST_TIME_FORMAT, boundaries->len,
+        GST_TIME_ARGS (target));
+    boundary = target;
+    g_array_append_val (boundaries, boundary);
+  }
+
+  boundary = duration;
+  g_array_append_val (boundaries, boundary);
+
+done:
+  probe_close (&probe);
+
+  return boundaries;
+
+failed:
+  g_array_free (boundaries, TRUE);
+  boundaries = NULL;
+  goto done;
+}
+
+/*
+ * gst_transcoder_segments_find_cut_keyframes:
+ * @uri: The URI of the media to trim
+ * @start: The start of the range to keep
+ * @stop: The end of the range to keep, or %GST_CLOCK_TIME_NONE
+ * @first_keyframe: (out): The first video keyframe at or after @start
+ * @last_keyframe: (out): The last video keyframe at or before @stop, or
+ * the duration of the media when @stop is not set
+ * @video_caps: (out) (transfer full): The caps of the parsed video stream
+ * @error: The error to set when the media can not be probed
+ *
+ * Finds the GOPs fully contained in [@start, @stop] so that only the
+ * partial GOPs at the cut points need to be re-encoded.
+ *
+ * Returns: %TRUE if the media has a video stream with keyframes inside
+ * the range, %FALSE otherwise
+ */
+gboolean
+gst_transcoder_segments_find_cut_keyframes (const gchar * uri,
+    GstClockTime start, GstClockTime stop, GstClockTime * first_keyframe,
+    GstClockTime * last_keyframe, GstCaps ** video_caps, GError ** error)
+{
+  gboolean res = FALSE;
+  GstClockTime duration;
+  BoundariesProbe probe = { {0,}, };
+
+  *first_keyframe = *last_keyframe = GST_CLOCK_TIME_NONE;
+  *video_caps = NULL;
+
+  duration = probe_open (&probe, uri, error);
+  if (!GST_CLOCK_TIME_IS_VALID (duration) || !probe.has_video)
+    goto done;
+
+  if (!probe_seek_keyframe (&probe, uri, start, GST_SEEK_FLAG_SNAP_AFTER,
+          first_keyframe, error))
+    goto done;
+
+  if (GST_CLOCK_TIME_IS_VALID (stop) && stop < duration) {
+    if (!probe_seek_keyframe (&probe, uri, stop, GST_SEEK_FLAG_SNAP_BEFORE,
+            last_keyframe, error))
+      goto done;
+  } else {
+    *last_keyframe = duration;
+  }
+
+  res = GST_CLOCK_TIME_IS_VALID (*first_keyframe) &&
+      GST_CLOCK_TIME_IS_VALID (*last_keyframe) &&
+      *first_keyframe >= start && *first_keyframe < *last_keyframe;
+  if (res)
+    *video_caps = gst_pad_get_current_caps (probe.video_pad);
+
+  GST_DEBUG ("GOPs of [%" GST_TIME_FORMAT " - %" GST_TIME_FORMAT
+      "] can be copied: %d", GST_TIME_ARGS (*first_keyframe),
+      GST_TIME_ARGS (*last_keyframe), res);
+
+done:
+  probe_close (&probe);
+
+  return res;
+}
+
+/*
+ * gst_transcoder_segments_check_compatible:
+ * @uris: The URIs of the segments to concatenate
+ * @compatible: (out): Whether the video streams of all the segments have
+ * the same caps, codec data included
+ * @error: The error to set when a segment can not be probed
+ *
+ * Muxers do not accept caps changes in the middle of a stream, so GOPs
+ * copied from the source and re-encoded ones can only be concatenated when
+ * the encoder produced exactly the same stream parameters.
+ *
+ * Returns: %TRUE if all the segments could be probed, %FALSE otherwise
+ */
+gboolean
+gst_transcoder_segments_check_compatible (GPtrArray * uris,
+    gboolean * compatible, GError ** error)
+{
+  guint i;
+  gboolean res = TRUE;
+  GstCaps *first_caps = NULL;
+
+  *compatible = TRUE;
+  for (i = 0; i < uris->len && *compatible; i++) {
+    GstCaps *caps = NULL;
+    BoundariesProbe probe = { {0,}, };
+    const gchar *uri = g_ptr_array_index (uris, i);
+
+    if (!GST_CLOCK_TIME_IS_VALID (probe_open (&probe, uri, error))) {
+      probe_close (&probe);
+      res = FALSE;
+      break;
+    }
+
+    if (probe.has_video)
+      caps = gst_pad_get_current_caps (probe.video_pad);
+    probe_close (&probe);
+
+    if (!caps)
+      continue;
+
+    if (!first_caps) {
+      first_caps = caps;
+    } else {
+      *compatible = gst_caps_is_equal (first_caps, caps);
+      if (!*compatible)
+        GST_INFO ("Video of %s is %" GST_PTR_FORMAT ", not %" GST_PTR_FORMAT,
+            uri, caps, first_caps);
+      gst_caps_unref (caps);
+    }
+  }
+
+  if (first_caps)
+    gst_caps_unref (first_caps);
+
+  return res;
+}
+
+/*********** Segments joining ***********/
+typedef struct
+{
+  GMutex lock;
+
+  GstElement *pipeline;
+  GstElement *encodebin;
+  guint n_segments;
+  /* Number of segments that exposed all their streams */
+  guint n_exposed;
+  /* Whether the streams have been linked to the concat elements, any
+   * stream exposed later can not be joined anymore */
+  gboolean linked;
+  /* "<media type>-<index>" -> concat element */
+  GHashTable *concats;
+} JoinContext;
+
+/* A stream exposed by a segment, blocked until it gets linked */
+typedef struct
+{
+  GstPad *pad;
+  gchar *key;
+  gulong block_id;
+} JoinStream;
+
+typedef struct
+{
+  JoinContext *join;
+  guint index;
+
+  /* media type -> number of streams of that type exposed so far */
+  GHashTable *n_streams;
+  /* JoinStream, in the order they were exposed */
+  GPtrArray *streams;
+} JoinSource;
+
+static void
+join_stream_free (JoinStream * stream)
+{
+  if (stream->block_id)
+    gst_pad_remove_probe (stream->pad, stream->block_id);
+  gst_object_unref (stream->pad);
+  g_free (stream->key);
+  g_free (stream);
+}
+
+static GstElement *
+make_concat (JoinContext * join, GstPad * pad)
+{
+  GstCaps *caps;
+  GstPad *srcpad, *encpad = NULL;
+  GstElement *concat = gst_element_factory_make ("concat", NULL);
+
+  if (!concat)
+    return NULL;
+
+  gst_bin_add (GST_BIN (join->pipeline), concat);
+
+  caps = gst_pad_query_caps (pad, NULL);
+  g_signal_emit_by_name (join->encodebin, "request-pad", caps, &encpad);
+  gst_caps_unref (caps);
+  if (!encpad) {
+    gst_element_set_state (concat, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (join->pipeline), concat);
+
+    return NULL;
+  }
+
+  srcpad = gst_element_get_static_pad (concat, "src");
+  gst_pad_link (srcpad, encpad);
+  gst_object_unref (srcpad);
+  gst_object_unref (encpad);
+
+  gst_element_sync_state_with_parent (concat);
+
+  return concat;
+}
+
+static GstPadProbeReturn
+join_block_cb (GstPad * pad, GstPadProbeInfo * info, gpointer udata)
+{
+  return GST_PAD_PROBE_OK;
+}
+
+/* Streams are only linked once every segment exposed its own: concat
+ * plays its pads in the order they were requested, and a segment that
+ * does not have a stream must not get a pad that would never see EOS */
+static void
+join_pad_added_cb (GstElement * parsebin, GstPad * pad, JoinSource * source)
+{
+  guint index;
+  JoinStream *stream;
+  JoinContext *join = source->join;
+  const gchar *media_type = get_media_type (pad);
+
+  g_mutex_lock (&join->lock);
+  if (join->linked) {
+    g_mutex_unlock (&join->lock);
+    GST_ELEMENT_ERROR (parsebin, CORE, PAD, (NULL),
+        ("Segment %u exposed a %s stream after all streams were joined",
+            source->index, media_type));
+
+    return;
+  }
+
+  index = GPOINTER_TO_UINT (g_hash_table_lookup (source->n_streams,
+          media_type));
+  g_hash_table_insert (source->n_streams, (gpointer) media_type,
+      GUINT_TO_POINTER (index + 1));
+
+  stream = g_new0 (JoinStream, 1);
+  stream->pad = gst_object_ref (pad);
+  stream->key = g_strdup_printf ("%s-%u", media_type, index);
+  stream->block_id = gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BLOCK_DOWNSTREAM, join_block_cb, NULL, NULL);
+  g_ptr_array_add (source->streams, stream);
+  g_mutex_unlock (&join->lock);
+}
+
+static void
+join_no_more_pads_cb (GstElement * parsebin, JoinSource * source)
+{
+  gboolean all_exposed;
+  JoinContext *join = source->join;
+
+  g_mutex_lock (&join->lock);
+  all_exposed = ++join->n_exposed == join->n_segments;
+  g_mutex_unlock (&join->lock);
+
+  GST_DEBUG_OBJECT (parsebin, "Segment %u exposed all its streams",
+      source->index);
+
+  if (all_exposed)
+    gst_element_post_message (join->pipeline,
+        gst_message_new_application (GST_OBJECT (parsebin),
+            gst_structure_new_empty ("segments-exposed")));
+}
+
+/* Links the streams of every segment to their concat element, in the
+ * segments order, and unblocks them */
+static gboolean
+join_link_streams (JoinContext * join, JoinSource * sources, GError ** error)
+{
+  guint i, j;
+  gboolean res = TRUE;
+
+  g_mutex_lock (&join->lock);
+  join->linked = TRUE;
+  g_mutex_unlock (&join->lock);
+
+  for (i = 0; i < join->n_segments && res; i++) {
+    for (j = 0; j < sources[i].streams->len && res; j++) {
+      GstPad *sinkpad = NULL;
+      JoinStream *stream = g_ptr_array_index (sources[i].streams, j);
+      GstElement *concat = g_hash_table_lookup (join->concats, stream->key);
+
+      if (!concat) {
+        concat = make_concat (join, stream->pad);
+        if (concat)
+          g_hash_table_insert (join->concats, g_strdup (stream->key),
+              concat);
+      }
+
+      if (concat)
+        sinkpad = gst_element_get_request_pad (concat, "sink_%u");
+
+      if (!sinkpad || gst_pad_link (stream->pad, sinkpad) != GST_PAD_LINK_OK) {
+        g_set_error (error, GST_TRANSCODER_ERROR,
+            GST_TRANSCODER_ERROR_FAILED,
+            "Could not concatenate stream %s of segment %u", stream->key, i);
+        res = FALSE;
+      }
+
+      if (sinkpad)
+        gst_object_unref (sinkpad);
+    }
+  }
+
+  if (!res)
+    return FALSE;
+
+  for (i = 0; i < join->n_segments; i++) {
+    for (j = 0; j < sources[i].streams->len; j++) {
+      JoinStream *stream = g_ptr_array_index (sources[i].streams, j);
+
+      gst_pad_remove_probe (stream->pad, stream->block_id);
+      stream->block_id = 0;
+    }
+  }
+
+  return TRUE;
+}
+
+/*
+ * gst_transcoder_segments_join:
+ * @uris: The URIs of the segments to concatenate, in order
+ * @dest_uri: The URI to write the result to
+ * @profile: The #GstEncodingProfile the segments have been encoded with
+ * @error: The error to set when joining fails
+ *
+ * Concatenates the streams of the segments and muxes them into
+ * @dest_uri. The encoded streams are only parsed and remuxed by encodebin,
+ * they are not re-encoded. A stream missing from some segments is made of
+ * the segments that have it; joining fails if a segment does not expose
+ * its streams within 30 seconds.
+ *
+ * Returns: %TRUE on success, %FALSE otherwise
+ */
+gboolean
+gst_transcoder_segments_join (GPtrArray * uris, const gchar * dest_uri,
+    GstEncodingProfile * profile, GError ** error)
+{
+  guint i;
+  GstElement *sink;
+  JoinSource *sources;
+  gboolean res = FALSE;
+  JoinContext join = { {0,}, };
+
+  g_mutex_init (&join.lock);
+  join.n_segments = uris->len;
+  join.concats = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      NULL);
+  join.pipeline = gst_pipeline_new ("segments-join");
+  sources = g_new0 (JoinSource, uris->len);
+
+  join.encodebin = gst_element_factory_make ("encodebin", NULL);
+  if (!join.encodebin) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Missing encodebin, check your installation");
+    goto done;
+  }
+
+  gst_bin_add (GST_BIN (join.pipeline), join.encodebin);
+  g_object_set (join.encodebin, "profile", profile, NULL);
+
+  sink = gst_element_make_from_uri (GST_URI_SINK, dest_uri, NULL, error);
+  if (!sink)
+    goto done;
+
+  gst_bin_add (GST_BIN (join.pipeline), sink);
+  if (!gst_element_link (join.encodebin, sink)) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Could not link encodebin to %s", dest_uri);
+    goto done;
+  }
+
+  for (i = 0; i < uris->len; i++) {
+    GstElement *src = gst_element_factory_make ("urisourcebin", NULL);
+    GstElement *parsebin = gst_element_factory_make ("parsebin", NULL);
+
+    sources[i].join = &join;
+    sources[i].index = i;
+    sources[i].n_streams = g_hash_table_new (g_str_hash, g_str_equal);
+    sources[i].streams =
+        g_ptr_array_new_with_free_func ((GDestroyNotify) join_stream_free);
+
+    if (!src || !parsebin) {
+      g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+          "Missing urisourcebin or parsebin, check your installation");
+      if (src)
+        gst_object_unref (src);
+      if (parsebin)
+        gst_object_unref (parsebin);
+
+      goto done;
+    }
+
+    g_object_set (src, "uri", g_ptr_array_index (uris, i), NULL);
+    gst_bin_add_many (GST_BIN (join.pipeline), src, parsebin, NULL);
+    g_signal_connect (src, "pad-added", G_CALLBACK (source_pad_added_cb),
+        parsebin);
+    g_signal_connect (parsebin, "pad-added", G_CALLBACK (join_pad_added_cb),
+        &sources[i]);
+    g_signal_connect (parsebin, "no-more-pads",
+        G_CALLBACK (join_no_more_pads_cb), &sources[i]);
+  }
+
+  if (gst_element_set_state (join.pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "Could not start joining the segments into %s", dest_uri);
+    goto done;
+  }
+
+  if (!wait_for_message (join.pipeline, GST_MESSAGE_APPLICATION,
+          JOIN_EXPOSE_TIMEOUT, error) ||
+      !join_link_streams (&join, sources, error))
+    goto done;
+
+  res = wait_for_message (join.pipeline, GST_MESSAGE_EOS,
+      GST_CLOCK_TIME_NONE, error);
+
+done:
+  gst_element_set_state (join.pipeline, GST_STATE_NULL);
+
+  for (i = 0; i < uris->len; i++) {
+    if (sources[i].n_streams)
+      g_hash_table_unref (sources[i].n_streams);
+    if (sources[i].streams)
+      g_ptr_array_unref (sources[i].streams);
+  }
+  gst_object_unref (join.pipeline);
+  g_free (sources);
+  g_hash_table_unref (join.concats);
+  g_mutex_clear (&join.lock);
+
+  return res;
+}
@@ -29,9 +29,12 @@
 #  include "config.h"
 #endif
 
+#include <glib/gstdio.h>
+
 #include "gsttranscoder.h"
+#include "gsttranscoder-private.h"
 
-GST_DEBUG_CATEGORY_STATIC (gst_transcoder_debug);
+GST_DEBUG_CATEGORY (gst_transcoder_debug);
 #define GST_CAT_DEFAULT gst_transcoder_debug
 
 #define DEFAULT_URI NULL
@@ -39,6 +42,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_transcoder_debug);
 #define DEFAULT_DURATION GST_CLOCK_TIME_NONE
 #define DEFAULT_POSITION_UPDATE_INTERVAL_MS 100
 #define DEFAULT_AVOID_REENCODING   FALSE
+#define DEFAULT_PACING GST_TRANSCODER_PACING_CPU_BUDGET
+#define DEFAULT_PARALLEL_SEGMENTS 1
 
 GQuark
 gst_transcoder_error_quark (void)
@@ -63,6 +68,15 @@ enum
   PROP_PIPELINE,
   PROP_POSITION_UPDATE_INTERVAL,
   PROP_AVOID_REENCODING,
+  PROP_PACING,
+  PROP_CPU_WEIGHT,
+  PROP_PARALLEL_SEGMENTS,
+  PROP_MAIN_CONTEXT,
+  PROP_STREAM_SELECTION,
+  PROP_PSI_PATH,
+  PROP_CPU_PRESSURE_THRESHOLD,
+  PROP_IO_PRESSURE_THRESHOLD,
+  PROP_MEMORY_PRESSURE_THRESHOLD,
   PROP_LAST
 };
 
@@ -73,6 +87,7 @@ enum
   SIGNAL_DONE,
   SIGNAL_ERROR,
   SIGNAL_WARNING,
+  SIGNAL_CPU_THROTTLE_STATS,
   SIGNAL_LAST
 };
 
@@ -97,12 +112,19 @@ struct _GstTranscoder
 
   GstElement *transcodebin;
   GstBus *bus;
+  GSource *bus_source;
   GstState target_state, current_state;
   gboolean is_live, is_eos;
   GSource *tick_source, *ready_timeout_source;
 
   guint position_update_interval_ms;
   gint wanted_cpu_usage;
+  guint cpu_weight;
+  GstTranscoderPacing pacing;
+  guint parallel_segments;
+  /* Whether this transcoder runs one of the ranges of a parent splitting
+   * its source, it then transcodes its range itself */
+  gboolean is_segment;
 
   GstClockTime last_duration;
 };
@@ -132,6 +154,8 @@ static void gst_transcoder_get_property (GObject * object, guint prop_id,
 static void gst_transcoder_constructed (GObject * object);
 
 static gpointer gst_transcoder_main (gpointer data);
+static void attach_bus_watch (GstTranscoder * self);
+static void detach_bus_watch (GstTranscoder * self);
 
 static gboolean gst_transcoder_set_position_update_interval_internal (gpointer
     user_data);
@@ -157,6 +181,77 @@ gst_transcoder_set_cpu_usage (GstTranscoder * self, gint cpu_usage)
   GST_OBJECT_UNLOCK (self);
 }
 
+/**
+ * gst_transcoder_set_cpu_weight:
+ * @self: The GstTranscoder to set the CPU weight on.
+ * @cpu_weight: The weight of the transcoder in the process wide CPU budget,
+ * or 0 to use its own budget as set with gst_transcoder_set_cpu_usage().
+ *
+ * Makes @self share the process wide CPU budget set with
+ * gst_transcoder_set_shared_cpu_usage() with all the other transcoders
+ * having a non zero weight. Transcoders with a higher weight get a bigger
+ * share, while the CPU they do not use is given to the others.
+ */
+void
+gst_transcoder_set_cpu_weight (GstTranscoder * self, guint cpu_weight)
+{
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  GST_OBJECT_LOCK (self);
+  self->cpu_weight = cpu_weight;
+  if (self->transcodebin)
+    g_object_set (self->transcodebin, "cpu-weight", cpu_weight, NULL);
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_transcoder_get_cpu_weight:
+ * @self: The GstTranscoder to get the CPU weight from.
+ *
+ * Returns: The weight of @self in the process wide CPU budget, 0 if it uses
+ * its own budget.
+ */
+guint
+gst_transcoder_get_cpu_weight (GstTranscoder * self)
+{
+  guint cpu_weight;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER (self), 0);
+
+  GST_OBJECT_LOCK (self);
+  cpu_weight = self->cpu_weight;
+  GST_OBJECT_UNLOCK (self);
+
+  return cpu_weight;
+}
+
+/**
+ * gst_transcoder_set_shared_cpu_usage:
+ * @self: A GstTranscoder
+ * @cpu_usage: The percentage of the CPU shared between all the transcoders
+ * of the process that have a CPU weight.
+ *
+ * Sets the process wide CPU budget split between the transcoders which have
+ * a CPU weight set with gst_transcoder_set_cpu_weight(). This affects all
+ * the transcoders of the process, not only @self.
+ */
+void
+gst_transcoder_set_shared_cpu_usage (GstTranscoder * self, gint cpu_usage)
+{
+  GObject *governor = NULL;
+
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  g_object_get (self->transcodebin, "cpu-governor", &governor, NULL);
+  if (!governor) {
+    GST_ERROR_OBJECT (self, "No CPU governor available");
+    return;
+  }
+
+  g_object_set (governor, "cpu-usage", cpu_usage, NULL);
+  g_object_unref (governor);
+}
+
 static void
 gst_transcoder_init (GstTranscoder * self)
 {
@@ -166,9 +261,9 @@ gst_transcoder_init (GstTranscoder * self)
 
   g_cond_init (&self->cond);
 
-  self->context = g_main_context_new ();
-  self->loop = g_main_loop_new (self->context, FALSE);
   self->wanted_cpu_usage = 100;
+  self->pacing = DEFAULT_PACING;
+  self->parallel_segments = DEFAULT_PARALLEL_SEGMENTS;
 
   self->position_update_interval_ms = DEFAULT_POSITION_UPDATE_INTERVAL_MS;
 
@@ -217,8 +312,9 @@ gst_transcoder_class_init (GstTranscoderClass * klass)
 
   param_specs[PROP_PIPELINE] =
       g_param_spec_object ("pipeline", "Pipeline",
-      "GStreamer pipeline that is used",
-      GST_TYPE_ELEMENT, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+      "GStreamer pipeline that is used, a uritranscodebin to reuse when set",
+      GST_TYPE_ELEMENT,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
 
   param_specs[PROP_POSITION_UPDATE_INTERVAL] =
       g_param_spec_uint ("position-update-interval", "Position update interval",
@@ -232,6 +328,73 @@ gst_transcoder_class_init (GstTranscoderClass * klass)
       "Whether to re-encode portions of compatible video streams that lay on segment boundaries",
       DEFAULT_AVOID_REENCODING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  param_specs[PROP_PACING] =
+      g_param_spec_enum ("pacing", "Pacing",
+      "How the transcoding speed is paced", GST_TYPE_TRANSCODER_PACING,
+      DEFAULT_PACING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_CPU_WEIGHT] =
+      g_param_spec_uint ("cpu-weight", "CPU weight",
+      "Weight of the transcoder in the process wide CPU budget "
+      "(0 = use its own budget)", 0, G_MAXUINT, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_PARALLEL_SEGMENTS] =
+      g_param_spec_uint ("parallel-segments", "Parallel segments",
+      "Number of segments, split at keyframes, to transcode in parallel",
+      1, G_MAXUINT16, DEFAULT_PARALLEL_SEGMENTS,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstTranscoder:main-context:
+   *
+   * The #GMainContext to attach the bus watch and the position updates of
+   * the transcoder to. When %NULL, the transcoder runs its own thread with
+   * its own context, otherwise the caller is responsible for iterating the
+   * context, and the transcoder must be disposed of from the thread
+   * iterating it. gst_transcoder_run() can then not be called from that
+   * thread, use gst_transcoder_run_async() instead.
+   */
+  param_specs[PROP_MAIN_CONTEXT] =
+      g_param_spec_boxed ("main-context", "Main context",
+      "The GMainContext to run the transcoder from, NULL for its own thread",
+      G_TYPE_MAIN_CONTEXT,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_STREAM_SELECTION] =
+      g_param_spec_boxed ("stream-selection", "Stream selection",
+      "Selectors of the streams to transcode, NULL for all of them",
+      G_TYPE_STRV, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstTranscoder:psi-path:
+   *
+   * The directory containing the pressure stall information files, see
+   * gst_transcoder_set_pressure_thresholds(). %NULL for the default of the
+   * pipeline, which reads back as the directory it uses.
+   */
+  param_specs[PROP_PSI_PATH] =
+      g_param_spec_string ("psi-path", "PSI path",
+      "The directory containing the pressure stall information files, "
+      "NULL for the default", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_CPU_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("cpu-pressure-threshold", "CPU pressure threshold",
+      "Percentage of CPU stall time above which to back off (0 = disabled)",
+      0, 100, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_IO_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("io-pressure-threshold", "I/O pressure threshold",
+      "Percentage of I/O stall time above which to back off (0 = disabled)",
+      0, 100, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_MEMORY_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("memory-pressure-threshold",
+      "Memory pressure threshold",
+      "Percentage of memory stall time above which to back off "
+      "(0 = disabled)", 0, 100, 0,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (gobject_class, PROP_LAST, param_specs);
 
   signals[SIGNAL_POSITION_UPDATED] =
@@ -258,6 +421,20 @@ gst_transcoder_class_init (GstTranscoderClass * klass)
       g_signal_new ("warning", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS, 0, NULL,
       NULL, NULL, G_TYPE_NONE, 2, G_TYPE_ERROR, GST_TYPE_STRUCTURE);
+
+  /**
+   * GstTranscoder::cpu-throttle-stats:
+   * @transcoder: The #GstTranscoder
+   * @stats: The `cpu-throttle-stats` structure posted by the pipeline
+   *
+   * Periodically reports the state of the CPU throttling: the measured and
+   * target CPU usage, the time slept so far and an histogram of the sleep
+   * durations. See gst_cpu_throttling_clock_get_stats() for the fields.
+   */
+  signals[SIGNAL_CPU_THROTTLE_STATS] =
+      g_signal_new ("cpu-throttle-stats", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS, 0, NULL,
+      NULL, NULL, G_TYPE_NONE, 1, GST_TYPE_STRUCTURE);
 }
 
 static void
@@ -279,6 +456,11 @@ gst_transcoder_dispose (GObject * object)
     g_main_context_unref (self->context);
     self->context = NULL;
 
+  } else if (self->context) {
+    detach_bus_watch (self);
+
+    g_main_context_unref (self->context);
+    self->context = NULL;
   }
 
   G_OBJECT_CLASS (parent_class)->dispose (object);
@@ -300,6 +482,19 @@ gst_transcoder_finalize (GObject * object)
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
+/* A recycled pipeline keeps the settings of its previous job. The ones
+ * describing the job itself go back to their defaults, the uris, profile,
+ * cpu-usage and pacing being set right after. The filters, stream
+ * selection and pressure thresholds configure the pipeline for all its
+ * jobs and are kept. */
+static void
+reset_pipeline_settings (GstElement * pipeline)
+{
+  g_object_set (pipeline, "start-time", GST_CLOCK_TIME_NONE,
+      "stop-time", GST_CLOCK_TIME_NONE, "avoid-reencoding", FALSE,
+      "cpu-weight", 0, NULL);
+}
+
 static void
 gst_transcoder_constructed (GObject * object)
 {
@@ -307,18 +502,31 @@ gst_transcoder_constructed (GObject * object)
 
   GST_TRACE_OBJECT (self, "Constructed");
 
-  self->transcodebin =
-      gst_element_factory_make ("uritranscodebin", "uritranscodebin");
+  if (self->transcodebin) {
+    GST_DEBUG_OBJECT (self, "Reusing %" GST_PTR_FORMAT, self->transcodebin);
+    reset_pipeline_settings (self->transcodebin);
+  } else {
+    self->transcodebin =
+        gst_element_factory_make ("uritranscodebin", "uritranscodebin");
+  }
 
   g_object_set (self->transcodebin, "source-uri", self->source_uri,
       "dest-uri", self->dest_uri, "profile", self->profile,
-      "cpu-usage", self->wanted_cpu_usage, NULL);
-
-  GST_OBJECT_LOCK (self);
-  self->thread = g_thread_new ("GstTranscoder", gst_transcoder_main, self);
-  while (!self->loop || !g_main_loop_is_running (self->loop))
-    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
-  GST_OBJECT_UNLOCK (self);
+      "cpu-usage", self->wanted_cpu_usage, "pacing", self->pacing, NULL);
+
+  if (self->context) {
+    GST_DEBUG_OBJECT (self, "Using shared main context %p", self->context);
+    attach_bus_watch (self);
+  } else {
+    self->context = g_main_context_new ();
+    self->loop = g_main_loop_new (self->context, FALSE);
+
+    GST_OBJECT_LOCK (self);
+    self->thread = g_thread_new ("GstTranscoder", gst_transcoder_main, self);
+    while (!g_main_loop_is_running (self->loop))
+      g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+    GST_OBJECT_UNLOCK (self);
+  }
 
   G_OBJECT_CLASS (parent_class)->constructed (object);
 }
@@ -333,6 +541,12 @@ gst_transcoder_set_property (GObject * object, guint prop_id,
     case PROP_SIGNAL_DISPATCHER:
       self->signal_dispatcher = g_value_dup_object (value);
       break;
+    case PROP_MAIN_CONTEXT:
+      self->context = g_value_dup_boxed (value);
+      break;
+    case PROP_PIPELINE:
+      self->transcodebin = g_value_dup_object (value);
+      break;
     case PROP_SRC_URI:{
       GST_OBJECT_LOCK (self);
       g_free (self->source_uri);
@@ -367,6 +581,26 @@ gst_transcoder_set_property (GObject * object, guint prop_id,
       g_object_set (self->transcodebin, "avoid-reencoding",
           g_value_get_boolean (value), NULL);
       break;
+    case PROP_PACING:
+      gst_transcoder_set_pacing (self, g_value_get_enum (value));
+      break;
+    case PROP_CPU_WEIGHT:
+      gst_transcoder_set_cpu_weight (self, g_value_get_uint (value));
+      break;
+    case PROP_PARALLEL_SEGMENTS:
+      gst_transcoder_set_parallel_segments (self, g_value_get_uint (value));
+      break;
+    case PROP_STREAM_SELECTION:
+      gst_transcoder_set_stream_selection (self, g_value_get_boxed (value));
+      break;
+    case PROP_PSI_PATH:
+    case PROP_CPU_PRESSURE_THRESHOLD:
+    case PROP_IO_PRESSURE_THRESHOLD:
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+      /* uritranscodebin has the same properties */
+      g_object_set_property (G_OBJECT (self->transcodebin), pspec->name,
+          value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -436,6 +670,28 @@ gst_transcoder_get_property (GObject * object, guint prop_id,
       g_value_set_boolean (value, avoid_reencoding);
       break;
     }
+    case PROP_PACING:
+      g_value_set_enum (value, gst_transcoder_get_pacing (self));
+      break;
+    case PROP_CPU_WEIGHT:
+      g_value_set_uint (value, gst_transcoder_get_cpu_weight (self));
+      break;
+    case PROP_PARALLEL_SEGMENTS:
+      g_value_set_uint (value, gst_transcoder_get_parallel_segments (self));
+      break;
+    case PROP_MAIN_CONTEXT:
+      g_value_set_boxed (value, self->context);
+      break;
+    case PROP_STREAM_SELECTION:
+      g_value_take_boxed (value, gst_transcoder_get_stream_selection (self));
+      break;
+    case PROP_PSI_PATH:
+    case PROP_CPU_PRESSURE_THRESHOLD:
+    case PROP_IO_PRESSURE_THRESHOLD:
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+      g_object_get_property (G_OBJECT (self->transcodebin), pspec->name,
+          value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -871,6 +1127,44 @@ request_state_cb (G_GNUC_UNUSED GstBus * bus, GstMessage * msg,
             gst_element_state_get_name (state)), NULL);
 }
 
+typedef struct
+{
+  GstTranscoder *transcoder;
+  GstStructure *stats;
+} CpuThrottleStatsSignalData;
+
+static void
+cpu_throttle_stats_dispatch (gpointer user_data)
+{
+  CpuThrottleStatsSignalData *data = user_data;
+
+  g_signal_emit (data->transcoder, signals[SIGNAL_CPU_THROTTLE_STATS], 0,
+      data->stats);
+}
+
+static void
+cpu_throttle_stats_signal_data_free (CpuThrottleStatsSignalData * data)
+{
+  g_object_unref (data->transcoder);
+  gst_structure_free (data->stats);
+  g_free (data);
+}
+
+static void
+emit_cpu_throttle_stats (GstTranscoder * self, const GstStructure * stats)
+{
+  if (g_signal_handler_find (self, G_SIGNAL_MATCH_ID,
+          signals[SIGNAL_CPU_THROTTLE_STATS], 0, NULL, NULL, NULL) != 0) {
+    CpuThrottleStatsSignalData *data = g_new0 (CpuThrottleStatsSignalData, 1);
+
+    data->transcoder = g_object_ref (self);
+    data->stats = gst_structure_copy (stats);
+    gst_transcoder_signal_dispatcher_dispatch (self->signal_dispatcher, self,
+        cpu_throttle_stats_dispatch, data,
+        (GDestroyNotify) cpu_throttle_stats_signal_data_free);
+  }
+}
+
 static void
 element_cb (G_GNUC_UNUSED GstBus * bus, GstMessage * msg, gpointer user_data)
 {
@@ -878,7 +1172,9 @@ element_cb (G_GNUC_UNUSED GstBus * bus, GstMessage * msg, gpointer user_data)
   const GstStructure *s;
 
   s = gst_message_get_structure (msg);
-  if (gst_structure_has_name (s, "redirect")) {
+  if (gst_structure_has_name (s, "cpu-throttle-stats")) {
+    emit_cpu_throttle_stats (self, s);
+  } else if (gst_structure_has_name (s, "redirect")) {
     const gchar *new_location;
 
     new_location = gst_structure_get_string (s, "new-location");
@@ -912,29 +1208,16 @@ element_cb (G_GNUC_UNUSED GstBus * bus, GstMessage * msg, gpointer user_data)
 }
 
 
-static gpointer
-gst_transcoder_main (gpointer data)
+static void
+attach_bus_watch (GstTranscoder * self)
 {
-  GstTranscoder *self = GST_TRANSCODER (data);
   GstBus *bus;
-  GSource *source;
-  GSource *bus_source;
-
-  GST_TRACE_OBJECT (self, "Starting main thread");
-
-  g_main_context_push_thread_default (self->context);
-
-  source = g_idle_source_new ();
-  g_source_set_callback (source, (GSourceFunc) main_loop_running_cb, self,
-      NULL);
-  g_source_attach (source, self->context);
-  g_source_unref (source);
 
   self->bus = bus = gst_element_get_bus (self->transcodebin);
-  bus_source = gst_bus_create_watch (bus);
-  g_source_set_callback (bus_source, (GSourceFunc) gst_bus_async_signal_func,
-      NULL, NULL);
-  g_source_attach (bus_source, self->context);
+  self->bus_source = gst_bus_create_watch (bus);
+  g_source_set_callback (self->bus_source,
+      (GSourceFunc) gst_bus_async_signal_func, NULL, NULL);
+  g_source_attach (self->bus_source, self->context);
 
   g_signal_connect (G_OBJECT (bus), "message::error", G_CALLBACK (error_cb),
       self);
@@ -958,25 +1241,56 @@ gst_transcoder_main (gpointer data)
   self->current_state = GST_STATE_NULL;
   self->is_eos = FALSE;
   self->is_live = FALSE;
+}
 
-  GST_TRACE_OBJECT (self, "Starting main loop");
-  g_main_loop_run (self->loop);
-  GST_TRACE_OBJECT (self, "Stopped main loop");
+static void
+detach_bus_watch (GstTranscoder * self)
+{
+  /* Already detached when the pipeline was taken */
+  if (!self->bus_source)
+    return;
 
-  g_source_destroy (bus_source);
-  g_source_unref (bus_source);
-  gst_object_unref (bus);
+  g_source_destroy (self->bus_source);
+  g_source_unref (self->bus_source);
+  self->bus_source = NULL;
+  gst_object_unref (self->bus);
+  self->bus = NULL;
 
   remove_tick_source (self);
 
-  g_main_context_pop_thread_default (self->context);
-
   self->target_state = GST_STATE_NULL;
   self->current_state = GST_STATE_NULL;
   if (self->transcodebin) {
     gst_element_set_state (self->transcodebin, GST_STATE_NULL);
     g_clear_object (&self->transcodebin);
   }
+}
+
+static gpointer
+gst_transcoder_main (gpointer data)
+{
+  GstTranscoder *self = GST_TRANSCODER (data);
+  GSource *source;
+
+  GST_TRACE_OBJECT (self, "Starting main thread");
+
+  g_main_context_push_thread_default (self->context);
+
+  source = g_idle_source_new ();
+  g_source_set_callback (source, (GSourceFunc) main_loop_running_cb, self,
+      NULL);
+  g_source_attach (source, self->context);
+  g_source_unref (source);
+
+  attach_bus_watch (self);
+
+  GST_TRACE_OBJECT (self, "Starting main loop");
+  g_main_loop_run (self->loop);
+  GST_TRACE_OBJECT (self, "Stopped main loop");
+
+  detach_bus_watch (self);
+
+  g_main_context_pop_thread_default (self->context);
 
   GST_TRACE_OBJECT (self, "Stopped main thread");
 
@@ -995,26 +1309,6 @@ gst_transcoder_init_once (G_GNUC_UNUSED gpointer user_data)
   return NULL;
 }
 
-static GstEncodingProfile *
-create_encoding_profile (const gchar * pname)
-{
-  GstEncodingProfile *profile;
-  GValue value = G_VALUE_INIT;
-
-  g_value_init (&value, GST_TYPE_ENCODING_PROFILE);
-
-  if (!gst_value_deserialize (&value, pname)) {
-    g_value_reset (&value);
-
-    return NULL;
-  }
-
-  profile = g_value_dup_object (&value);
-  g_value_reset (&value);
-
-  return profile;
-}
-
 /**
  * gst_transcoder_new:
  * @source_uri: The URI of the media stream to transcode
@@ -1031,7 +1325,7 @@ gst_transcoder_new (const gchar * source_uri,
 {
   GstEncodingProfile *profile;
 
-  profile = create_encoding_profile (encoding_profile);
+  profile = gst_transcoder_profile_cache_get (encoding_profile);
 
   return gst_transcoder_new_full (source_uri, dest_uri, profile, NULL);
 }
@@ -1052,6 +1346,31 @@ GstTranscoder *
 gst_transcoder_new_full (const gchar * source_uri,
     const gchar * dest_uri, GstEncodingProfile * profile,
     GstTranscoderSignalDispatcher * signal_dispatcher)
+{
+  return gst_transcoder_new_with_main_context (source_uri, dest_uri, profile,
+      signal_dispatcher, NULL);
+}
+
+/**
+ * gst_transcoder_new_with_main_context:
+ * @source_uri: The URI of the media stream to transcode
+ * @dest_uri: The URI of the destination of the transcoded stream
+ * @profile: The #GstEncodingProfile defining the output format
+ * @signal_dispatcher: (allow-none): The #GstTranscoderSignalDispatcher to be
+ * used to dispatch the various signals.
+ * @context: (allow-none): The #GMainContext to run the transcoder from, or
+ * %NULL for the transcoder to run its own thread
+ *
+ * Creates a transcoder without a thread of its own when @context is not
+ * %NULL, many transcoders can then share the same context, see
+ * #GstTranscoder:main-context.
+ *
+ * Returns: a new #GstTranscoder instance
+ */
+GstTranscoder *
+gst_transcoder_new_with_main_context (const gchar * source_uri,
+    const gchar * dest_uri, GstEncodingProfile * profile,
+    GstTranscoderSignalDispatcher * signal_dispatcher, GMainContext * context)
 {
   static GOnce once = G_ONCE_INIT;
 
@@ -1062,12 +1381,56 @@ gst_transcoder_new_full (const gchar * source_uri,
 
   return g_object_new (GST_TYPE_TRANSCODER, "src-uri", source_uri,
       "dest-uri", dest_uri, "profile", profile,
-      "signal-dispatcher", signal_dispatcher, NULL);
+      "signal-dispatcher", signal_dispatcher, "main-context", context, NULL);
+}
+
+/* The pipeline comes from gst_transcoder_take_pipeline(), the library is
+ * initialized already */
+GstTranscoder *
+gst_transcoder_new_for_pipeline (GstElement * pipeline,
+    const gchar * source_uri, const gchar * dest_uri,
+    GstEncodingProfile * profile, GMainContext * context)
+{
+  g_return_val_if_fail (pipeline, NULL);
+  g_return_val_if_fail (source_uri, NULL);
+  g_return_val_if_fail (dest_uri, NULL);
+
+  return g_object_new (GST_TYPE_TRANSCODER, "src-uri", source_uri,
+      "dest-uri", dest_uri, "profile", profile, "main-context", context,
+      "pipeline", pipeline, NULL);
+}
+
+/* Stops @self and takes its pipeline back in READY for a next transcoder
+ * to reuse it. Only for transcoders running from a shared main context,
+ * from that context */
+GstElement *
+gst_transcoder_take_pipeline (GstTranscoder * self)
+{
+  GstBus *bus;
+  GstElement *pipeline;
+
+  g_return_val_if_fail (!self->loop, NULL);
+
+  if (!self->transcodebin || gst_element_set_state (self->transcodebin,
+          GST_STATE_READY) == GST_STATE_CHANGE_FAILURE)
+    return NULL;
+
+  pipeline = self->transcodebin;
+  self->transcodebin = NULL;
+  bus = gst_object_ref (self->bus);
+  detach_bus_watch (self);
+
+  /* The messages of this run are not for the next transcoder */
+  gst_bus_set_flushing (bus, TRUE);
+  gst_bus_set_flushing (bus, FALSE);
+  gst_object_unref (bus);
+
+  return pipeline;
 }
 
 typedef struct
 {
-  GError **user_error;
+  GError *user_error;
   GMutex m;
   GCond cond;
 
@@ -1081,8 +1444,9 @@ _error_cb (GstTranscoder * self, GError * error, GstStructure * details,
 {
   g_mutex_lock (&data->m);
   data->done = TRUE;
-  if (data->user_error && (*data->user_error) == NULL)
-    g_propagate_error (data->user_error, error);
+  /* The error belongs to the emitter */
+  if (!data->user_error)
+    data->user_error = g_error_copy (error);
   g_cond_broadcast (&data->cond);
   g_mutex_unlock (&data->m);
 }
@@ -1104,12 +1468,33 @@ _done_cb (GstTranscoder * self, RunSyncData * data)
  * Run the transcoder task synchonously. You can connect
  * to the 'position' signal to get information about the
  * progress of the transcoding.
+ *
+ * When the transcoder runs from a shared #GstTranscoder:main-context, this
+ * must not be called from the thread iterating that context: nothing
+ * would dispatch the end of the transcoding while it blocks. It fails
+ * with an error when called from a callback of that context, use
+ * gst_transcoder_run_async() there.
+ *
+ * Returns: %TRUE on success, %FALSE if transcoding failed or could not
+ * be started
  */
 gboolean
 gst_transcoder_run (GstTranscoder * self, GError ** error)
 {
   RunSyncData data = { 0, };
 
+  g_return_val_if_fail (GST_IS_TRANSCODER (self), FALSE);
+
+  if (!self->loop && g_main_context_is_owner (self->context)) {
+    GST_ERROR_OBJECT (self, "Can not run synchronously from the thread "
+        "owning the main context");
+    g_set_error (error, GST_TRANSCODER_ERROR, GST_TRANSCODER_ERROR_FAILED,
+        "gst_transcoder_run() would deadlock in the thread iterating the "
+        "transcoder main context, use gst_transcoder_run_async()");
+
+    return FALSE;
+  }
+
   g_mutex_init (&data.m);
   g_cond_init (&data.cond);
 
@@ -1123,8 +1508,341 @@ gst_transcoder_run (GstTranscoder * self, GError ** error)
   }
   g_mutex_unlock (&data.m);
 
+  g_signal_handlers_disconnect_by_data (self, &data);
+
   if (data.user_error) {
-    g_propagate_error (error, *data.user_error);
+    g_propagate_error (error, data.user_error);
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;
+  guint remaining;
+  GError *error;
+} SegmentsRun;
+
+typedef struct
+{
+  SegmentsRun *run;
+  gboolean finished;
+} SegmentJob;
+
+static void
+segment_finished (SegmentJob * job, GError * error)
+{
+  SegmentsRun *run = job->run;
+
+  g_mutex_lock (&run->lock);
+  if (!job->finished) {
+    job->finished = TRUE;
+    run->remaining--;
+    if (error && !run->error)
+      run->error = g_error_copy (error);
+    g_cond_broadcast (&run->cond);
+  }
+  g_mutex_unlock (&run->lock);
+}
+
+static void
+segment_done_cb (GstTranscoder * child, SegmentJob * job)
+{
+  segment_finished (job, NULL);
+}
+
+static void
+segment_error_cb (GstTranscoder * child, GError * error,
+    GstStructure * details, SegmentJob * job)
+{
+  segment_finished (job, error);
+}
+
+static void
+remove_segment_files (GPtrArray * uris, const gchar * tmpdir)
+{
+  guint i;
+
+  for (i = 0; i < uris->len; i++) {
+    gchar *filename = g_filename_from_uri (g_ptr_array_index (uris, i), NULL,
+        NULL);
+
+    if (filename)
+      g_unlink (filename);
+    g_free (filename);
+  }
+
+  g_rmdir (tmpdir);
+}
+
+typedef struct
+{
+  GstClockTime start;
+  GstClockTime stop;
+  /* Whether the compressed video can be copied instead of re-encoded */
+  gboolean copy;
+} SegmentRange;
+
+static void
+get_range (GstTranscoder * self, GstClockTime * start, GstClockTime * stop)
+{
+  g_object_get (self->transcodebin, "start-time", start, "stop-time", stop,
+      NULL);
+}
+
+static gboolean
+has_smart_range (GstTranscoder * self)
+{
+  GstClockTime start, stop;
+
+  if (!gst_transcoder_get_avoid_reencoding (self))
+    return FALSE;
+
+  get_range (self, &start, &stop);
+
+  return GST_CLOCK_TIME_IS_VALID (start) || GST_CLOCK_TIME_IS_VALID (stop);
+}
+
+/* Splits the source at keyframes in ranges of similar durations */
+static GArray *
+plan_parallel_segments (GstTranscoder * self, GError ** error)
+{
+  guint i;
+  GArray *ranges;
+  GArray *boundaries = gst_transcoder_segments_find_boundaries
+      (self->source_uri, self->parallel_segments, error);
+
+  if (!boundaries)
+    return NULL;
+
+  ranges = g_array_new (FALSE, FALSE, sizeof (SegmentRange));
+  for (i = 0; i + 1 < boundaries->len; i++) {
+    SegmentRange range;
+
+    range.start = g_array_index (boundaries, GstClockTime, i);
+    range.stop = i + 2 < boundaries->len ?
+        g_array_index (boundaries, GstClockTime, i + 1) : GST_CLOCK_TIME_NONE;
+    range.copy = gst_transcoder_get_avoid_reencoding (self);
+    g_array_append_val (ranges, range);
+  }
+
+  self->last_duration = g_array_index (boundaries, GstClockTime,
+      boundaries->len - 1);
+  g_array_free (boundaries, TRUE);
+
+  return ranges;
+}
+
+/* Asks the encoder of @profile for the stream parameters of @source when
+ * it produces the same format */
+static void
+match_source_parameters (GstEncodingProfile * profile,
+    const GstStructure * source)
+{
+  guint i;
+  GstStructure *s;
+  GstCaps *format = gst_encoding_profile_get_format (profile);
+  const gchar *fields[] = { "profile", "level", "stream-format", "alignment",
+    NULL
+  };
+
+  if (!format || gst_caps_is_empty (format) || !gst_structure_has_name (source,
+          gst_structure_get_name (gst_caps_get_structure (format, 0)))) {
+    if (format)
+      gst_caps_unref (format);
+
+    return;
+  }
+
+  format = gst_caps_make_writable (format);
+  s = gst_caps_get_structure (format, 0);
+  for (i = 0; fields[i]; i++) {
+    if (gst_structure_has_field (source, fields[i]) &&
+        !gst_structure_has_field (s, fields[i]))
+      gst_structure_set_value (s, fields[i],
+          gst_structure_get_value (source, fields[i]));
+  }
+
+  gst_encoding_profile_set_format (profile, format);
+  gst_caps_unref (format);
+}
+
+/* Only the partial GOPs at the cut points are re-encoded, the GOPs in
+ * between are copied. The re-encoded parts are restricted to the
+ * resolution and framerate of the source, and encoded with its profile and
+ * level, so that they match the copied ones. Whether they really do is
+ * only known once encoded, see gst_transcoder_segments_check_compatible() */
+static GArray *
+plan_smart_render (GstTranscoder * self, GstEncodingProfile ** profile,
+    GError ** error)
+{
+  GList *tmp;
+  GstCaps *video_caps;
+  SegmentRange range;
+  GstClockTime start, stop, first, last;
+  GArray *ranges = g_array_new (FALSE, FALSE, sizeof (SegmentRange));
+
+  get_range (self, &start, &stop);
+  if (!GST_CLOCK_TIME_IS_VALID (start))
+    start = 0;
+
+  if (!gst_transcoder_segments_find_cut_keyframes (self->source_uri, start,
+          stop, &first, &last, &video_caps, error)) {
+    if (error && *error) {
+      g_array_free (ranges, TRUE);
+
+      return NULL;
+    }
+
+    GST_INFO_OBJECT (self, "No complete GOP to copy, re-encoding the range");
+    range.start = start;
+    range.stop = stop;
+    range.copy = FALSE;
+    g_array_append_val (ranges, range);
+
+    return ranges;
+  }
+
+  if (first > start) {
+    range.start = start;
+    range.stop = first;
+    range.copy = FALSE;
+    g_array_append_val (ranges, range);
+  }
+
+  range.start = first;
+  range.stop = GST_CLOCK_TIME_IS_VALID (stop) ? last : GST_CLOCK_TIME_NONE;
+  range.copy = TRUE;
+  g_array_append_val (ranges, range);
+
+  if (GST_CLOCK_TIME_IS_VALID (stop) && last < stop) {
+    range.start = last;
+    range.stop = stop;
+    range.copy = FALSE;
+    g_array_append_val (ranges, range);
+  }
+
+  GST_INFO_OBJECT (self, "Copying GOPs of [%" GST_TIME_FORMAT " - %"
+      GST_TIME_FORMAT "], re-encoding %u partial GOP(s)",
+      GST_TIME_ARGS (first), GST_TIME_ARGS (last), ranges->len - 1);
+
+  self->last_duration = (GST_CLOCK_TIME_IS_VALID (stop) ? stop : last) - start;
+
+  if (video_caps && !gst_caps_is_empty (video_caps)) {
+    const GstStructure *s = gst_caps_get_structure (video_caps, 0);
+    GstCaps *restriction = gst_caps_new_empty_simple ("video/x-raw");
+    const gchar *fields[] = { "width", "height", "framerate",
+      "pixel-aspect-ratio", NULL
+    };
+    guint i;
+
+    for (i = 0; fields[i]; i++) {
+      if (gst_structure_has_field (s, fields[i]))
+        gst_caps_set_value (restriction, fields[i],
+            gst_structure_get_value (s, fields[i]));
+    }
+
+    *profile = gst_encoding_profile_copy (self->profile);
+    if (GST_IS_ENCODING_CONTAINER_PROFILE (*profile)) {
+      for (tmp = (GList *)
+          gst_encoding_container_profile_get_profiles
+          (GST_ENCODING_CONTAINER_PROFILE (*profile)); tmp; tmp = tmp->next) {
+        GstCaps *current = gst_encoding_profile_get_restriction (tmp->data);
+
+        if (GST_IS_ENCODING_VIDEO_PROFILE (tmp->data)) {
+          if (!current)
+            gst_encoding_profile_set_restriction (tmp->data,
+                gst_caps_ref (restriction));
+          match_source_parameters (tmp->data, s);
+        }
+        if (current)
+          gst_caps_unref (current);
+      }
+    }
+    gst_caps_unref (restriction);
+  }
+  if (video_caps)
+    gst_caps_unref (video_caps);
+
+  return ranges;
+}
+
+/* Transcodes @ranges of the source in parallel, each with its own
+ * GstTranscoder writing to the URI at the same index in @uris. The ranges
+ * that are not copied use @reencode_profile when set */
+static gboolean
+transcode_ranges (GstTranscoder * self, GArray * ranges,
+    GstEncodingProfile * reencode_profile, GPtrArray * uris, GError ** error)
+{
+  guint i;
+  SegmentJob *jobs;
+  SegmentsRun run = { {0,}, };
+  GPtrArray *children = g_ptr_array_new_with_free_func (gst_object_unref);
+
+  g_mutex_init (&run.lock);
+  g_cond_init (&run.cond);
+
+  run.remaining = ranges->len;
+  jobs = g_new0 (SegmentJob, ranges->len);
+  for (i = 0; i < ranges->len; i++) {
+    GstElement *pipeline;
+    GstTranscoder *child;
+    gchar **selection, *psi_path;
+    gdouble cpu_pressure, io_pressure, memory_pressure;
+    SegmentRange *range = &g_array_index (ranges, SegmentRange, i);
+
+    child = gst_transcoder_new_full (self->source_uri,
+        g_ptr_array_index (uris, i), !range->copy && reencode_profile ?
+        reencode_profile : self->profile, NULL);
+    g_ptr_array_add (children, child);
+    child->is_segment = TRUE;
+
+    gst_transcoder_set_cpu_usage (child, self->wanted_cpu_usage);
+    gst_transcoder_set_cpu_weight (child, self->cpu_weight);
+    gst_transcoder_set_pacing (child, self->pacing);
+    gst_transcoder_set_avoid_reencoding (child, range->copy);
+    selection = gst_transcoder_get_stream_selection (self);
+    gst_transcoder_set_stream_selection (child,
+        (const gchar * const *) selection);
+    g_strfreev (selection);
+    gst_transcoder_get_pressure_thresholds (self, &cpu_pressure,
+        &io_pressure, &memory_pressure);
+    gst_transcoder_set_pressure_thresholds (child, cpu_pressure, io_pressure,
+        memory_pressure);
+    g_object_get (self, "psi-path", &psi_path, NULL);
+    g_object_set (child, "psi-path", psi_path, NULL);
+    g_free (psi_path);
+
+    pipeline = gst_transcoder_get_pipeline (child);
+    g_object_set (pipeline, "start-time", range->start, NULL);
+    if (GST_CLOCK_TIME_IS_VALID (range->stop))
+      g_object_set (pipeline, "stop-time", range->stop, NULL);
+    gst_object_unref (pipeline);
+
+    jobs[i].run = &run;
+    g_signal_connect (child, "done", G_CALLBACK (segment_done_cb), &jobs[i]);
+    g_signal_connect (child, "error", G_CALLBACK (segment_error_cb),
+        &jobs[i]);
+    gst_transcoder_run_async (child);
+  }
+
+  g_mutex_lock (&run.lock);
+  while (run.remaining)
+    g_cond_wait (&run.cond, &run.lock);
+  g_mutex_unlock (&run.lock);
+
+  /* Stops the children threads */
+  g_ptr_array_unref (children);
+  g_free (jobs);
+  g_mutex_clear (&run.lock);
+  g_cond_clear (&run.cond);
+
+  if (run.error) {
+    g_propagate_error (error, run.error);
 
     return FALSE;
   }
@@ -1132,6 +1850,125 @@ gst_transcoder_run (GstTranscoder * self, GError ** error)
   return TRUE;
 }
 
+/* Re-encodes the whole range of a smart render into the destination, for
+ * when the re-encoded partial GOPs can not be joined with the copied ones */
+static gboolean
+reencode_whole_range (GstTranscoder * self, GArray * ranges, GError ** error)
+{
+  gboolean res;
+  SegmentRange range;
+  GArray *whole = g_array_new (FALSE, FALSE, sizeof (SegmentRange));
+  GPtrArray *uris = g_ptr_array_new_with_free_func (g_free);
+
+  range.start = g_array_index (ranges, SegmentRange, 0).start;
+  range.stop = g_array_index (ranges, SegmentRange, ranges->len - 1).stop;
+  range.copy = FALSE;
+  g_array_append_val (whole, range);
+  g_ptr_array_add (uris, g_strdup (self->dest_uri));
+
+  GST_INFO_OBJECT (self, "Re-encoding [%" GST_TIME_FORMAT " - %"
+      GST_TIME_FORMAT "]", GST_TIME_ARGS (range.start),
+      GST_TIME_ARGS (range.stop));
+  res = transcode_ranges (self, whole, NULL, uris, error);
+
+  g_ptr_array_unref (uris);
+  g_array_free (whole, TRUE);
+
+  return res;
+}
+
+/* Transcodes ranges of the source in parallel and concatenates the results
+ * into the destination. Used to split the source at keyframes and for
+ * smart rendering */
+static gpointer
+gst_transcoder_segments_main (gpointer data)
+{
+  guint i, n_segments;
+  gchar *tmpdir = NULL;
+  GError *err = NULL;
+  gboolean joinable = TRUE;
+  GArray *ranges = NULL;
+  GstEncodingProfile *reencode_profile = NULL;
+  GPtrArray *uris = g_ptr_array_new_with_free_func (g_free);
+  GstTranscoder *self = GST_TRANSCODER (data);
+
+  if (self->parallel_segments > 1)
+    ranges = plan_parallel_segments (self, &err);
+  else
+    ranges = plan_smart_render (self, &reencode_profile, &err);
+  if (!ranges)
+    goto error;
+
+  n_segments = ranges->len;
+  GST_INFO_OBJECT (self, "Transcoding %u segments in parallel", n_segments);
+
+  /* A single range is written directly, no need to join it */
+  if (n_segments > 1) {
+    tmpdir = g_dir_make_tmp ("gst-transcoder-XXXXXX", &err);
+    if (!tmpdir)
+      goto error;
+  }
+
+  for (i = 0; i < n_segments; i++) {
+    if (tmpdir) {
+      gchar *basename = g_strdup_printf ("segment-%u", i);
+      gchar *filename = g_build_filename (tmpdir, basename, NULL);
+
+      g_ptr_array_add (uris, gst_filename_to_uri (filename, NULL));
+      g_free (filename);
+      g_free (basename);
+    } else {
+      g_ptr_array_add (uris, g_strdup (self->dest_uri));
+    }
+  }
+
+  if (!transcode_ranges (self, ranges, reencode_profile, uris, &err)) {
+    /* The encoder may not be able to match the source parameters */
+    if (!reencode_profile)
+      goto error;
+
+    GST_WARNING_OBJECT (self, "Smart rendering failed: %s", err->message);
+    g_clear_error (&err);
+    joinable = FALSE;
+  } else if (tmpdir && reencode_profile &&
+      !gst_transcoder_segments_check_compatible (uris, &joinable, &err)) {
+    goto error;
+  }
+
+  if (!joinable) {
+    GST_INFO_OBJECT (self, "Re-encoded GOPs do not match the copied ones");
+    if (!reencode_whole_range (self, ranges, &err))
+      goto error;
+  } else if (tmpdir && !gst_transcoder_segments_join (uris, self->dest_uri,
+          self->profile, &err)) {
+    goto error;
+  }
+
+  self->is_eos = TRUE;
+  if (g_signal_handler_find (self, G_SIGNAL_MATCH_ID,
+          signals[SIGNAL_DONE], 0, NULL, NULL, NULL) != 0) {
+    gst_transcoder_signal_dispatcher_dispatch (self->signal_dispatcher, self,
+        eos_dispatch, g_object_ref (self), (GDestroyNotify) g_object_unref);
+  }
+
+done:
+  if (tmpdir)
+    remove_segment_files (uris, tmpdir);
+  g_ptr_array_unref (uris);
+  g_free (tmpdir);
+  if (ranges)
+    g_array_free (ranges, TRUE);
+  if (reencode_profile)
+    g_object_unref (reencode_profile);
+  gst_object_unref (self);
+
+  return NULL;
+
+error:
+  emit_error (self, err, NULL);
+  goto done;
+}
+
 /**
  * gst_transcoder_run_async:
  * @self: The GstTranscoder to run
@@ -1155,6 +1992,16 @@ gst_transcoder_run_async (GstTranscoder * self)
     return;
   }
 
+  /* The copied ranges of a segment are remuxed by its own pipeline */
+  if (!self->is_segment && (self->parallel_segments > 1 ||
+          has_smart_range (self))) {
+    self->target_state = GST_STATE_PLAYING;
+    g_thread_unref (g_thread_new ("GstTranscoderSegments",
+            gst_transcoder_segments_main, gst_object_ref (self)));
+
+    return;
+  }
+
   self->target_state = GST_STATE_PLAYING;
   state_ret = gst_element_set_state (self->transcodebin, GST_STATE_PLAYING);
 
@@ -1348,6 +2195,14 @@ gst_transcoder_get_avoid_reencoding (GstTranscoder * self)
  * @self: The #GstTranscoder to set whether reencoding should be avoided or not.
  * @avoid_reencoding: %TRUE if the transcoder should try to avoid reencoding
  * streams where * reencoding is not strictly needed, %FALSE otherwise.
+ *
+ * When the pipeline has a "start-time" or "stop-time" set, only the
+ * partial GOPs at the cut points are re-encoded, with the resolution,
+ * framerate, profile and level of the source, while the complete GOPs in
+ * between are copied untouched when the source video format matches the
+ * profile. When the encoder does not produce exactly the stream parameters
+ * of the copied GOPs (their codec data included), muxers could not take
+ * them as one stream and the whole range is re-encoded instead.
  */
 void
 gst_transcoder_set_avoid_reencoding (GstTranscoder * self,
@@ -1358,6 +2213,196 @@ gst_transcoder_set_avoid_reencoding (GstTranscoder * self,
   g_object_set (self->transcodebin, "avoid-reencoding", avoid_reencoding, NULL);
 }
 
+/**
+ * gst_transcoder_get_pacing:
+ * @self: The #GstTranscoder to get the pacing mode from.
+ *
+ * Returns: The #GstTranscoderPacing mode used to pace the transcoding.
+ */
+GstTranscoderPacing
+gst_transcoder_get_pacing (GstTranscoder * self)
+{
+  GstTranscoderPacing pacing;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER (self), DEFAULT_PACING);
+
+  GST_OBJECT_LOCK (self);
+  pacing = self->pacing;
+  GST_OBJECT_UNLOCK (self);
+
+  return pacing;
+}
+
+/**
+ * gst_transcoder_set_pacing:
+ * @self: The #GstTranscoder to set the pacing mode on.
+ * @pacing: The #GstTranscoderPacing mode to use.
+ *
+ * Sets how the transcoding speed is paced. Batch jobs should use
+ * #GST_TRANSCODER_PACING_NONE so that the output is produced as fast
+ * as possible, without any clock synchronization.
+ */
+void
+gst_transcoder_set_pacing (GstTranscoder * self, GstTranscoderPacing pacing)
+{
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  GST_OBJECT_LOCK (self);
+  self->pacing = pacing;
+  GST_OBJECT_UNLOCK (self);
+
+  /* Values map 1:1 to the uritranscodebin GstTranscodePacing enum */
+  if (self->transcodebin)
+    g_object_set (self->transcodebin, "pacing", pacing, NULL);
+}
+
+/**
+ * gst_transcoder_get_parallel_segments:
+ * @self: The #GstTranscoder to get the number of parallel segments from.
+ *
+ * Returns: The number of segments the source is split in to be transcoded
+ * in parallel, 1 when it is transcoded in one go.
+ */
+guint
+gst_transcoder_get_parallel_segments (GstTranscoder * self)
+{
+  guint parallel_segments;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER (self), DEFAULT_PARALLEL_SEGMENTS);
+
+  GST_OBJECT_LOCK (self);
+  parallel_segments = self->parallel_segments;
+  GST_OBJECT_UNLOCK (self);
+
+  return parallel_segments;
+}
+
+/**
+ * gst_transcoder_set_parallel_segments:
+ * @self: The #GstTranscoder to set the number of parallel segments on.
+ * @parallel_segments: The number of segments to transcode in parallel.
+ *
+ * When @parallel_segments is more than 1, the source is split at video
+ * keyframes in up to @parallel_segments ranges of similar durations which
+ * are transcoded in parallel, each by its own pipeline seeking to its
+ * range. The transcoded segments are then concatenated and remuxed into
+ * the destination without being re-encoded.
+ *
+ * This only works with seekable, non live, sources. Encoders adding
+ * priming samples (for example most audio encoders) can introduce small
+ * gaps at the segments boundaries. Position updates are not emitted in
+ * that mode.
+ */
+void
+gst_transcoder_set_parallel_segments (GstTranscoder * self,
+    guint parallel_segments)
+{
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  GST_OBJECT_LOCK (self);
+  self->parallel_segments = MAX (parallel_segments, 1);
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_transcoder_get_stream_selection:
+ * @self: The #GstTranscoder to get the stream selection from.
+ *
+ * Returns: (transfer full) (nullable): The selectors of the streams to
+ * transcode, %NULL if all the streams are transcoded.
+ */
+gchar **
+gst_transcoder_get_stream_selection (GstTranscoder * self)
+{
+  gchar **selection = NULL;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER (self), NULL);
+
+  g_object_get (self->transcodebin, "stream-selection", &selection, NULL);
+
+  return selection;
+}
+
+/**
+ * gst_transcoder_set_stream_selection:
+ * @self: The #GstTranscoder to set the stream selection on.
+ * @selection: (nullable) (array zero-terminated=1): The selectors of the
+ * streams to transcode, %NULL to transcode all of them.
+ *
+ * Only the streams matching one of the selectors are transcoded, the
+ * others are dropped at the demuxer without being decoded. A selector is
+ * either "id:<stream-id>", a stream type ("video", "audio" or "text"), or
+ * a stream type followed by the index of the stream among the streams of
+ * that type ("audio:1") or by a language code ("audio:en").
+ *
+ * For example { "video:0", "audio:en", NULL } keeps the first video
+ * stream and the English audio streams only.
+ */
+void
+gst_transcoder_set_stream_selection (GstTranscoder * self,
+    const gchar * const *selection)
+{
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  g_object_set (self->transcodebin, "stream-selection", selection, NULL);
+}
+
+/**
+ * gst_transcoder_set_pressure_thresholds:
+ * @self: The #GstTranscoder to set the thresholds on.
+ * @cpu: The percentage of time some tasks of the host can be stalled
+ * waiting for a CPU, 0 to ignore the CPU pressure.
+ * @io: The percentage of time some tasks of the host can be stalled
+ * waiting for I/O, 0 to ignore the I/O pressure.
+ * @memory: The percentage of time some tasks of the host can be stalled
+ * waiting for memory, 0 to ignore the memory pressure.
+ *
+ * With the #GST_TRANSCODER_PACING_CPU_BUDGET pacing, slows the transcoding
+ * down when the pressure stall information of the host, as read from the
+ * #GstTranscoder:psi-path directory, exceeds one of the thresholds. This
+ * keeps the host responsive without having to lower the CPU usage of each
+ * transcoder. All the thresholds are 0 by default.
+ */
+void
+gst_transcoder_set_pressure_thresholds (GstTranscoder * self, gdouble cpu,
+    gdouble io, gdouble memory)
+{
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  g_object_set (self->transcodebin, "cpu-pressure-threshold", cpu,
+      "io-pressure-threshold", io, "memory-pressure-threshold", memory, NULL);
+}
+
+/**
+ * gst_transcoder_get_pressure_thresholds:
+ * @self: The #GstTranscoder to get the thresholds from.
+ * @cpu: (out) (optional): Return location for the CPU pressure threshold
+ * @io: (out) (optional): Return location for the I/O pressure threshold
+ * @memory: (out) (optional): Return location for the memory pressure
+ * threshold
+ *
+ * Gets the thresholds set with gst_transcoder_set_pressure_thresholds().
+ */
+void
+gst_transcoder_get_pressure_thresholds (GstTranscoder * self, gdouble * cpu,
+    gdouble * io, gdouble * memory)
+{
+  gdouble cpu_threshold, io_threshold, memory_threshold;
+
+  g_return_if_fail (GST_IS_TRANSCODER (self));
+
+  g_object_get (self->transcodebin, "cpu-pressure-threshold", &cpu_threshold,
+      "io-pressure-threshold", &io_threshold,
+      "memory-pressure-threshold", &memory_threshold, NULL);
+
+  if (cpu)
+    *cpu = cpu_threshold;
+  if (io)
+    *io = io_threshold;
+  if (memory)
+    *memory = memory_threshold;
+}
+
 #define C_ENUM(v) ((gint) v)
 #define C_FLAGS(v) ((guint) v)
 
@@ -1379,6 +2424,28 @@ gst_transcoder_error_get_type (void)
   return (GType) id;
 }
 
+GType
+gst_transcoder_pacing_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {C_ENUM (GST_TRANSCODER_PACING_NONE), "GST_TRANSCODER_PACING_NONE",
+        "none"},
+    {C_ENUM (GST_TRANSCODER_PACING_CPU_BUDGET),
+        "GST_TRANSCODER_PACING_CPU_BUDGET", "cpu-budget"},
+    {C_ENUM (GST_TRANSCODER_PACING_REALTIME),
+        "GST_TRANSCODER_PACING_REALTIME", "realtime"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp = g_enum_register_static ("GstTranscoderPacing", values);
+    g_once_init_leave (&id, tmp);
+  }
+
+  return (GType) id;
+}
+
 /**
  * gst_transcoder_error_get_name:
  * @error: a #GstTranscoderError
@@ -25,6 +25,26 @@ GQuark        gst_transcoder_error_quark    (void);
 GType         gst_transcoder_error_get_type (void);
 const gchar * gst_transcoder_error_get_name (GstTranscoderError error);
 
+/*********** Pacing definitions ************/
+#define      GST_TYPE_TRANSCODER_PACING                   (gst_transcoder_pacing_get_type ())
+
+/**
+ * GstTranscoderPacing:
+ * @GST_TRANSCODER_PACING_NONE: Transcode as fast as possible, without
+ * synchronizing on any clock.
+ * @GST_TRANSCODER_PACING_CPU_BUDGET: Throttle the transcoding so that it
+ * stays within the CPU usage set with gst_transcoder_set_cpu_usage().
+ * @GST_TRANSCODER_PACING_REALTIME: Transcode at the nominal playback speed
+ * of the stream.
+ */
+typedef enum {
+  GST_TRANSCODER_PACING_NONE = 0,
+  GST_TRANSCODER_PACING_CPU_BUDGET,
+  GST_TRANSCODER_PACING_REALTIME
+} GstTranscoderPacing;
+
+GType         gst_transcoder_pacing_get_type (void);
+
 /*********** GstTranscoder definition  ************/
 #define GST_TYPE_TRANSCODER (gst_transcoder_get_type ())
 #define GST_TRANSCODER(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_TRANSCODER, GstTranscoder))
@@ -48,12 +68,26 @@ GstTranscoder * gst_transcoder_new_full                   (const gchar * source_
                                                            GstEncodingProfile *profile,
                                                            GstTranscoderSignalDispatcher *signal_dispatcher);
 
+GstTranscoder * gst_transcoder_new_with_main_context      (const gchar * source_uri,
+                                                           const gchar * dest_uri,
+                                                           GstEncodingProfile *profile,
+                                                           GstTranscoderSignalDispatcher *signal_dispatcher,
+                                                           GMainContext * context);
+
 gboolean gst_transcoder_run                               (GstTranscoder *self,
                                                            GError ** error);
 
 void gst_transcoder_set_cpu_usage                         (GstTranscoder *self,
                                                            gint cpu_usage);
 
+void gst_transcoder_set_cpu_weight                        (GstTranscoder *self,
+                                                           guint cpu_weight);
+
+guint gst_transcoder_get_cpu_weight                       (GstTranscoder *self);
+
+void gst_transcoder_set_shared_cpu_usage                  (GstTranscoder *self,
+                                                           gint cpu_usage);
+
 void gst_transcoder_run_async                             (GstTranscoder *self);
 
 void gst_transcoder_set_position_update_interval          (GstTranscoder *self,
@@ -75,6 +109,27 @@ gboolean gst_transcoder_get_avoid_reencoding              (GstTranscoder * self)
 void gst_transcoder_set_avoid_reencoding                  (GstTranscoder * self,
                                                            gboolean avoid_reencoding);
 
+GstTranscoderPacing gst_transcoder_get_pacing             (GstTranscoder * self);
+void gst_transcoder_set_pacing                            (GstTranscoder * self,
+                                                           GstTranscoderPacing pacing);
+
+guint gst_transcoder_get_parallel_segments                (GstTranscoder * self);
+void gst_transcoder_set_parallel_segments                 (GstTranscoder * self,
+                                                           guint parallel_segments);
+
+gchar ** gst_transcoder_get_stream_selection              (GstTranscoder * self);
+void gst_transcoder_set_stream_selection                  (GstTranscoder * self,
+                                                           const gchar * const * selection);
+
+void gst_transcoder_get_pressure_thresholds               (GstTranscoder * self,
+                                                           gdouble * cpu,
+                                                           gdouble * io,
+                                                           gdouble * memory);
+void gst_transcoder_set_pressure_thresholds               (GstTranscoder * self,
+                                                           gdouble cpu,
+                                                           gdouble io,
+                                                           gdouble memory);
+
 
 /****************** Signal dispatcher *******************************/
 
@@ -110,6 +165,13 @@ GType gst_transcoder_g_main_context_signal_dispatcher_get_type (void);
 
 GstTranscoderSignalDispatcher * gst_transcoder_g_main_context_signal_dispatcher_new (GMainContext * application_context);
 
+/****************** Profile cache *******************************/
+
+GstEncodingProfile * gst_transcoder_profile_cache_get    (const gchar * profile_string);
+void gst_transcoder_profile_cache_clear                  (void);
+GstStructure * gst_transcoder_profile_cache_get_stats    (void);
+void gst_transcoder_checksum_encoding_targets            (GChecksum * checksum);
+
 G_END_DECLS
 
 #endif
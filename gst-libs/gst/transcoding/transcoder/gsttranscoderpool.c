@@ -0,0 +1,896 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:gsttranscoderpool
+ * @short_description: Run many transcoding jobs with a bounded concurrency
+ *
+ * A #GstTranscoderPool queues transcoding jobs and runs at most
+ * #GstTranscoderPool:max-jobs of them at once, each with its own
+ * #GstTranscoder. Pending jobs are started by decreasing priority, and
+ * running jobs share the process wide CPU budget set with
+ * gst_transcoder_pool_set_cpu_usage() in proportion of their priority.
+ *
+ * All the transcoders of the pool run from its scheduling thread, which
+ * also emits all the signals of the pool.
+ *
+ * With #GstTranscoderPool:recycle set, the pipeline of a successfully
+ * finished job is kept and reused by a next job: only the URIs are
+ * swapped, and the encoders and muxer are reused as long as the jobs have
+ * equal profiles. It saves most of the setup of jobs transcoding many
+ * short files the same way.
+ *
+ * The streaming threads are bounded too: #GstTranscoderPool:max-threads
+ * is split between the #GstTranscoderPool:max-jobs jobs, and each job
+ * sets its share as the thread count of its multi-threaded elements
+ * (encoders, decoders, converters) so that running many jobs does not
+ * oversubscribe the CPUs.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gsttranscoderpool.h"
+#include "gsttranscoder-private.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_transcoder_pool_debug);
+#define GST_CAT_DEFAULT gst_transcoder_pool_debug
+
+#define DEFAULT_MAX_JOBS 1
+#define DEFAULT_MAX_THREADS 0
+#define DEFAULT_CPU_USAGE 100
+
+/* Properties through which elements size their internal thread pools */
+static const gchar *thread_properties[] = {
+  "threads", "max-threads", "n-threads", NULL
+};
+
+enum
+{
+  PROP_0,
+  PROP_MAX_JOBS,
+  PROP_MAX_THREADS,
+  PROP_RECYCLE,
+  PROP_LAST
+};
+
+enum
+{
+  SIGNAL_JOB_STARTED,
+  SIGNAL_JOB_DONE,
+  SIGNAL_JOB_ERROR,
+  SIGNAL_LAST
+};
+
+typedef struct
+{
+  GstTranscoderPool *pool;
+
+  guint id;
+  guint priority;
+  gchar *source_uri;
+  gchar *dest_uri;
+  GstEncodingProfile *profile;
+
+  GstTranscoder *transcoder;
+  /* Threads each multi-threaded element of the job may use */
+  guint n_threads;
+  GstElement *pipeline;
+  gulong element_added_id;
+  gint finished;
+  GError *error;
+  GstStructure *details;
+} PoolJob;
+
+struct _GstTranscoderPool
+{
+  GstObject parent;
+
+  guint max_jobs;
+  guint max_threads;
+  gint cpu_usage;
+
+  /* PoolJob, sorted by decreasing priority */
+  GQueue pending;
+  GList *running;
+  guint next_id;
+
+  /* The pipelines of the finished jobs, in READY, to be reused when
+   * recycling */
+  gboolean recycle;
+  GList *idle_pipelines;
+
+  guint n_done, n_failed, n_recycled;
+  GstClockTime transcoded_duration;
+  GstClockTime start_time;
+
+  GThread *thread;
+  GCond cond;
+  GMainContext *context;
+  GMainLoop *loop;
+};
+
+struct _GstTranscoderPoolClass
+{
+  GstObjectClass parent_class;
+};
+
+#define parent_class gst_transcoder_pool_parent_class
+G_DEFINE_TYPE (GstTranscoderPool, gst_transcoder_pool, GST_TYPE_OBJECT);
+
+static guint signals[SIGNAL_LAST] = { 0, };
+static GParamSpec *param_specs[PROP_LAST] = { NULL, };
+
+static void
+pool_job_release_pipeline (PoolJob * job)
+{
+  if (!job->pipeline)
+    return;
+
+  g_signal_handler_disconnect (job->pipeline, job->element_added_id);
+  gst_object_unref (job->pipeline);
+  job->pipeline = NULL;
+}
+
+static void
+pool_job_free (PoolJob * job)
+{
+  pool_job_release_pipeline (job);
+  g_free (job->source_uri);
+  g_free (job->dest_uri);
+  if (job->profile)
+    g_object_unref (job->profile);
+  if (job->transcoder)
+    gst_object_unref (job->transcoder);
+  g_clear_error (&job->error);
+  if (job->details)
+    gst_structure_free (job->details);
+  g_free (job);
+}
+
+static gint
+compare_priority (PoolJob * queued, PoolJob * job, gpointer udata)
+{
+  /* Keeps the jobs with the same priority in the order they were pushed */
+  return queued->priority >= job->priority ? -1 : 1;
+}
+
+static void
+attach_idle (GstTranscoderPool * self, GSourceFunc func, gpointer data)
+{
+  GSource *source = g_idle_source_new ();
+
+  g_source_set_callback (source, func, data, NULL);
+  g_source_attach (source, self->context);
+  g_source_unref (source);
+}
+
+static gboolean
+job_finished_cb (PoolJob * job);
+
+static void
+job_finished (PoolJob * job, GError * error, const GstStructure * details)
+{
+  if (!g_atomic_int_compare_and_exchange (&job->finished, FALSE, TRUE))
+    return;
+
+  if (error)
+    job->error = g_error_copy (error);
+  if (details)
+    job->details = gst_structure_copy (details);
+
+  /* The transcoder can not be destroyed from its own signal handlers */
+  attach_idle (job->pool, (GSourceFunc) job_finished_cb, job);
+}
+
+static void
+job_done_cb (GstTranscoder * transcoder, PoolJob * job)
+{
+  job_finished (job, NULL, NULL);
+}
+
+static void
+job_error_cb (GstTranscoder * transcoder, GError * error,
+    GstStructure * details, PoolJob * job)
+{
+  job_finished (job, error, details);
+}
+
+static void
+free_pipelines (GList * pipelines)
+{
+  GList *tmp;
+
+  for (tmp = pipelines; tmp; tmp = tmp->next)
+    gst_element_set_state (tmp->data, GST_STATE_NULL);
+  g_list_free_full (pipelines, gst_object_unref);
+}
+
+static void
+limit_element_threads (GstElement * element, PoolJob * job)
+{
+  guint i;
+
+  for (i = 0; thread_properties[i]; i++) {
+    GValue value = G_VALUE_INIT, n_threads = G_VALUE_INIT;
+    GParamSpec *pspec =
+        g_object_class_find_property (G_OBJECT_GET_CLASS (element),
+        thread_properties[i]);
+
+    if (!pspec || !(pspec->flags & G_PARAM_WRITABLE) ||
+        (pspec->value_type != G_TYPE_INT && pspec->value_type != G_TYPE_UINT
+            && pspec->value_type != G_TYPE_INT64 &&
+            pspec->value_type != G_TYPE_UINT64))
+      continue;
+
+    g_value_init (&n_threads, G_TYPE_UINT);
+    g_value_set_uint (&n_threads, job->n_threads);
+    g_value_init (&value, pspec->value_type);
+    g_value_transform (&n_threads, &value);
+    /* Elements not accepting that many threads get as many as they can */
+    g_param_value_validate (pspec, &value);
+
+    GST_DEBUG_OBJECT (element, "Job %u: limiting %s to %u", job->id,
+        pspec->name, job->n_threads);
+    g_object_set_property (G_OBJECT (element), pspec->name, &value);
+
+    g_value_unset (&value);
+    g_value_unset (&n_threads);
+  }
+}
+
+static void
+element_added_cb (GstBin * pipeline, GstBin * bin, GstElement * element,
+    PoolJob * job)
+{
+  limit_element_threads (element, job);
+}
+
+static void
+limit_element_threads_foreach (const GValue * item, PoolJob * job)
+{
+  limit_element_threads (g_value_get_object (item), job);
+}
+
+static void
+start_job (GstTranscoderPool * self, PoolJob * job, gint cpu_usage)
+{
+  gboolean recycle;
+  GstIterator *it;
+  GstElement *pipeline = NULL;
+
+  GST_INFO_OBJECT (self, "Starting job %u: %s -> %s (priority %u)", job->id,
+      job->source_uri, job->dest_uri, job->priority);
+
+  GST_OBJECT_LOCK (self);
+  recycle = self->recycle;
+  if (self->idle_pipelines) {
+    pipeline = self->idle_pipelines->data;
+    self->idle_pipelines = g_list_delete_link (self->idle_pipelines,
+        self->idle_pipelines);
+    self->n_recycled++;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (pipeline) {
+    GST_DEBUG_OBJECT (self, "Job %u reuses %" GST_PTR_FORMAT, job->id,
+        pipeline);
+    job->transcoder = gst_transcoder_new_for_pipeline (pipeline,
+        job->source_uri, job->dest_uri, job->profile, self->context);
+    gst_object_unref (pipeline);
+  } else {
+    job->transcoder = gst_transcoder_new_with_main_context (job->source_uri,
+        job->dest_uri, job->profile, NULL, self->context);
+  }
+
+  job->pipeline = gst_transcoder_get_pipeline (job->transcoder);
+  if (recycle)
+    g_object_set (job->pipeline, "recycle", TRUE, NULL);
+
+  /* Elements of a recycled pipeline keep their previous limit otherwise */
+  job->element_added_id = g_signal_connect (job->pipeline,
+      "deep-element-added", G_CALLBACK (element_added_cb), job);
+  it = gst_bin_iterate_recurse (GST_BIN (job->pipeline));
+  gst_iterator_foreach (it, (GstIteratorForeachFunction)
+      limit_element_threads_foreach, job);
+  gst_iterator_free (it);
+
+  gst_transcoder_set_cpu_weight (job->transcoder, job->priority + 1);
+  gst_transcoder_set_shared_cpu_usage (job->transcoder, cpu_usage);
+
+  g_signal_connect (job->transcoder, "done", G_CALLBACK (job_done_cb), job);
+  g_signal_connect (job->transcoder, "error", G_CALLBACK (job_error_cb), job);
+
+  g_signal_emit (self, signals[SIGNAL_JOB_STARTED], 0, job->id,
+      job->transcoder);
+  gst_transcoder_run_async (job->transcoder);
+}
+
+static gboolean
+start_pending_jobs_cb (GstTranscoderPool * self)
+{
+  GList *tmp, *to_start = NULL;
+  gint cpu_usage;
+  guint max_threads;
+
+  GST_OBJECT_LOCK (self);
+  max_threads = self->max_threads ? self->max_threads :
+      g_get_num_processors ();
+  while (!g_queue_is_empty (&self->pending) &&
+      g_list_length (self->running) < self->max_jobs) {
+    PoolJob *job = g_queue_pop_head (&self->pending);
+
+    job->n_threads = MAX (max_threads / self->max_jobs, 1);
+    self->running = g_list_prepend (self->running, job);
+    to_start = g_list_prepend (to_start, job);
+  }
+  if (to_start && !GST_CLOCK_TIME_IS_VALID (self->start_time))
+    self->start_time = g_get_monotonic_time () * GST_USECOND;
+  cpu_usage = self->cpu_usage;
+  GST_OBJECT_UNLOCK (self);
+
+  for (tmp = g_list_reverse (to_start); tmp; tmp = tmp->next)
+    start_job (self, tmp->data, cpu_usage);
+  g_list_free (to_start);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+job_finished_cb (PoolJob * job)
+{
+  GstTranscoderPool *self = job->pool;
+  GstClockTime duration;
+  GstElement *pipeline = NULL;
+
+  /* At EOS the position is the duration of what was transcoded */
+  duration = gst_transcoder_get_position (job->transcoder);
+  pool_job_release_pipeline (job);
+  if (!job->error && gst_transcoder_pool_get_recycle (self))
+    pipeline = gst_transcoder_take_pipeline (job->transcoder);
+  g_clear_object (&job->transcoder);
+
+  GST_OBJECT_LOCK (self);
+  if (pipeline && g_list_length (self->idle_pipelines) < self->max_jobs) {
+    self->idle_pipelines = g_list_prepend (self->idle_pipelines, pipeline);
+    pipeline = NULL;
+  }
+  self->running = g_list_remove (self->running, job);
+  if (job->error) {
+    self->n_failed++;
+  } else {
+    self->n_done++;
+    if (GST_CLOCK_TIME_IS_VALID (duration))
+      self->transcoded_duration += duration;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (pipeline)
+    free_pipelines (g_list_append (NULL, pipeline));
+
+  if (job->error) {
+    GST_INFO_OBJECT (self, "Job %u failed: %s", job->id, job->error->message);
+    g_signal_emit (self, signals[SIGNAL_JOB_ERROR], 0, job->id, job->error,
+        job->details);
+  } else {
+    GST_INFO_OBJECT (self, "Job %u done", job->id);
+    g_signal_emit (self, signals[SIGNAL_JOB_DONE], 0, job->id);
+  }
+  pool_job_free (job);
+
+  start_pending_jobs_cb (self);
+
+  GST_OBJECT_LOCK (self);
+  g_cond_broadcast (&self->cond);
+  GST_OBJECT_UNLOCK (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+main_loop_running_cb (GstTranscoderPool * self)
+{
+  GST_TRACE_OBJECT (self, "Main loop running now");
+
+  GST_OBJECT_LOCK (self);
+  g_cond_signal (&self->cond);
+  GST_OBJECT_UNLOCK (self);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer
+gst_transcoder_pool_main (gpointer data)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (data);
+
+  GST_TRACE_OBJECT (self, "Starting main thread");
+
+  g_main_context_push_thread_default (self->context);
+  attach_idle (self, (GSourceFunc) main_loop_running_cb, self);
+  g_main_loop_run (self->loop);
+  g_main_context_pop_thread_default (self->context);
+
+  GST_TRACE_OBJECT (self, "Stopped main thread");
+
+  return NULL;
+}
+
+static void
+gst_transcoder_pool_init (GstTranscoderPool * self)
+{
+  g_cond_init (&self->cond);
+  g_queue_init (&self->pending);
+
+  self->max_jobs = DEFAULT_MAX_JOBS;
+  self->max_threads = DEFAULT_MAX_THREADS;
+  self->cpu_usage = DEFAULT_CPU_USAGE;
+  self->start_time = GST_CLOCK_TIME_NONE;
+
+  self->context = g_main_context_new ();
+  self->loop = g_main_loop_new (self->context, FALSE);
+}
+
+static void
+gst_transcoder_pool_constructed (GObject * object)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (object);
+
+  GST_OBJECT_LOCK (self);
+  self->thread = g_thread_new ("GstTranscoderPool", gst_transcoder_pool_main,
+      self);
+  while (!g_main_loop_is_running (self->loop))
+    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+  GST_OBJECT_UNLOCK (self);
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gst_transcoder_pool_dispose (GObject * object)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (object);
+
+  if (self->loop) {
+    g_main_loop_quit (self->loop);
+    g_thread_join (self->thread);
+    self->thread = NULL;
+
+    /* Stops the jobs still running before their callbacks can not be
+     * dispatched anymore */
+    g_list_free_full (self->running, (GDestroyNotify) pool_job_free);
+    self->running = NULL;
+    g_queue_clear_full (&self->pending, (GDestroyNotify) pool_job_free);
+    free_pipelines (self->idle_pipelines);
+    self->idle_pipelines = NULL;
+
+    g_main_loop_unref (self->loop);
+    self->loop = NULL;
+
+    g_main_context_unref (self->context);
+    self->context = NULL;
+  }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gst_transcoder_pool_finalize (GObject * object)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (object);
+
+  g_cond_clear (&self->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_transcoder_pool_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (object);
+
+  switch (prop_id) {
+    case PROP_MAX_JOBS:
+      gst_transcoder_pool_set_max_jobs (self, g_value_get_uint (value));
+      break;
+    case PROP_MAX_THREADS:
+      gst_transcoder_pool_set_max_threads (self, g_value_get_uint (value));
+      break;
+    case PROP_RECYCLE:
+      gst_transcoder_pool_set_recycle (self, g_value_get_boolean (value));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_transcoder_pool_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstTranscoderPool *self = GST_TRANSCODER_POOL (object);
+
+  switch (prop_id) {
+    case PROP_MAX_JOBS:
+      g_value_set_uint (value, gst_transcoder_pool_get_max_jobs (self));
+      break;
+    case PROP_MAX_THREADS:
+      g_value_set_uint (value, gst_transcoder_pool_get_max_threads (self));
+      break;
+    case PROP_RECYCLE:
+      g_value_set_boolean (value, gst_transcoder_pool_get_recycle (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_transcoder_pool_class_init (GstTranscoderPoolClass * klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+
+  gobject_class->set_property = gst_transcoder_pool_set_property;
+  gobject_class->get_property = gst_transcoder_pool_get_property;
+  gobject_class->constructed = gst_transcoder_pool_constructed;
+  gobject_class->dispose = gst_transcoder_pool_dispose;
+  gobject_class->finalize = gst_transcoder_pool_finalize;
+
+  param_specs[PROP_MAX_JOBS] =
+      g_param_spec_uint ("max-jobs", "Maximum jobs",
+      "Maximum number of jobs running at the same time", 1, G_MAXUINT,
+      DEFAULT_MAX_JOBS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_MAX_THREADS] =
+      g_param_spec_uint ("max-threads", "Maximum threads",
+      "Number of threads the multi-threaded elements of the running jobs "
+      "share, 0 for the number of processors", 0, G_MAXUINT,
+      DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  param_specs[PROP_RECYCLE] =
+      g_param_spec_boolean ("recycle", "Recycle",
+      "Reuse the pipelines of the finished jobs for the next ones", FALSE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (gobject_class, PROP_LAST, param_specs);
+
+  /**
+   * GstTranscoderPool::job-started:
+   * @pool: The #GstTranscoderPool
+   * @job_id: The identifier returned by gst_transcoder_pool_push()
+   * @transcoder: The #GstTranscoder running the job
+   *
+   * Emitted right before the job starts, @transcoder can be configured or
+   * connected to from there.
+   */
+  signals[SIGNAL_JOB_STARTED] =
+      g_signal_new ("job-started", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS, 0, NULL,
+      NULL, NULL, G_TYPE_NONE, 2, G_TYPE_UINT, GST_TYPE_TRANSCODER);
+
+  signals[SIGNAL_JOB_DONE] =
+      g_signal_new ("job-done", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS, 0, NULL,
+      NULL, NULL, G_TYPE_NONE, 1, G_TYPE_UINT);
+
+  signals[SIGNAL_JOB_ERROR] =
+      g_signal_new ("job-error", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_NO_RECURSE | G_SIGNAL_NO_HOOKS, 0, NULL,
+      NULL, NULL, G_TYPE_NONE, 3, G_TYPE_UINT, G_TYPE_ERROR,
+      GST_TYPE_STRUCTURE);
+}
+
+static gpointer
+gst_transcoder_pool_init_once (G_GNUC_UNUSED gpointer user_data)
+{
+  gst_init (NULL, NULL);
+
+  GST_DEBUG_CATEGORY_INIT (gst_transcoder_pool_debug, "gst-transcoder-pool",
+      0, "GstTranscoderPool");
+
+  return NULL;
+}
+
+/**
+ * gst_transcoder_pool_new:
+ * @max_jobs: The maximum number of jobs to run at the same time
+ *
+ * Returns: a new #GstTranscoderPool instance
+ */
+GstTranscoderPool *
+gst_transcoder_pool_new (guint max_jobs)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  g_once (&once, gst_transcoder_pool_init_once, NULL);
+
+  g_return_val_if_fail (max_jobs > 0, NULL);
+
+  return g_object_new (GST_TYPE_TRANSCODER_POOL, "max-jobs", max_jobs, NULL);
+}
+
+/**
+ * gst_transcoder_pool_push:
+ * @self: The #GstTranscoderPool
+ * @source_uri: The URI of the media stream to transcode
+ * @dest_uri: The URI of the destination of the transcoded stream
+ * @profile: The #GstEncodingProfile defining the output format
+ * @priority: The priority of the job, higher priority jobs are started
+ * first and get a bigger share of the CPU budget.
+ *
+ * Queues a transcoding job, it will be started as soon as less than
+ * #GstTranscoderPool:max-jobs jobs with a higher or equal priority are
+ * running.
+ *
+ * Returns: The identifier of the job, as passed to the
+ * #GstTranscoderPool::job-done and #GstTranscoderPool::job-error signals.
+ */
+guint
+gst_transcoder_pool_push (GstTranscoderPool * self, const gchar * source_uri,
+    const gchar * dest_uri, GstEncodingProfile * profile, guint priority)
+{
+  PoolJob *job;
+  guint id;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER_POOL (self), 0);
+  g_return_val_if_fail (source_uri, 0);
+  g_return_val_if_fail (dest_uri, 0);
+  g_return_val_if_fail (GST_IS_ENCODING_PROFILE (profile), 0);
+
+  job = g_new0 (PoolJob, 1);
+  job->pool = self;
+  job->priority = priority;
+  job->source_uri = g_strdup (source_uri);
+  job->dest_uri = g_strdup (dest_uri);
+  job->profile = g_object_ref (profile);
+
+  GST_OBJECT_LOCK (self);
+  id = job->id = ++self->next_id;
+  g_queue_insert_sorted (&self->pending, job, (GCompareDataFunc)
+      compare_priority, NULL);
+  GST_OBJECT_UNLOCK (self);
+
+  GST_DEBUG_OBJECT (self, "Queued job %u: %s -> %s", id, source_uri,
+      dest_uri);
+  attach_idle (self, (GSourceFunc) start_pending_jobs_cb, self);
+
+  return id;
+}
+
+/**
+ * gst_transcoder_pool_wait:
+ * @self: The #GstTranscoderPool
+ *
+ * Blocks until all the jobs pushed so far are finished. This must not be
+ * called from the signal handlers of @self.
+ */
+void
+gst_transcoder_pool_wait (GstTranscoderPool * self)
+{
+  g_return_if_fail (GST_IS_TRANSCODER_POOL (self));
+  g_return_if_fail (g_thread_self () != self->thread);
+
+  GST_OBJECT_LOCK (self);
+  while (self->running || !g_queue_is_empty (&self->pending))
+    g_cond_wait (&self->cond, GST_OBJECT_GET_LOCK (self));
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_transcoder_pool_get_max_jobs:
+ * @self: The #GstTranscoderPool
+ *
+ * Returns: The maximum number of jobs running at the same time
+ */
+guint
+gst_transcoder_pool_get_max_jobs (GstTranscoderPool * self)
+{
+  guint max_jobs;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER_POOL (self), DEFAULT_MAX_JOBS);
+
+  GST_OBJECT_LOCK (self);
+  max_jobs = self->max_jobs;
+  GST_OBJECT_UNLOCK (self);
+
+  return max_jobs;
+}
+
+/**
+ * gst_transcoder_pool_set_max_jobs:
+ * @self: The #GstTranscoderPool
+ * @max_jobs: The maximum number of jobs running at the same time
+ *
+ * Lowering @max_jobs does not stop the jobs already running, no new job
+ * is started until enough of them are finished.
+ */
+void
+gst_transcoder_pool_set_max_jobs (GstTranscoderPool * self, guint max_jobs)
+{
+  g_return_if_fail (GST_IS_TRANSCODER_POOL (self));
+  g_return_if_fail (max_jobs > 0);
+
+  GST_OBJECT_LOCK (self);
+  self->max_jobs = max_jobs;
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->context)
+    attach_idle (self, (GSourceFunc) start_pending_jobs_cb, self);
+}
+
+/**
+ * gst_transcoder_pool_get_max_threads:
+ * @self: The #GstTranscoderPool
+ *
+ * Returns: The number of threads the running jobs share, 0 for the number
+ * of processors
+ */
+guint
+gst_transcoder_pool_get_max_threads (GstTranscoderPool * self)
+{
+  guint max_threads;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER_POOL (self), DEFAULT_MAX_THREADS);
+
+  GST_OBJECT_LOCK (self);
+  max_threads = self->max_threads;
+  GST_OBJECT_UNLOCK (self);
+
+  return max_threads;
+}
+
+/**
+ * gst_transcoder_pool_set_max_threads:
+ * @self: The #GstTranscoderPool
+ * @max_threads: The number of threads the running jobs share, 0 for the
+ * number of processors
+ *
+ * Each job gets @max_threads divided by #GstTranscoderPool:max-jobs (at
+ * least one), set on the `threads`, `max-threads` or `n-threads` property
+ * of the elements having one. It is applied when the next job starts.
+ */
+void
+gst_transcoder_pool_set_max_threads (GstTranscoderPool * self,
+    guint max_threads)
+{
+  g_return_if_fail (GST_IS_TRANSCODER_POOL (self));
+
+  GST_OBJECT_LOCK (self);
+  self->max_threads = max_threads;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_transcoder_pool_get_recycle:
+ * @self: The #GstTranscoderPool
+ *
+ * Returns: Whether the pipelines of the finished jobs are reused
+ */
+gboolean
+gst_transcoder_pool_get_recycle (GstTranscoderPool * self)
+{
+  gboolean recycle;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER_POOL (self), FALSE);
+
+  GST_OBJECT_LOCK (self);
+  recycle = self->recycle;
+  GST_OBJECT_UNLOCK (self);
+
+  return recycle;
+}
+
+/**
+ * gst_transcoder_pool_set_recycle:
+ * @self: The #GstTranscoderPool
+ * @recycle: Whether to reuse the pipelines of the finished jobs
+ *
+ * When @recycle is %TRUE, the pipeline of a successfully finished job is
+ * reset and reused by the next job instead of being destroyed, see
+ * #GstUriTranscodeBin:recycle. At most #GstTranscoderPool:max-jobs
+ * pipelines are kept around.
+ */
+void
+gst_transcoder_pool_set_recycle (GstTranscoderPool * self, gboolean recycle)
+{
+  GList *pipelines = NULL;
+
+  g_return_if_fail (GST_IS_TRANSCODER_POOL (self));
+
+  GST_OBJECT_LOCK (self);
+  self->recycle = recycle;
+  if (!recycle) {
+    pipelines = self->idle_pipelines;
+    self->idle_pipelines = NULL;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  free_pipelines (pipelines);
+}
+
+/**
+ * gst_transcoder_pool_set_cpu_usage:
+ * @self: The #GstTranscoderPool
+ * @cpu_usage: The percentage of the CPU the running jobs share
+ *
+ * Sets the CPU budget the running jobs share, see
+ * gst_transcoder_set_shared_cpu_usage(). It is applied when the next job
+ * starts.
+ */
+void
+gst_transcoder_pool_set_cpu_usage (GstTranscoderPool * self, gint cpu_usage)
+{
+  g_return_if_fail (GST_IS_TRANSCODER_POOL (self));
+
+  GST_OBJECT_LOCK (self);
+  self->cpu_usage = cpu_usage;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_transcoder_pool_get_stats:
+ * @self: The #GstTranscoderPool
+ *
+ * Get the pool wide statistics, the returned `transcoder-pool-stats`
+ * structure contains the following fields:
+ *
+ * - "pending" G_TYPE_UINT: The number of jobs waiting to be started
+ * - "running" G_TYPE_UINT: The number of jobs currently running
+ * - "done" G_TYPE_UINT: The number of jobs successfully finished
+ * - "failed" G_TYPE_UINT: The number of jobs which errored out
+ * - "recycled" G_TYPE_UINT: The number of jobs which reused the pipeline
+ *   of a previous job
+ * - "elapsed" GST_TYPE_CLOCK_TIME: The time since the first job started
+ * - "transcoded-duration" GST_TYPE_CLOCK_TIME: The summed duration of the
+ *   media transcoded by the finished jobs
+ * - "throughput" G_TYPE_DOUBLE: The transcoded duration per elapsed second
+ *
+ * Returns: (transfer full): The statistics of the pool
+ */
+GstStructure *
+gst_transcoder_pool_get_stats (GstTranscoderPool * self)
+{
+  GstStructure *stats;
+  GstClockTime elapsed = 0;
+
+  g_return_val_if_fail (GST_IS_TRANSCODER_POOL (self), NULL);
+
+  GST_OBJECT_LOCK (self);
+  if (GST_CLOCK_TIME_IS_VALID (self->start_time))
+    elapsed = g_get_monotonic_time () * GST_USECOND - self->start_time;
+
+  stats = gst_structure_new ("transcoder-pool-stats",
+      "pending", G_TYPE_UINT, self->pending.length,
+      "running", G_TYPE_UINT, g_list_length (self->running),
+      "done", G_TYPE_UINT, self->n_done,
+      "failed", G_TYPE_UINT, self->n_failed,
+      "recycled", G_TYPE_UINT, self->n_recycled,
+      "elapsed", GST_TYPE_CLOCK_TIME, elapsed,
+      "transcoded-duration", GST_TYPE_CLOCK_TIME, self->transcoded_duration,
+      "throughput", G_TYPE_DOUBLE, elapsed ?
+      (gdouble) self->transcoded_duration / elapsed : 0.0, NULL);
+  GST_OBJECT_UNLOCK (self);
+
+  return stats;
+}
@@ -0,0 +1,221 @@
+/*
+ * gst-autoplug-memo.c
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+/* decodebin and parsebin signals still use GValueArray */
+#define GLIB_DISABLE_DEPRECATION_WARNINGS
+
+#include "gst-autoplug-memo.h"
+
+/**
+ * SECTION: gst-autoplug-memo
+ * @title: Autoplug memo
+ * @short_description: Remember the factories decodebin can plug for caps
+ *
+ * Each time decodebin or parsebin exposes a stream, they filter the whole
+ * list of decodable factories of the registry against its caps to find the
+ * elements to try. Transcoding many files coming from the same sources
+ * means doing it again and again for the same caps, so the filtered and
+ * ranked lists are kept in a process wide table, answered through the
+ * "autoplug-factories" signal.
+ *
+ * Buffer fields such as "codec_data" or "streamheader" differ from file to
+ * file but do not take part in the selection, they are left out of the
+ * caps used as keys. The table is flushed when the registry changes.
+ */
+
+GST_DEBUG_CATEGORY_STATIC (gst_autoplug_memo_debug);
+#define GST_CAT_DEFAULT gst_autoplug_memo_debug
+
+/* Flushed when reached, the same sources keep filling it quickly */
+#define MAX_ENTRIES 256
+
+static GMutex memo_lock;
+/* normalized caps string -> GList of GstElementFactory */
+static GHashTable *memo = NULL;
+/* The ranked decodable factories the entries were filtered from */
+static GList *factories = NULL;
+static guint32 factories_cookie = 0;
+static guint64 n_hits = 0;
+static guint64 n_misses = 0;
+
+/* Must be called with the memo lock */
+static GHashTable *
+get_memo (void)
+{
+  GstRegistry *registry = gst_registry_get ();
+  guint32 cookie = gst_registry_get_feature_list_cookie (registry);
+
+  if (!memo) {
+    GST_DEBUG_CATEGORY_INIT (gst_autoplug_memo_debug, "autoplugmemo", 0,
+        "Autoplug memo");
+    memo = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) gst_plugin_feature_list_free);
+  }
+
+  if (!factories || cookie != factories_cookie) {
+    GST_DEBUG ("Registry changed, flushing %u entries",
+        g_hash_table_size (memo));
+
+    g_hash_table_remove_all (memo);
+    if (factories)
+      gst_plugin_feature_list_free (factories);
+
+    factories =
+        gst_element_factory_list_get_elements
+        (GST_ELEMENT_FACTORY_TYPE_DECODABLE, GST_RANK_MARGINAL);
+    factories =
+        g_list_sort (factories, gst_plugin_feature_rank_compare_func);
+    factories_cookie = cookie;
+  }
+
+  return memo;
+}
+
+static gboolean
+remove_buffer_fields (GQuark field_id, GValue * value, gpointer udata)
+{
+  if (GST_VALUE_HOLDS_BUFFER (value))
+    return FALSE;
+
+  if (GST_VALUE_HOLDS_ARRAY (value) && gst_value_array_get_size (value) &&
+      GST_VALUE_HOLDS_BUFFER (gst_value_array_get_value (value, 0)))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gchar *
+get_caps_key (GstCaps * caps)
+{
+  guint i;
+  gchar *key;
+  GstCaps *normalized = gst_caps_copy (caps);
+
+  for (i = 0; i < gst_caps_get_size (normalized); i++)
+    gst_structure_filter_and_map_in_place (gst_caps_get_structure (normalized,
+            i), remove_buffer_fields, NULL);
+
+  key = gst_caps_to_string (normalized);
+  gst_caps_unref (normalized);
+
+  return key;
+}
+
+static GValueArray *
+make_factories_array (GList * list)
+{
+  GList *tmp;
+  GValueArray *res = g_value_array_new (g_list_length (list));
+
+  for (tmp = list; tmp; tmp = tmp->next) {
+    GValue val = G_VALUE_INIT;
+
+    g_value_init (&val, G_TYPE_OBJECT);
+    g_value_set_object (&val, tmp->data);
+    g_value_array_append (res, &val);
+    g_value_unset (&val);
+  }
+
+  return res;
+}
+
+/* Same filtering as the default decodebin and parsebin handlers, parsebin
+ * leaves the decoders of the list aside by itself */
+static GValueArray *
+autoplug_factories_cb (GstElement * decodebin, GstPad * pad, GstCaps * caps,
+    gpointer udata)
+{
+  GList *list;
+  GValueArray *res;
+  GHashTable *table;
+  gchar *key = get_caps_key (caps);
+
+  g_mutex_lock (&memo_lock);
+  table = get_memo ();
+  list = g_hash_table_lookup (table, key);
+  if (list) {
+    n_hits++;
+  } else {
+    n_misses++;
+    if (g_hash_table_size (table) >= MAX_ENTRIES)
+      g_hash_table_remove_all (table);
+
+    list = gst_element_factory_list_filter (factories, caps, GST_PAD_SINK,
+        gst_caps_is_fixed (caps));
+    GST_DEBUG_OBJECT (decodebin, "%u factories for %s", g_list_length (list),
+        key);
+
+    if (list) {
+      g_hash_table_insert (table, key, list);
+      key = NULL;
+    }
+  }
+
+  res = make_factories_array (list);
+  g_mutex_unlock (&memo_lock);
+  g_free (key);
+
+  return res;
+}
+
+/**
+ * gst_autoplug_memo_attach:
+ * @decodebin: A decodebin or parsebin
+ *
+ * Makes @decodebin get the factories to try for its streams from the memo.
+ */
+void
+gst_autoplug_memo_attach (GstElement * decodebin)
+{
+  g_signal_connect (decodebin, "autoplug-factories",
+      G_CALLBACK (autoplug_factories_cb), NULL);
+}
+
+/**
+ * gst_autoplug_memo_get_stats:
+ *
+ * Get the statistics of the memo, the returned `autoplug-memo-stats`
+ * structure contains the following fields:
+ *
+ * - "hits" G_TYPE_UINT64: The number of streams whose factories came from
+ *   the memo
+ * - "misses" G_TYPE_UINT64: The number of streams whose factories had to
+ *   be filtered from the registry
+ * - "size" G_TYPE_UINT: The number of caps currently memoized
+ *
+ * Returns: (transfer full): The statistics of the memo
+ */
+GstStructure *
+gst_autoplug_memo_get_stats (void)
+{
+  GstStructure *stats;
+
+  g_mutex_lock (&memo_lock);
+  stats = gst_structure_new ("autoplug-memo-stats",
+      "hits", G_TYPE_UINT64, n_hits,
+      "misses", G_TYPE_UINT64, n_misses,
+      "size", G_TYPE_UINT, memo ? g_hash_table_size (memo) : 0, NULL);
+  g_mutex_unlock (&memo_lock);
+
+  return stats;
+}
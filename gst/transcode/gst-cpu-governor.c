@@ -0,0 +1,315 @@
+/*
+ * gst-cpu-governor.c
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-cpu-governor.h"
+
+/**
+ * SECTION: gst-cpu-governor
+ * @title: GstCpuGovernor
+ * @short_description: Split a process wide CPU budget between pipelines
+ *
+ * The #GstCpuGovernor shares one CPU budget, its #GstCpuGovernor:cpu-usage,
+ * between all the #GstCpuThrottlingClock registered with it. Each member
+ * gets a share proportional to its weight. Members which are not throttled
+ * and use less than their share keep what they use, and what they leave is
+ * split between the other members, so background jobs soak up the CPU that
+ * high priority jobs do not need.
+ *
+ * Members report their measured usage with gst_cpu_governor_update() on
+ * each evaluation and get their new target usage back.
+ */
+
+/* *INDENT-OFF* */
+GST_DEBUG_CATEGORY_STATIC (gst_cpu_governor_debug);
+#define GST_CAT_DEFAULT gst_cpu_governor_debug
+
+#define parent_class gst_cpu_governor_parent_class
+G_DEFINE_TYPE (GstCpuGovernor, gst_cpu_governor, GST_TYPE_OBJECT)
+
+#define DEFAULT_CPU_USAGE 100
+
+typedef struct
+{
+  guint weight;
+  gdouble usage;
+  gboolean throttled;
+
+  /* Result of the last allocation */
+  gdouble target;
+  gboolean satisfied;
+} Member;
+
+enum
+{
+  PROP_FIRST,
+  PROP_CPU_USAGE,
+  PROP_N_MEMBERS,
+  PROP_LAST
+};
+
+static GParamSpec *param_specs[PROP_LAST] = { NULL, };
+/* *INDENT-ON* */
+
+/* Weighted max-min fair share of the budget, must be called with the
+ * object lock */
+static void
+allocate_unlocked (GstCpuGovernor * self)
+{
+  Member *member;
+  GHashTableIter iter;
+  gboolean changed = TRUE;
+  gdouble remaining = self->cpu_usage;
+
+  g_hash_table_iter_init (&iter, self->members);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & member))
+    member->satisfied = FALSE;
+
+  while (changed) {
+    guint total_weight = 0;
+    gdouble given = 0;
+
+    changed = FALSE;
+    g_hash_table_iter_init (&iter, self->members);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & member)) {
+      if (!member->satisfied)
+        total_weight += member->weight;
+    }
+
+    if (!total_weight)
+      break;
+
+    g_hash_table_iter_init (&iter, self->members);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & member)) {
+      if (member->satisfied)
+        continue;
+
+      member->target = remaining * member->weight / total_weight;
+
+      /* It can still grow up to its share, but lends what it does not use */
+      if (!member->throttled && member->usage < member->target) {
+        member->satisfied = TRUE;
+        given += member->usage;
+        changed = TRUE;
+      }
+    }
+
+    remaining = MAX (remaining - given, 0);
+  }
+}
+
+/**
+ * gst_cpu_governor_register:
+ * @self: The #GstCpuGovernor
+ * @member: The object sharing the budget
+ * @weight: The relative weight of @member, higher weights get more CPU
+ *
+ * Registers @member, or updates its weight if already registered.
+ */
+void
+gst_cpu_governor_register (GstCpuGovernor * self, gpointer member,
+    guint weight)
+{
+  Member *m;
+
+  GST_OBJECT_LOCK (self);
+  m = g_hash_table_lookup (self->members, member);
+  if (!m) {
+    m = g_slice_new0 (Member);
+    g_hash_table_insert (self->members, member, m);
+  }
+  m->weight = MAX (weight, 1);
+  GST_DEBUG_OBJECT (self, "%p registered with weight %u", member, m->weight);
+  allocate_unlocked (self);
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_cpu_governor_unregister:
+ * @self: The #GstCpuGovernor
+ * @member: The object to stop sharing the budget with
+ */
+void
+gst_cpu_governor_unregister (GstCpuGovernor * self, gpointer member)
+{
+  GST_OBJECT_LOCK (self);
+  if (g_hash_table_remove (self->members, member))
+    allocate_unlocked (self);
+  GST_OBJECT_UNLOCK (self);
+}
+
+/**
+ * gst_cpu_governor_update:
+ * @self: The #GstCpuGovernor
+ * @member: The member reporting its usage
+ * @measured_usage: The CPU usage @member measured during its last interval
+ * @throttled: Whether @member was slowed down during its last interval
+ *
+ * Returns: The CPU usage @member should now target
+ */
+gdouble
+gst_cpu_governor_update (GstCpuGovernor * self, gpointer member,
+    gdouble measured_usage, gboolean throttled)
+{
+  Member *m;
+  gdouble target;
+
+  GST_OBJECT_LOCK (self);
+  m = g_hash_table_lookup (self->members, member);
+  if (!m) {
+    target = self->cpu_usage;
+    GST_OBJECT_UNLOCK (self);
+
+    return target;
+  }
+
+  m->usage = measured_usage;
+  m->throttled = throttled;
+  allocate_unlocked (self);
+  target = m->target;
+  GST_LOG_OBJECT (self, "%p uses %f%% (throttled: %d) => target %f%%",
+      member, measured_usage, throttled, target);
+  GST_OBJECT_UNLOCK (self);
+
+  return target;
+}
+
+static void
+member_free (Member * member)
+{
+  g_slice_free (Member, member);
+}
+
+static void
+gst_cpu_governor_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec)
+{
+  GstCpuGovernor *self = GST_CPU_GOVERNOR (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (property_id) {
+    case PROP_CPU_USAGE:
+      g_value_set_uint (value, self->cpu_usage);
+      break;
+    case PROP_N_MEMBERS:
+      g_value_set_uint (value, g_hash_table_size (self->members));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+gst_cpu_governor_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec)
+{
+  GstCpuGovernor *self = GST_CPU_GOVERNOR (object);
+
+  switch (property_id) {
+    case PROP_CPU_USAGE:
+      GST_OBJECT_LOCK (self);
+      self->cpu_usage = g_value_get_uint (value);
+      if (self->cpu_usage == 0)
+        self->cpu_usage = 100;
+      allocate_unlocked (self);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_cpu_governor_finalize (GObject * object)
+{
+  GstCpuGovernor *self = GST_CPU_GOVERNOR (object);
+
+  g_hash_table_unref (self->members);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_cpu_governor_class_init (GstCpuGovernorClass * klass)
+{
+  GObjectClass *oclass = G_OBJECT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (gst_cpu_governor_debug, "cpugovernor", 0,
+      "CPU governor");
+
+  oclass->get_property = gst_cpu_governor_get_property;
+  oclass->set_property = gst_cpu_governor_set_property;
+  oclass->finalize = gst_cpu_governor_finalize;
+
+  /**
+   * GstCpuGovernor:cpu-usage:
+   *
+   * The percentage of the CPUs shared between all the members.
+   */
+  param_specs[PROP_CPU_USAGE] = g_param_spec_uint ("cpu-usage", "cpu-usage",
+      "The percentage of CPU shared between all the pipelines registered "
+      "with the governor", 0, 100, DEFAULT_CPU_USAGE,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuGovernor:n-members:
+   *
+   * The number of registered members.
+   */
+  param_specs[PROP_N_MEMBERS] = g_param_spec_uint ("n-members", "N members",
+      "The number of registered members", 0, G_MAXUINT, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  g_object_class_install_properties (oclass, PROP_LAST, param_specs);
+}
+
+static void
+gst_cpu_governor_init (GstCpuGovernor * self)
+{
+  self->cpu_usage = DEFAULT_CPU_USAGE;
+  self->members = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) member_free);
+}
+
+/**
+ * gst_cpu_governor_get_default:
+ *
+ * Returns: (transfer full): The process wide #GstCpuGovernor
+ */
+GstCpuGovernor *
+gst_cpu_governor_get_default (void)
+{
+  static gsize governor = 0;
+
+  if (g_once_init_enter (&governor)) {
+    GstCpuGovernor *tmp = g_object_new (GST_TYPE_CPU_GOVERNOR,
+        "name", "cpu-governor", NULL);
+
+    gst_object_ref_sink (tmp);
+    g_once_init_leave (&governor, (gsize) tmp);
+  }
+
+  return gst_object_ref ((gpointer) governor);
+}
@@ -0,0 +1,65 @@
+/*
+ * gst-cpu-governor.h
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GST_CPU_GOVERNOR_H__
+#define __GST_CPU_GOVERNOR_H__
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstCpuGovernor GstCpuGovernor;
+typedef struct _GstCpuGovernorClass GstCpuGovernorClass;
+
+GType gst_cpu_governor_get_type (void) G_GNUC_CONST;
+
+#define GST_TYPE_CPU_GOVERNOR (gst_cpu_governor_get_type ())
+#define GST_CPU_GOVERNOR(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CPU_GOVERNOR, GstCpuGovernor))
+#define GST_CPU_GOVERNOR_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CPU_GOVERNOR, GstCpuGovernorClass))
+#define GST_IS_CPU_GOVERNOR(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CPU_GOVERNOR))
+#define GST_IS_CPU_GOVERNOR_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CPU_GOVERNOR))
+#define GST_CPU_GOVERNOR_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_CPU_GOVERNOR, GstCpuGovernorClass))
+
+struct _GstCpuGovernorClass
+{
+  /*<private>*/
+  GstObjectClass parent_class;
+};
+
+struct _GstCpuGovernor
+{
+  /*<private>*/
+  GstObject parent;
+
+  guint cpu_usage;
+  /* member pointer -> Member */
+  GHashTable *members;
+};
+
+GstCpuGovernor * gst_cpu_governor_get_default (void);
+void gst_cpu_governor_register (GstCpuGovernor * self, gpointer member,
+                                guint weight);
+void gst_cpu_governor_unregister (GstCpuGovernor * self, gpointer member);
+gdouble gst_cpu_governor_update (GstCpuGovernor * self, gpointer member,
+                                 gdouble measured_usage, gboolean throttled);
+
+G_END_DECLS
+
+#endif /* #ifndef __GST_CPU_GOVERNOR_H__*/
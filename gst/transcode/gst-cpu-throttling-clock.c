@@ -10,17 +10,87 @@
 #include "config.h"
 #endif
 
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/resource.h>
+#ifdef HAVE_SCHED_GETAFFINITY
+#include <sched.h>
+#endif
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+#include <time.h>
+#include <pthread.h>
+#endif
 
 #include "gst-cpu-throttling-clock.h"
+#include "gst-cpu-governor.h"
 
 /**
  * SECTION: gst-cpu-throttling-clock
  * @title: GstCpuThrottlingClock
- * @short_description: TODO
+ * @short_description: Clock slowing down the pipeline to meet a CPU budget
+ *
+ * #GstCpuThrottlingClock slows the pipeline down so that the CPU time
+ * consumed by the process stays around #GstCpuThrottlingClock:cpu-usage
+ * percent of the available CPUs.
+ *
+ * The CPU budget is a token bucket: it is refilled at the allowed usage
+ * as time passes, and on each clock wait the CPU time (user and system)
+ * consumed since the previous wait is taken from it. When the bucket is
+ * overdrawn, the waiting thread sleeps until it is refilled. The sleep
+ * time thus only depends on the CPU actually used, not on the number of
+ * waits. The bucket holds at most
+ * #GstCpuThrottlingClock:min-sleep-time worth of budget, so an idle
+ * pipeline can not save up for a long burst.
+ *
+ * Every #GstCpuThrottlingClock:evaluation-interval a PID controller
+ * compares the measured usage with the target and lowers the allowed usage
+ * when it is over it, which compensates for what the bucket does not see,
+ * like the back-off signals below. The CPU time source is the
+ * #GstCpuThrottlingClockClass.get_cpu_time virtual method so that a
+ * subclass can feed synthetic values and drive the clock deterministically
+ * through gst_cpu_throttling_clock_evaluate() and
+ * gst_cpu_throttling_clock_charge().
+ *
+ * With the #GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE accounting mode,
+ * only the CPU time of the threads registered with
+ * gst_cpu_throttling_clock_add_thread() (and of the threads waiting on the
+ * clock) is counted, so that several pipelines in the same process each get
+ * their own budget.
+ *
+ * The usage is expressed relatively to the CPUs the process can effectively
+ * use: its affinity mask and the cgroup v2 `cpu.max` quota of its cgroup
+ * (and of the parent cgroups) are taken into account. When
+ * #GstCpuThrottlingClock:cfs-throttling-feedback is enabled, the time the
+ * kernel throttled the cgroup (read from `cpu.stat`) is added to the error
+ * so that the clock backs off before the CFS bandwidth control kicks in.
  *
- * TODO
+ * A thread only sleeps once it owes at least
+ * #GstCpuThrottlingClock:min-sleep-time to the bucket, smaller overdrafts
+ * are carried over to the next waits. This keeps the number of wake ups
+ * low when the pipeline waits on the clock for each of many small buffers.
+ * The sleep is interrupted when the clock entry being waited on is
+ * unscheduled, so that flushing or shutting down the pipeline does not
+ * have to wait for it.
+ *
+ * The clock can also back off when the host is short of resources: when
+ * the share of time some tasks were stalled waiting for the CPU, for I/O
+ * or for memory, as reported by the kernel pressure stall information in
+ * `/proc/pressure/`, exceeds #GstCpuThrottlingClock:cpu-pressure-threshold,
+ * #GstCpuThrottlingClock:io-pressure-threshold or
+ * #GstCpuThrottlingClock:memory-pressure-threshold, the excess is added to
+ * the error. This keeps the other jobs of the host responsive without
+ * having to tune #GstCpuThrottlingClock:cpu-usage for each job.
+ *
+ * The state of the controller is exposed through read-only properties and,
+ * every #GstCpuThrottlingClock:stats-interval, through the
+ * #GstCpuThrottlingClock::stats signal carrying the structure returned by
+ * gst_cpu_throttling_clock_get_stats().
+ *
+ * When a #GstCpuThrottlingClock:governor is set, the target usage is not
+ * #GstCpuThrottlingClock:cpu-usage anymore but the share of the governor
+ * budget given to the clock according to its #GstCpuThrottlingClock:weight.
  */
 
 /* *INDENT-OFF* */
@@ -30,17 +100,121 @@ GST_DEBUG_CATEGORY_STATIC (gst_cpu_throttling_clock_debug);
 #define parent_class gst_cpu_throttling_clock_parent_class
 G_DEFINE_TYPE (GstCpuThrottlingClock, gst_cpu_throttling_clock, GST_TYPE_CLOCK)
 
+#define DEFAULT_PROPORTIONAL_GAIN 0.25
+#define DEFAULT_INTEGRAL_GAIN 2.0
+#define DEFAULT_DERIVATIVE_GAIN 0.0
+#define DEFAULT_EVALUATION_INTERVAL (GST_SECOND / 4)
+#define MAX_WAIT_TIME GST_SECOND
+/* Lowest usage the controller can bring the allowed usage down to */
+#define MIN_ALLOWED_USAGE 1.0
+#define DEFAULT_CFS_THROTTLING_FEEDBACK FALSE
+#define DEFAULT_WEIGHT 1
+#define DEFAULT_MIN_SLEEP_TIME (10 * GST_MSECOND)
+#define DEFAULT_STATS_INTERVAL GST_SECOND
+/* Bucket i counts the sleeps lasting [2^(i-1), 2^i[ microseconds */
+#define N_SLEEP_BUCKETS 21
+#define DEFAULT_CGROUP_ROOT "/sys/fs/cgroup"
+#define CGROUP_ROOT_ENV "GST_CPU_THROTTLING_CLOCK_CGROUP_ROOT"
+#define DEFAULT_PSI_PATH GST_CPU_THROTTLING_CLOCK_DEFAULT_PSI_PATH
+#define DEFAULT_PRESSURE_THRESHOLD 0.0
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+#define DEFAULT_ACCOUNTING GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE
+#else
+#define DEFAULT_ACCOUNTING GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS
+#endif
+
+typedef enum
+{
+  PRESSURE_CPU,
+  PRESSURE_IO,
+  PRESSURE_MEMORY,
+  N_PRESSURES
+} Pressure;
+
+static const gchar *pressure_names[N_PRESSURES] = { "cpu", "io", "memory" };
+
+/* A thread sleeping to pay what it overdrew from the CPU budget */
+typedef struct
+{
+  GstPoll *timer;
+  /* The entry the thread waits on while sleeping, protected by the
+   * object lock */
+  GstClockEntry *entry;
+} Sleeper;
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+typedef struct
+{
+  clockid_t clock_id;
+  GstClockTime cpu_time;
+  /* CPU time of the thread when it started being accounted, threads come
+   * from the GstTask pool and may have run other pipelines before */
+  GstClockTime start_cpu_time;
+} ThreadCpuClock;
+#endif
+
 struct _GstCpuThrottlingClockPrivate
 {
   guint wanted_cpu_usage;
 
   GstClock *sclock;
+  /* Sleep owed to the CPU budget at the last wait */
   GstClockTime current_wait_time;
-  GstPoll *timer;
-  struct rusage last_usage;
 
   GstClockID evaluate_wait_time;
   GstClockTime time_between_evals;
+
+  /* PID controller state, protected by the object lock */
+  gdouble kp, ki, kd;
+  gdouble integral;
+  gdouble last_error;
+  gdouble measured_usage;
+  GstClockTime last_cpu_time;
+  GstClockTime last_eval_time;
+  /* Target usage lowered by the controller */
+  gdouble allowed_usage;
+  /* Whether a thread slept since the last evaluation */
+  gboolean slept;
+
+  /* CPU budget token bucket in nanoseconds of CPU time, negative when
+   * overdrawn, protected by the object lock */
+  gdouble tokens;
+  GstClockTime bucket_time;
+  GstClockTime bucket_cpu_time;
+
+  GstCpuThrottlingClockAccounting accounting;
+  /* GThread -> ThreadCpuClock, protected by the object lock */
+  GHashTable *threads;
+  /* CPU time of the threads that have been removed */
+  GstClockTime retired_cpu_time;
+
+  gchar *cgroup_root;
+  gchar *cgroup_path;
+  gchar *detected_cgroup_path;
+  gboolean cfs_throttling_feedback;
+  GstClockTime last_throttled_time;
+  gdouble effective_cpus;
+
+  gchar *psi_path;
+  /* Stall percentages above which to back off, 0 to ignore */
+  gdouble pressure_thresholds[N_PRESSURES];
+  GstClockTime last_stall_times[N_PRESSURES];
+
+  GstCpuGovernor *governor;
+  guint weight;
+  gdouble target_usage;
+
+  GstClockTime min_sleep_time;
+  /* GThread -> Sleeper, protected by the object lock */
+  GHashTable *sleepers;
+
+  /* Statistics, protected by the object lock */
+  guint64 n_waits;
+  guint64 n_sleeps;
+  GstClockTime total_sleep_time;
+  guint64 sleep_histogram[N_SLEEP_BUCKETS];
+  GstClockTime stats_interval;
+  GstClockTime last_stats_time;
 };
 
 
@@ -48,26 +222,474 @@ enum
 {
   PROP_FIRST,
   PROP_CPU_USAGE,
+  PROP_PROPORTIONAL_GAIN,
+  PROP_INTEGRAL_GAIN,
+  PROP_DERIVATIVE_GAIN,
+  PROP_EVALUATION_INTERVAL,
+  PROP_ACCOUNTING,
+  PROP_CGROUP_ROOT,
+  PROP_CGROUP_PATH,
+  PROP_CFS_THROTTLING_FEEDBACK,
+  PROP_GOVERNOR,
+  PROP_WEIGHT,
+  PROP_PSI_PATH,
+  PROP_CPU_PRESSURE_THRESHOLD,
+  PROP_IO_PRESSURE_THRESHOLD,
+  PROP_MEMORY_PRESSURE_THRESHOLD,
+  PROP_MIN_SLEEP_TIME,
+  PROP_MEASURED_USAGE,
+  PROP_TARGET_USAGE,
+  PROP_ALLOWED_USAGE,
+  PROP_WAIT_TIME,
+  PROP_N_WAITS,
+  PROP_TOTAL_SLEEP_TIME,
+  PROP_STATS_INTERVAL,
   PROP_LAST
 };
 
+enum
+{
+  SIGNAL_STATS,
+  SIGNAL_LAST
+};
+
 static GParamSpec *param_specs[PROP_LAST] = { NULL, };
+static guint signals[SIGNAL_LAST] = { 0, };
 /* *INDENT-ON* */
 
+#define C_ENUM(v) ((gint) v)
+
+GType
+gst_cpu_throttling_clock_accounting_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {C_ENUM (GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS),
+        "GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS", "process"},
+    {C_ENUM (GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE),
+        "GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE", "pipeline"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp =
+        g_enum_register_static ("GstCpuThrottlingClockAccounting", values);
+    g_once_init_leave (&id, tmp);
+  }
+
+  return (GType) id;
+}
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+/* Must be called with the object lock */
+static gboolean
+thread_cpu_clock_update (ThreadCpuClock * tclock)
+{
+  struct timespec ts;
+
+  if (clock_gettime (tclock->clock_id, &ts) != 0)
+    return FALSE;
+
+  tclock->cpu_time = GST_TIMESPEC_TO_TIME (ts);
+
+  return TRUE;
+}
+
+/* CPU time consumed by the thread since it has been registered */
+static GstClockTime
+thread_cpu_clock_get_used (ThreadCpuClock * tclock)
+{
+  return tclock->cpu_time - tclock->start_cpu_time;
+}
+
+/* Must be called with the object lock */
+static void
+add_thread_unlocked (GstCpuThrottlingClock * self)
+{
+  clockid_t clock_id;
+  ThreadCpuClock *tclock;
+  GThread *thread = g_thread_self ();
+
+  if (g_hash_table_contains (self->priv->threads, thread))
+    return;
+
+  if (pthread_getcpuclockid (pthread_self (), &clock_id) != 0) {
+    GST_WARNING_OBJECT (self, "Could not get CPU clock of current thread");
+    return;
+  }
+
+  tclock = g_slice_new0 (ThreadCpuClock);
+  tclock->clock_id = clock_id;
+  thread_cpu_clock_update (tclock);
+  tclock->start_cpu_time = tclock->cpu_time;
+
+  GST_DEBUG_OBJECT (self, "Accounting CPU time of thread %p", thread);
+  g_hash_table_insert (self->priv->threads, thread, tclock);
+}
+
+static void
+thread_cpu_clock_free (ThreadCpuClock * tclock)
+{
+  g_slice_free (ThreadCpuClock, tclock);
+}
+#endif
+
+static void
+sleeper_free (Sleeper * sleeper)
+{
+  if (sleeper->timer)
+    gst_poll_free (sleeper->timer);
+  g_slice_free (Sleeper, sleeper);
+}
+
+static gchar *
+get_default_cgroup_root (void)
+{
+  const gchar *root = g_getenv (CGROUP_ROOT_ENV);
+
+  return g_strdup (root && *root ? root : DEFAULT_CGROUP_ROOT);
+}
+
+/* Whether @path is @root or one of its descendants */
+static gboolean
+path_is_under (const gchar * path, const gchar * root)
+{
+  gsize len = strlen (root);
+
+  while (len > 1 && root[len - 1] == G_DIR_SEPARATOR)
+    len--;
+
+  return !strncmp (path, root, len) && (path[len] == '\0' ||
+      path[len] == G_DIR_SEPARATOR);
+}
+
+static gchar *
+detect_cgroup_path (const gchar * cgroup_root)
+{
+  gchar *contents = NULL, **lines, *path = NULL;
+  guint i;
+
+  if (!g_file_get_contents ("/proc/self/cgroup", &contents, NULL, NULL))
+    return NULL;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    /* Entry of the cgroup v2 unified hierarchy */
+    if (g_str_has_prefix (lines[i], "0::")) {
+      path = g_build_filename (cgroup_root, lines[i] + 3, NULL);
+      break;
+    }
+  }
+
+  g_strfreev (lines);
+  g_free (contents);
+
+  return path;
+}
+
+/* Returns the number of CPUs granted by the cpu.max quota of @dir,
+ * or -1 if there is no quota */
+static gdouble
+read_cgroup_cpu_quota (const gchar * dir)
+{
+  gchar quota[32];
+  guint64 period;
+  gdouble res = -1;
+  gchar *contents = NULL, *filename = g_build_filename (dir, "cpu.max", NULL);
+
+  if (g_file_get_contents (filename, &contents, NULL, NULL) &&
+      sscanf (contents, "%31s %" G_GUINT64_FORMAT, quota, &period) == 2 &&
+      g_strcmp0 (quota, "max") && period > 0)
+    res = g_ascii_strtod (quota, NULL) / period;
+
+  g_free (contents);
+  g_free (filename);
+
+  return res;
+}
+
+static GstClockTime
+read_cgroup_throttled_time (const gchar * dir)
+{
+  guint i;
+  gchar **lines;
+  GstClockTime res = GST_CLOCK_TIME_NONE;
+  gchar *contents = NULL, *filename = g_build_filename (dir, "cpu.stat", NULL);
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    goto done;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    if (g_str_has_prefix (lines[i], "throttled_usec ")) {
+      res = g_ascii_strtoull (lines[i] + strlen ("throttled_usec "), NULL, 10)
+          * GST_USECOND;
+      break;
+    }
+  }
+  g_strfreev (lines);
+
+done:
+  g_free (contents);
+  g_free (filename);
+
+  return res;
+}
+
+/* Returns the total time some tasks were stalled on @pressure as reported
+ * by the `some` line of the PSI file in @dir */
+static GstClockTime
+read_stall_time (const gchar * dir, Pressure pressure)
+{
+  guint i;
+  gchar **lines, *total;
+  GstClockTime res = GST_CLOCK_TIME_NONE;
+  gchar *contents = NULL, *filename = g_build_filename (dir,
+      pressure_names[pressure], NULL);
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    goto done;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    if (g_str_has_prefix (lines[i], "some ") &&
+        (total = strstr (lines[i], " total="))) {
+      res = g_ascii_strtoull (total + strlen (" total="), NULL, 10)
+          * GST_USECOND;
+      break;
+    }
+  }
+  g_strfreev (lines);
+
+done:
+  g_free (contents);
+  g_free (filename);
+
+  return res;
+}
+
+/* Number of CPUs the process can effectively use given its affinity
+ * and the quotas of @cgroup_path and of its parents up to @cgroup_root */
+static gdouble
+get_effective_cpus (const gchar * cgroup_path, const gchar * cgroup_root)
+{
+  gchar *dir;
+  gdouble cpus = 0;
+
+#ifdef HAVE_SCHED_GETAFFINITY
+  cpu_set_t set;
+
+  CPU_ZERO (&set);
+  if (sched_getaffinity (0, sizeof (set), &set) == 0)
+    cpus = CPU_COUNT (&set);
+#endif
+
+  if (cpus <= 0)
+    cpus = g_get_num_processors ();
+
+  if (!cgroup_path)
+    return cpus;
+
+  dir = g_strdup (cgroup_path);
+  while (TRUE) {
+    gchar *parent;
+    gdouble quota = read_cgroup_cpu_quota (dir);
+
+    if (quota > 0)
+      cpus = MIN (cpus, quota);
+
+    if (!path_is_under (dir, cgroup_root) || !g_strcmp0 (dir, cgroup_root))
+      break;
+
+    parent = g_path_get_dirname (dir);
+    if (!g_strcmp0 (parent, dir) || !path_is_under (parent, cgroup_root)) {
+      g_free (parent);
+      break;
+    }
+
+    g_free (dir);
+    dir = parent;
+  }
+  g_free (dir);
+
+  return cpus;
+}
+
+/**
+ * gst_cpu_throttling_clock_add_thread:
+ * @self: The #GstCpuThrottlingClock
+ *
+ * Starts accounting the CPU time of the calling thread when using the
+ * #GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE mode. This is meant to be
+ * called from the streaming threads of the throttled pipeline. Only the CPU
+ * time consumed from now on is accounted, not the one the thread consumed
+ * before, when it ran another pipeline for example.
+ */
+void
+gst_cpu_throttling_clock_add_thread (GstCpuThrottlingClock * self)
+{
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  GST_OBJECT_LOCK (self);
+  add_thread_unlocked (self);
+  GST_OBJECT_UNLOCK (self);
+#endif
+}
+
+/**
+ * gst_cpu_throttling_clock_remove_thread:
+ * @self: The #GstCpuThrottlingClock
+ *
+ * Stops accounting the CPU time of the calling thread, the CPU time it
+ * consumed since gst_cpu_throttling_clock_add_thread() is kept in the
+ * total. This must be called from the
+ * thread itself before it exits.
+ */
+void
+gst_cpu_throttling_clock_remove_thread (GstCpuThrottlingClock * self)
+{
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  ThreadCpuClock *tclock;
+  GThread *thread = g_thread_self ();
+
+  GST_OBJECT_LOCK (self);
+  tclock = g_hash_table_lookup (self->priv->threads, thread);
+  if (tclock) {
+    thread_cpu_clock_update (tclock);
+    self->priv->retired_cpu_time += thread_cpu_clock_get_used (tclock);
+    g_hash_table_remove (self->priv->threads, thread);
+  }
+  g_hash_table_remove (self->priv->sleepers, thread);
+  GST_OBJECT_UNLOCK (self);
+#else
+  GST_OBJECT_LOCK (self);
+  g_hash_table_remove (self->priv->sleepers, g_thread_self ());
+  GST_OBJECT_UNLOCK (self);
+#endif
+}
+
+static void
+gst_cpu_throttling_clock_reset_evaluation (GstCpuThrottlingClock * self)
+{
+  GstClockID id;
+
+  GST_OBJECT_LOCK (self);
+  id = self->priv->evaluate_wait_time;
+  self->priv->evaluate_wait_time = 0;
+  GST_OBJECT_UNLOCK (self);
+
+  if (id) {
+    gst_clock_id_unschedule (id);
+    gst_clock_id_unref (id);
+  }
+}
+
+static void
+gst_cpu_throttling_clock_set_governor (GstCpuThrottlingClock * self,
+    GstCpuGovernor * governor, guint weight)
+{
+  GstCpuGovernor *old;
+
+  GST_OBJECT_LOCK (self);
+  old = self->priv->governor;
+  self->priv->governor = governor ? gst_object_ref (governor) : NULL;
+  self->priv->weight = weight;
+  GST_OBJECT_UNLOCK (self);
+
+  if (old && old != governor)
+    gst_cpu_governor_unregister (old, self);
+
+  if (governor)
+    gst_cpu_governor_register (governor, self, weight);
+
+  if (old)
+    gst_object_unref (old);
+}
+
 static void
 gst_cpu_throttling_clock_get_property (GObject * object,
     guint property_id, GValue * value, GParamSpec * pspec)
 {
   GstCpuThrottlingClock *self = GST_CPU_THROTTLING_CLOCK (object);
 
+  GST_OBJECT_LOCK (self);
   switch (property_id) {
     case PROP_CPU_USAGE:
       g_value_set_uint (value, self->priv->wanted_cpu_usage);
       break;
+    case PROP_PROPORTIONAL_GAIN:
+      g_value_set_double (value, self->priv->kp);
+      break;
+    case PROP_INTEGRAL_GAIN:
+      g_value_set_double (value, self->priv->ki);
+      break;
+    case PROP_DERIVATIVE_GAIN:
+      g_value_set_double (value, self->priv->kd);
+      break;
+    case PROP_EVALUATION_INTERVAL:
+      g_value_set_uint64 (value, self->priv->time_between_evals);
+      break;
+    case PROP_ACCOUNTING:
+      g_value_set_enum (value, self->priv->accounting);
+      break;
+    case PROP_CGROUP_ROOT:
+      g_value_set_string (value, self->priv->cgroup_root);
+      break;
+    case PROP_CGROUP_PATH:
+      g_value_set_string (value, self->priv->cgroup_path ?
+          self->priv->cgroup_path : self->priv->detected_cgroup_path);
+      break;
+    case PROP_CFS_THROTTLING_FEEDBACK:
+      g_value_set_boolean (value, self->priv->cfs_throttling_feedback);
+      break;
+    case PROP_GOVERNOR:
+      g_value_set_object (value, self->priv->governor);
+      break;
+    case PROP_WEIGHT:
+      g_value_set_uint (value, self->priv->weight);
+      break;
+    case PROP_PSI_PATH:
+      g_value_set_string (value, self->priv->psi_path);
+      break;
+    case PROP_CPU_PRESSURE_THRESHOLD:
+      g_value_set_double (value,
+          self->priv->pressure_thresholds[PRESSURE_CPU]);
+      break;
+    case PROP_IO_PRESSURE_THRESHOLD:
+      g_value_set_double (value, self->priv->pressure_thresholds[PRESSURE_IO]);
+      break;
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+      g_value_set_double (value,
+          self->priv->pressure_thresholds[PRESSURE_MEMORY]);
+      break;
+    case PROP_MIN_SLEEP_TIME:
+      g_value_set_uint64 (value, self->priv->min_sleep_time);
+      break;
+    case PROP_MEASURED_USAGE:
+      g_value_set_double (value, self->priv->measured_usage);
+      break;
+    case PROP_TARGET_USAGE:
+      g_value_set_double (value, self->priv->target_usage);
+      break;
+    case PROP_ALLOWED_USAGE:
+      g_value_set_double (value, self->priv->allowed_usage);
+      break;
+    case PROP_WAIT_TIME:
+      g_value_set_uint64 (value, self->priv->current_wait_time);
+      break;
+    case PROP_N_WAITS:
+      g_value_set_uint64 (value, self->priv->n_waits);
+      break;
+    case PROP_TOTAL_SLEEP_TIME:
+      g_value_set_uint64 (value, self->priv->total_sleep_time);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, self->priv->stats_interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
   }
+  GST_OBJECT_UNLOCK (self);
 }
 
 static void
@@ -78,9 +700,134 @@ gst_cpu_throttling_clock_set_property (GObject * object,
 
   switch (property_id) {
     case PROP_CPU_USAGE:
+      GST_OBJECT_LOCK (self);
       self->priv->wanted_cpu_usage = g_value_get_uint (value);
       if (self->priv->wanted_cpu_usage == 0)
         self->priv->wanted_cpu_usage = 100;
+      /* Lowering the budget applies right away, the controller catches up
+       * at the next evaluation */
+      if (!self->priv->governor)
+        self->priv->allowed_usage = MIN (self->priv->allowed_usage,
+            self->priv->wanted_cpu_usage);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_PROPORTIONAL_GAIN:
+      GST_OBJECT_LOCK (self);
+      self->priv->kp = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_INTEGRAL_GAIN:
+      GST_OBJECT_LOCK (self);
+      self->priv->ki = g_value_get_double (value);
+      self->priv->integral = 0;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_DERIVATIVE_GAIN:
+      GST_OBJECT_LOCK (self);
+      self->priv->kd = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_EVALUATION_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      self->priv->time_between_evals = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+
+      /* Will be rescheduled with the new interval on next wait */
+      gst_cpu_throttling_clock_reset_evaluation (self);
+      break;
+    case PROP_ACCOUNTING:
+      GST_OBJECT_LOCK (self);
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+      self->priv->accounting = g_value_get_enum (value);
+#else
+      if (g_value_get_enum (value) !=
+          GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS)
+        GST_ERROR_OBJECT (self, "Per pipeline CPU accounting not supported "
+            "on that platform");
+#endif
+      /* The CPU time source changed, restart measuring */
+      self->priv->last_eval_time = GST_CLOCK_TIME_NONE;
+      self->priv->bucket_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CGROUP_ROOT:
+    {
+      gchar *root = g_value_dup_string (value), *detected;
+
+      if (!root)
+        root = get_default_cgroup_root ();
+      detected = detect_cgroup_path (root);
+
+      GST_OBJECT_LOCK (self);
+      g_free (self->priv->cgroup_root);
+      self->priv->cgroup_root = root;
+      g_free (self->priv->detected_cgroup_path);
+      self->priv->detected_cgroup_path = detected;
+      self->priv->last_throttled_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    }
+    case PROP_CGROUP_PATH:
+      GST_OBJECT_LOCK (self);
+      g_free (self->priv->cgroup_path);
+      self->priv->cgroup_path = g_value_dup_string (value);
+      self->priv->last_throttled_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CFS_THROTTLING_FEEDBACK:
+      GST_OBJECT_LOCK (self);
+      self->priv->cfs_throttling_feedback = g_value_get_boolean (value);
+      self->priv->last_throttled_time = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_GOVERNOR:
+      gst_cpu_throttling_clock_set_governor (self, g_value_get_object (value),
+          self->priv->weight);
+      break;
+    case PROP_WEIGHT:
+      gst_cpu_throttling_clock_set_governor (self, self->priv->governor,
+          g_value_get_uint (value));
+      break;
+    case PROP_PSI_PATH:
+    {
+      guint i;
+
+      GST_OBJECT_LOCK (self);
+      g_free (self->priv->psi_path);
+      self->priv->psi_path = g_value_dup_string (value);
+      if (!self->priv->psi_path)
+        self->priv->psi_path = g_strdup (DEFAULT_PSI_PATH);
+      for (i = 0; i < N_PRESSURES; i++)
+        self->priv->last_stall_times[i] = GST_CLOCK_TIME_NONE;
+      GST_OBJECT_UNLOCK (self);
+      break;
+    }
+    case PROP_CPU_PRESSURE_THRESHOLD:
+      GST_OBJECT_LOCK (self);
+      self->priv->pressure_thresholds[PRESSURE_CPU] =
+          g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_IO_PRESSURE_THRESHOLD:
+      GST_OBJECT_LOCK (self);
+      self->priv->pressure_thresholds[PRESSURE_IO] = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+      GST_OBJECT_LOCK (self);
+      self->priv->pressure_thresholds[PRESSURE_MEMORY] =
+          g_value_get_double (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_MIN_SLEEP_TIME:
+      GST_OBJECT_LOCK (self);
+      self->priv->min_sleep_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      self->priv->stats_interval = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -88,44 +835,414 @@ gst_cpu_throttling_clock_set_property (GObject * object,
   }
 }
 
+static GstClockTime
+gst_cpu_throttling_clock_get_process_cpu_time (GstCpuThrottlingClock * self)
+{
+  struct rusage ru;
+
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  GHashTableIter iter;
+  ThreadCpuClock *tclock;
+  GstClockTime cpu_time;
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->accounting == GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE) {
+    cpu_time = self->priv->retired_cpu_time;
+
+    g_hash_table_iter_init (&iter, self->priv->threads);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & tclock)) {
+      if (!thread_cpu_clock_update (tclock)) {
+        /* Thread exited without being removed, keep what we last saw */
+        self->priv->retired_cpu_time += thread_cpu_clock_get_used (tclock);
+        cpu_time += thread_cpu_clock_get_used (tclock);
+        g_hash_table_iter_remove (&iter);
+        continue;
+      }
+
+      cpu_time += thread_cpu_clock_get_used (tclock);
+    }
+    GST_OBJECT_UNLOCK (self);
+
+    return cpu_time;
+  }
+  GST_OBJECT_UNLOCK (self);
+#endif
+
+  getrusage (RUSAGE_SELF, &ru);
+
+  return GST_TIMEVAL_TO_TIME (ru.ru_utime) + GST_TIMEVAL_TO_TIME (ru.ru_stime);
+}
+
+/* Must be called with the object lock */
+static GstStructure *
+get_stats_unlocked (GstCpuThrottlingClock * self)
+{
+  guint i;
+  GValue histogram = G_VALUE_INIT;
+  GstCpuThrottlingClockPrivate *priv = self->priv;
+  GstStructure *stats = gst_structure_new ("cpu-throttle-stats",
+      "measured-usage", G_TYPE_DOUBLE, priv->measured_usage,
+      "target-usage", G_TYPE_DOUBLE, priv->target_usage,
+      "allowed-usage", G_TYPE_DOUBLE, priv->allowed_usage,
+      "wait-time", G_TYPE_UINT64, priv->current_wait_time,
+      "n-waits", G_TYPE_UINT64, priv->n_waits,
+      "n-sleeps", G_TYPE_UINT64, priv->n_sleeps,
+      "total-sleep-time", G_TYPE_UINT64, priv->total_sleep_time, NULL);
+
+  g_value_init (&histogram, GST_TYPE_ARRAY);
+  for (i = 0; i < N_SLEEP_BUCKETS; i++) {
+    GValue v = G_VALUE_INIT;
+
+    g_value_init (&v, G_TYPE_UINT64);
+    g_value_set_uint64 (&v, priv->sleep_histogram[i]);
+    gst_value_array_append_and_take_value (&histogram, &v);
+  }
+  gst_structure_take_value (stats, "sleep-histogram", &histogram);
+
+  return stats;
+}
+
+/**
+ * gst_cpu_throttling_clock_get_stats:
+ * @self: The #GstCpuThrottlingClock
+ *
+ * Gets the statistics of the clock as a `cpu-throttle-stats` structure
+ * with the following fields:
+ *
+ * - `measured-usage` (double): the CPU usage measured during the last
+ *   evaluation, in percent of the available CPUs.
+ * - `target-usage` (double): the CPU usage the controller aims at.
+ * - `allowed-usage` (double): the rate the CPU budget is refilled at, the
+ *   target usage lowered by the controller.
+ * - `wait-time` (guint64): the sleep owed to the CPU budget at the last
+ *   clock wait.
+ * - `n-waits` (guint64): the number of clock waits so far.
+ * - `n-sleeps` (guint64): the number of sleeps so far.
+ * - `total-sleep-time` (guint64): the time slept so far.
+ * - `sleep-histogram` (#GstValueArray of guint64): element 0 counts the
+ *   sleeps shorter than 1 microsecond, element i the sleeps lasting
+ *   between 2^(i-1) and 2^i microseconds, the last one also counting the
+ *   longer sleeps.
+ *
+ * Returns: (transfer full): The statistics of the clock
+ */
+GstStructure *
+gst_cpu_throttling_clock_get_stats (GstCpuThrottlingClock * self)
+{
+  GstStructure *stats;
+
+  g_return_val_if_fail (GST_IS_CPU_THROTTLING_CLOCK (self), NULL);
+
+  GST_OBJECT_LOCK (self);
+  stats = get_stats_unlocked (self);
+  GST_OBJECT_UNLOCK (self);
+
+  return stats;
+}
+
+/**
+ * gst_cpu_throttling_clock_evaluate:
+ * @self: The #GstCpuThrottlingClock
+ * @now: The current time
+ *
+ * Runs one step of the controller: measures the CPU usage since the
+ * previous evaluation and updates the rate the CPU budget is refilled at.
+ * This is called periodically from the system clock, it is exposed so
+ * that test harnesses can drive the controller with a synthetic time base.
+ */
+void
+gst_cpu_throttling_clock_evaluate (GstCpuThrottlingClock * self,
+    GstClockTime now)
+{
+  guint i;
+  gchar *cgroup_root, *cgroup_path, *psi_path;
+  GstCpuGovernor *governor = NULL;
+  gboolean cfs_feedback;
+  GstClockTime cpu_time, elapsed, throttled_time = GST_CLOCK_TIME_NONE;
+  GstClockTime stall_times[N_PRESSURES];
+  GstStructure *stats = NULL;
+  gdouble thresholds[N_PRESSURES];
+  gdouble usage, error, dt, derivative, output, effective_cpus;
+  gdouble max_correction;
+  gdouble pressure_excess = 0;
+  GstCpuThrottlingClockPrivate *priv = self->priv;
+
+  GST_OBJECT_LOCK (self);
+  cgroup_root = g_strdup (priv->cgroup_root);
+  cgroup_path = g_strdup (priv->cgroup_path ? priv->cgroup_path :
+      priv->detected_cgroup_path);
+  cfs_feedback = priv->cfs_throttling_feedback;
+  psi_path = g_strdup (priv->psi_path);
+  memcpy (thresholds, priv->pressure_thresholds, sizeof (thresholds));
+  if (priv->governor)
+    governor = gst_object_ref (priv->governor);
+  GST_OBJECT_UNLOCK (self);
+
+  /* Do the I/O without holding the lock */
+  effective_cpus = get_effective_cpus (cgroup_path, cgroup_root);
+  if (cfs_feedback && cgroup_path)
+    throttled_time = read_cgroup_throttled_time (cgroup_path);
+  g_free (cgroup_path);
+  g_free (cgroup_root);
+
+  for (i = 0; i < N_PRESSURES; i++)
+    stall_times[i] = thresholds[i] > 0 ?
+        read_stall_time (psi_path, i) : GST_CLOCK_TIME_NONE;
+  g_free (psi_path);
+
+  cpu_time = GST_CPU_THROTTLING_CLOCK_GET_CLASS (self)->get_cpu_time (self);
+
+  GST_OBJECT_LOCK (self);
+  priv->effective_cpus = effective_cpus;
+  if (!GST_CLOCK_TIME_IS_VALID (priv->last_eval_time) ||
+      now <= priv->last_eval_time) {
+    priv->last_eval_time = now;
+    priv->last_cpu_time = cpu_time;
+    priv->last_throttled_time = throttled_time;
+    memcpy (priv->last_stall_times, stall_times, sizeof (stall_times));
+    GST_OBJECT_UNLOCK (self);
+
+    if (governor)
+      gst_object_unref (governor);
+
+    return;
+  }
+
+  elapsed = now - priv->last_eval_time;
+  usage = gst_guint64_to_gdouble (cpu_time - priv->last_cpu_time) * 100 /
+      gst_guint64_to_gdouble (elapsed) / effective_cpus;
+
+  priv->last_eval_time = now;
+  priv->last_cpu_time = cpu_time;
+  priv->measured_usage = usage;
+
+  /* The usage was measured against the target of the interval that just
+   * ended, which the governor or a new cpu-usage may be about to change */
+  error = usage - priv->target_usage;
+
+  /* The governor never calls back into its members so it is safe to
+   * call it with our lock held */
+  if (governor)
+    priv->target_usage = gst_cpu_governor_update (governor, self, usage,
+        priv->slept);
+  else
+    priv->target_usage = priv->wanted_cpu_usage;
+  priv->slept = FALSE;
+
+  dt = gst_guint64_to_gdouble (elapsed) / GST_SECOND;
+
+  /* Being throttled by the kernel means we are over the cgroup quota
+   * whatever we measured, push the controller by the throttled ratio */
+  if (GST_CLOCK_TIME_IS_VALID (throttled_time) &&
+      GST_CLOCK_TIME_IS_VALID (priv->last_throttled_time) &&
+      throttled_time > priv->last_throttled_time) {
+    gdouble throttled = gst_guint64_to_gdouble (throttled_time -
+        priv->last_throttled_time) * 100 / gst_guint64_to_gdouble (elapsed);
+
+    GST_DEBUG_OBJECT (self, "CFS throttled %f%% of the time", throttled);
+    error = MAX (error, 0) + throttled;
+  }
+  priv->last_throttled_time = throttled_time;
+
+  /* Back off by how much the worst stall exceeds its threshold */
+  for (i = 0; i < N_PRESSURES; i++) {
+    if (GST_CLOCK_TIME_IS_VALID (stall_times[i]) &&
+        GST_CLOCK_TIME_IS_VALID (priv->last_stall_times[i]) &&
+        stall_times[i] >= priv->last_stall_times[i]) {
+      gdouble stall = gst_guint64_to_gdouble (stall_times[i] -
+          priv->last_stall_times[i]) * 100 / gst_guint64_to_gdouble (elapsed);
+
+      GST_LOG_OBJECT (self, "%s pressure: %f%%", pressure_names[i], stall);
+      if (stall > thresholds[i])
+        pressure_excess = MAX (pressure_excess, stall - thresholds[i]);
+    }
+    priv->last_stall_times[i] = stall_times[i];
+  }
+
+  if (pressure_excess > 0) {
+    GST_DEBUG_OBJECT (self, "Stall pressure %f%% over threshold",
+        pressure_excess);
+    error = MAX (error, 0) + pressure_excess;
+  }
+
+  /* The correction never takes the whole budget away */
+  max_correction = MAX (priv->target_usage - MIN_ALLOWED_USAGE, 0);
+
+  /* Anti windup: the integral term alone never exceeds the output range */
+  priv->integral += error * dt;
+  if (priv->ki > 0)
+    priv->integral = CLAMP (priv->integral, 0, max_correction / priv->ki);
+  else
+    priv->integral = 0;
+
+  derivative = (error - priv->last_error) / dt;
+  priv->last_error = error;
+
+  output = priv->kp * error + priv->ki * priv->integral + priv->kd * derivative;
+  priv->allowed_usage = priv->target_usage -
+      CLAMP (output, 0, max_correction);
+
+  GST_DEBUG_OBJECT (self, "Avg is %f (wanted %f, %f CPUs) => allowing %f",
+      usage, priv->target_usage, effective_cpus, priv->allowed_usage);
+
+  if (priv->stats_interval && (!GST_CLOCK_TIME_IS_VALID (priv->last_stats_time)
+          || now >= priv->last_stats_time + priv->stats_interval)) {
+    priv->last_stats_time = now;
+    stats = get_stats_unlocked (self);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (stats) {
+    g_signal_emit (self, signals[SIGNAL_STATS], 0, stats);
+    gst_structure_free (stats);
+  }
+
+  if (governor)
+    gst_object_unref (governor);
+}
+
 static gboolean
 gst_transcoder_adjust_wait_time (GstClock * sync_clock, GstClockTime time,
     GstClockID id, GstCpuThrottlingClock * self)
 {
-  struct rusage ru;
-  float delta_usage, usage, coef;
+  gst_cpu_throttling_clock_evaluate (self, gst_clock_get_time (sync_clock));
+
+  return TRUE;
+}
 
+/* Must be called with the object lock */
+static GstClockTime
+charge_unlocked (GstCpuThrottlingClock * self, GstClockTime now,
+    GstClockTime cpu_time)
+{
+  gdouble rate, sleep_time;
   GstCpuThrottlingClockPrivate *priv = self->priv;
 
-  getrusage (RUSAGE_SELF, &ru);
-  delta_usage = GST_TIMEVAL_TO_TIME (ru.ru_utime) -
-      GST_TIMEVAL_TO_TIME (self->priv->last_usage.ru_utime);
-  usage =
-      ((float) delta_usage / self->priv->time_between_evals * 100) /
-      g_get_num_processors ();
+  /* Nanoseconds of CPU time granted per nanosecond */
+  rate = priv->allowed_usage * priv->effective_cpus / 100;
 
-  self->priv->last_usage = ru;
+  if (!GST_CLOCK_TIME_IS_VALID (priv->bucket_time) ||
+      now < priv->bucket_time || cpu_time < priv->bucket_cpu_time ||
+      rate <= 0) {
+    priv->tokens = 0;
+    priv->bucket_time = now;
+    priv->bucket_cpu_time = cpu_time;
+    priv->current_wait_time = 0;
 
-  coef = GST_MSECOND / 10;
-  if (usage < (gfloat) priv->wanted_cpu_usage) {
-    coef = -coef;
+    return 0;
   }
 
-  priv->current_wait_time = CLAMP (0,
-      (GstClockTime) priv->current_wait_time + coef, GST_SECOND);
+  priv->tokens += rate * gst_guint64_to_gdouble (now - priv->bucket_time);
+  priv->tokens -= gst_guint64_to_gdouble (cpu_time - priv->bucket_cpu_time);
+  /* Only bank what a single sleep would have covered, an idle pipeline
+   * must not be able to burst over its budget for a whole interval */
+  priv->tokens = MIN (priv->tokens,
+      rate * gst_guint64_to_gdouble (priv->min_sleep_time));
+  priv->bucket_time = now;
+  priv->bucket_cpu_time = cpu_time;
 
-  GST_DEBUG_OBJECT (self,
-      "Avg is %f (wanted %d) => %" GST_TIME_FORMAT, usage,
-      self->priv->wanted_cpu_usage, GST_TIME_ARGS (priv->current_wait_time));
+  /* Time it takes to refill what was overdrawn */
+  sleep_time = priv->tokens < 0 ? -priv->tokens / rate : 0;
+  priv->current_wait_time = (GstClockTime) MIN (sleep_time, MAX_WAIT_TIME);
 
-  return TRUE;
+  if (!priv->current_wait_time ||
+      priv->current_wait_time < priv->min_sleep_time)
+    return 0;
+
+  return priv->current_wait_time;
+}
+
+/**
+ * gst_cpu_throttling_clock_charge:
+ * @self: The #GstCpuThrottlingClock
+ * @now: The current time
+ *
+ * Refills the CPU budget for the time elapsed since the previous call and
+ * takes the CPU time consumed meanwhile from it. This is called on each
+ * clock wait, it is exposed so that test harnesses can drive the budget
+ * with a synthetic time base.
+ *
+ * Returns: How long the calling thread has to sleep to get back within
+ * the budget, 0 when it owes less than
+ * #GstCpuThrottlingClock:min-sleep-time
+ */
+GstClockTime
+gst_cpu_throttling_clock_charge (GstCpuThrottlingClock * self,
+    GstClockTime now)
+{
+  GstClockTime cpu_time, sleep_time;
+
+  g_return_val_if_fail (GST_IS_CPU_THROTTLING_CLOCK (self), 0);
+
+  cpu_time = GST_CPU_THROTTLING_CLOCK_GET_CLASS (self)->get_cpu_time (self);
+
+  GST_OBJECT_LOCK (self);
+  sleep_time = charge_unlocked (self, now, cpu_time);
+  GST_OBJECT_UNLOCK (self);
+
+  return sleep_time;
+}
+
+/* Sleeps for @sleep_time unless @entry gets unscheduled meanwhile,
+ * returns the time actually slept */
+static GstClockTime
+gst_cpu_throttling_clock_sleep (GstCpuThrottlingClock * self,
+    GstClockEntry * entry, GstClockTime sleep_time)
+{
+  Sleeper *sleeper;
+  GstClockTime start, now;
+  GThread *thread = g_thread_self ();
+
+  GST_OBJECT_LOCK (self);
+  sleeper = g_hash_table_lookup (self->priv->sleepers, thread);
+  if (!sleeper) {
+    sleeper = g_slice_new0 (Sleeper);
+    sleeper->timer = gst_poll_new_timer ();
+    g_hash_table_insert (self->priv->sleepers, thread, sleeper);
+  }
+  sleeper->entry = entry;
+  GST_OBJECT_UNLOCK (self);
+
+  start = now = g_get_monotonic_time () * GST_USECOND;
+  if (G_UNLIKELY (!sleeper->timer)) {
+    GST_WARNING_OBJECT (self, "No timer, sleeping uninterruptibly");
+    g_usleep (GST_TIME_AS_USECONDS (sleep_time));
+    now = g_get_monotonic_time () * GST_USECOND;
+  } else {
+    while (now < start + sleep_time &&
+        GST_CLOCK_ENTRY_STATUS (entry) != GST_CLOCK_UNSCHEDULED) {
+      gint res = gst_poll_wait (sleeper->timer, start + sleep_time - now);
+
+      /* Woken up by _unschedule(), maybe for an entry waited on before */
+      if (res > 0)
+        gst_poll_read_control (sleeper->timer);
+      else if (res < 0 && errno != EINTR && errno != EAGAIN)
+        break;
+
+      now = g_get_monotonic_time () * GST_USECOND;
+    }
+  }
+
+  GST_OBJECT_LOCK (self);
+  sleeper->entry = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  return now - start;
 }
 
 static GstClockReturn
 _wait (GstClock * clock, GstClockEntry * entry, GstClockTimeDiff * jitter)
 {
+  guint bucket;
+  GstClockTime sleep_time, slept;
   GstCpuThrottlingClock *self = GST_CPU_THROTTLING_CLOCK (clock);
 
+  GST_OBJECT_LOCK (self);
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  if (self->priv->accounting == GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE)
+    add_thread_unlocked (self);
+#endif
+
   if (!self->priv->evaluate_wait_time) {
     if (!(self->priv->sclock)) {
       GST_ERROR_OBJECT (clock, "Could not find any system clock"
@@ -142,16 +1259,50 @@ _wait (GstClock * clock, GstClockEntry * entry, GstClockTimeDiff * jitter)
     }
   }
 
+  self->priv->n_waits++;
+  GST_OBJECT_UNLOCK (self);
+
   if (G_UNLIKELY (GST_CLOCK_ENTRY_STATUS (entry) == GST_CLOCK_UNSCHEDULED))
     return GST_CLOCK_UNSCHEDULED;
 
-  if (gst_poll_wait (self->priv->timer, self->priv->current_wait_time)) {
-    GST_INFO_OBJECT (self, "Something happened on the poll");
-  }
+  sleep_time = gst_cpu_throttling_clock_charge (self,
+      gst_clock_get_internal_time (self->priv->sclock));
+  if (!sleep_time)
+    return GST_CLOCK_ENTRY_STATUS (entry);
+
+  slept = gst_cpu_throttling_clock_sleep (self, entry, sleep_time);
+
+  bucket = slept >= GST_USECOND ? g_bit_storage (slept / GST_USECOND) : 0;
+  GST_OBJECT_LOCK (self);
+  self->priv->slept = TRUE;
+  self->priv->n_sleeps++;
+  self->priv->total_sleep_time += slept;
+  self->priv->sleep_histogram[MIN (bucket, N_SLEEP_BUCKETS - 1)]++;
+  GST_OBJECT_UNLOCK (self);
 
   return GST_CLOCK_ENTRY_STATUS (entry);
 }
 
+static void
+_unschedule (GstClock * clock, GstClockEntry * entry)
+{
+  GHashTableIter iter;
+  Sleeper *sleeper;
+  GstCpuThrottlingClock *self = GST_CPU_THROTTLING_CLOCK (clock);
+
+  GST_OBJECT_LOCK (self);
+  GST_CLOCK_ENTRY_STATUS (entry) = GST_CLOCK_UNSCHEDULED;
+
+  g_hash_table_iter_init (&iter, self->priv->sleepers);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) & sleeper)) {
+    if (sleeper->entry == entry && sleeper->timer) {
+      GST_DEBUG_OBJECT (self, "Waking up the thread sleeping on %p", entry);
+      gst_poll_write_control (sleeper->timer);
+    }
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
 static GstClockTime
 _get_internal_time (GstClock * clock)
 {
@@ -165,11 +1316,25 @@ gst_cpu_throttling_clock_dispose (GObject * object)
 {
   GstCpuThrottlingClock *self = GST_CPU_THROTTLING_CLOCK (object);
 
-  if (self->priv->evaluate_wait_time) {
-    gst_clock_id_unschedule (self->priv->evaluate_wait_time);
-    gst_clock_id_unref (self->priv->evaluate_wait_time);
-    self->priv->evaluate_wait_time = 0;
-  }
+  gst_cpu_throttling_clock_reset_evaluation (self);
+  gst_cpu_throttling_clock_set_governor (self, NULL, self->priv->weight);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gst_cpu_throttling_clock_finalize (GObject * object)
+{
+  GstCpuThrottlingClock *self = GST_CPU_THROTTLING_CLOCK (object);
+
+  g_hash_table_unref (self->priv->threads);
+  g_hash_table_unref (self->priv->sleepers);
+  g_free (self->priv->cgroup_root);
+  g_free (self->priv->cgroup_path);
+  g_free (self->priv->detected_cgroup_path);
+  g_free (self->priv->psi_path);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -186,6 +1351,9 @@ gst_cpu_throttling_clock_class_init (GstCpuThrottlingClockClass * klass)
   oclass->get_property = gst_cpu_throttling_clock_get_property;
   oclass->set_property = gst_cpu_throttling_clock_set_property;
   oclass->dispose = gst_cpu_throttling_clock_dispose;
+  oclass->finalize = gst_cpu_throttling_clock_finalize;
+
+  klass->get_cpu_time = gst_cpu_throttling_clock_get_process_cpu_time;
 
   /**
    * GstCpuThrottlingClock:cpu-usage:
@@ -197,26 +1365,329 @@ gst_cpu_throttling_clock_class_init (GstCpuThrottlingClockClass * klass)
       "pipeline driven by the clock", 0, 100,
       100, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  /**
+   * GstCpuThrottlingClock:proportional-gain:
+   *
+   * Percents taken from the allowed usage per percent of CPU usage above
+   * the target.
+   */
+  param_specs[PROP_PROPORTIONAL_GAIN] =
+      g_param_spec_double ("proportional-gain", "Proportional gain",
+      "Proportional gain of the controller in percents of allowed usage per "
+      "percent of error", 0, G_MAXDOUBLE, DEFAULT_PROPORTIONAL_GAIN,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:integral-gain:
+   *
+   * Percents taken from the allowed usage per percent of CPU usage above
+   * the target accumulated during one second. This is what removes the
+   * steady state error of the controller.
+   */
+  param_specs[PROP_INTEGRAL_GAIN] =
+      g_param_spec_double ("integral-gain", "Integral gain",
+      "Integral gain of the controller in percents of allowed usage per "
+      "percent of error per second", 0, G_MAXDOUBLE, DEFAULT_INTEGRAL_GAIN,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:derivative-gain:
+   *
+   * Percents taken from the allowed usage per percent per second of CPU
+   * usage error variation, damps the controller.
+   */
+  param_specs[PROP_DERIVATIVE_GAIN] =
+      g_param_spec_double ("derivative-gain", "Derivative gain",
+      "Derivative gain of the controller in percents of allowed usage per "
+      "percent of error variation per second", 0, G_MAXDOUBLE,
+      DEFAULT_DERIVATIVE_GAIN, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:evaluation-interval:
+   *
+   * Time between two evaluations of the CPU usage.
+   */
+  param_specs[PROP_EVALUATION_INTERVAL] =
+      g_param_spec_uint64 ("evaluation-interval", "Evaluation interval",
+      "Time between two evaluations of the CPU usage", GST_MSECOND,
+      G_MAXUINT64, DEFAULT_EVALUATION_INTERVAL,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:accounting:
+   *
+   * Whether the CPU time of the whole process or only the one of the
+   * pipeline threads is throttled.
+   */
+  param_specs[PROP_ACCOUNTING] =
+      g_param_spec_enum ("accounting", "Accounting",
+      "What CPU time is accounted for",
+      GST_TYPE_CPU_THROTTLING_CLOCK_ACCOUNTING, DEFAULT_ACCOUNTING,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:cgroup-root:
+   *
+   * The mount point of the cgroup v2 hierarchy. The quotas of the parents
+   * of #GstCpuThrottlingClock:cgroup-path are honoured up to that
+   * directory. Defaults to the `GST_CPU_THROTTLING_CLOCK_CGROUP_ROOT`
+   * environment variable, or to `/sys/fs/cgroup` when it is not set.
+   */
+  param_specs[PROP_CGROUP_ROOT] =
+      g_param_spec_string ("cgroup-root", "Cgroup root",
+      "The mount point of the cgroup v2 hierarchy", DEFAULT_CGROUP_ROOT,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:cgroup-path:
+   *
+   * The cgroup v2 directory from which the `cpu.max` quota and the
+   * `cpu.stat` statistics are read. Defaults to the cgroup of the process
+   * as listed in `/proc/self/cgroup`. The quotas of the parent cgroups are
+   * honoured as well when the directory is inside
+   * #GstCpuThrottlingClock:cgroup-root.
+   */
+  param_specs[PROP_CGROUP_PATH] =
+      g_param_spec_string ("cgroup-path", "Cgroup path",
+      "The cgroup v2 directory defining the CPU quota", NULL,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:cfs-throttling-feedback:
+   *
+   * Whether to slow down when the kernel CFS bandwidth control throttled
+   * the cgroup during the last evaluation interval.
+   */
+  param_specs[PROP_CFS_THROTTLING_FEEDBACK] =
+      g_param_spec_boolean ("cfs-throttling-feedback",
+      "CFS throttling feedback",
+      "Back off when the kernel throttled the cgroup",
+      DEFAULT_CFS_THROTTLING_FEEDBACK,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:governor:
+   *
+   * The #GstCpuGovernor sharing its CPU budget with the clock, when set
+   * #GstCpuThrottlingClock:cpu-usage is not used anymore.
+   */
+  param_specs[PROP_GOVERNOR] =
+      g_param_spec_object ("governor", "Governor",
+      "The governor giving the CPU budget", GST_TYPE_CPU_GOVERNOR,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:weight:
+   *
+   * The relative weight of the clock when sharing the budget of the
+   * #GstCpuThrottlingClock:governor.
+   */
+  param_specs[PROP_WEIGHT] = g_param_spec_uint ("weight", "Weight",
+      "The weight of the clock when sharing the governor budget", 1,
+      G_MAXUINT, DEFAULT_WEIGHT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:psi-path:
+   *
+   * The directory containing the `cpu`, `io` and `memory` pressure stall
+   * information files of the host. It can be pointed to a directory
+   * filled with synthetic values for testing.
+   */
+  param_specs[PROP_PSI_PATH] =
+      g_param_spec_string ("psi-path", "PSI path",
+      "The directory containing the pressure stall information files",
+      DEFAULT_PSI_PATH, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:cpu-pressure-threshold:
+   *
+   * The percentage of time some tasks of the host can be stalled waiting
+   * for a CPU before the clock backs off, 0 to ignore the CPU pressure.
+   */
+  param_specs[PROP_CPU_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("cpu-pressure-threshold", "CPU pressure threshold",
+      "Percentage of CPU stall time above which to back off (0 = disabled)",
+      0, 100, DEFAULT_PRESSURE_THRESHOLD,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:io-pressure-threshold:
+   *
+   * The percentage of time some tasks of the host can be stalled waiting
+   * for I/O before the clock backs off, 0 to ignore the I/O pressure.
+   */
+  param_specs[PROP_IO_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("io-pressure-threshold", "I/O pressure threshold",
+      "Percentage of I/O stall time above which to back off (0 = disabled)",
+      0, 100, DEFAULT_PRESSURE_THRESHOLD,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:memory-pressure-threshold:
+   *
+   * The percentage of time some tasks of the host can be stalled waiting
+   * for memory before the clock backs off, 0 to ignore the memory pressure.
+   */
+  param_specs[PROP_MEMORY_PRESSURE_THRESHOLD] =
+      g_param_spec_double ("memory-pressure-threshold",
+      "Memory pressure threshold",
+      "Percentage of memory stall time above which to back off "
+      "(0 = disabled)", 0, 100, DEFAULT_PRESSURE_THRESHOLD,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:min-sleep-time:
+   *
+   * The sleep a thread must owe to the CPU budget before it actually
+   * sleeps, 0 to sleep on every clock wait the budget is overdrawn.
+   */
+  param_specs[PROP_MIN_SLEEP_TIME] =
+      g_param_spec_uint64 ("min-sleep-time", "Minimum sleep time",
+      "Sleep to owe before sleeping (0 = sleep on each overdrawn wait)",
+      0, G_MAXUINT64, DEFAULT_MIN_SLEEP_TIME,
+      G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:measured-usage:
+   *
+   * The CPU usage measured during the last evaluation, in percent of the
+   * available CPUs.
+   */
+  param_specs[PROP_MEASURED_USAGE] =
+      g_param_spec_double ("measured-usage", "Measured usage",
+      "The CPU usage measured during the last evaluation", 0, G_MAXDOUBLE, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:target-usage:
+   *
+   * The CPU usage the controller aims at, either
+   * #GstCpuThrottlingClock:cpu-usage or the share given by the
+   * #GstCpuThrottlingClock:governor.
+   */
+  param_specs[PROP_TARGET_USAGE] =
+      g_param_spec_double ("target-usage", "Target usage",
+      "The CPU usage the controller aims at", 0, G_MAXDOUBLE, 100,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:allowed-usage:
+   *
+   * The CPU usage the budget is refilled at: the
+   * #GstCpuThrottlingClock:target-usage lowered by the controller when the
+   * measured usage is over it or when backing off.
+   */
+  param_specs[PROP_ALLOWED_USAGE] =
+      g_param_spec_double ("allowed-usage", "Allowed usage",
+      "The CPU usage the budget is refilled at", 0, G_MAXDOUBLE, 100,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:wait-time:
+   *
+   * The sleep owed to the CPU budget at the last clock wait.
+   */
+  param_specs[PROP_WAIT_TIME] =
+      g_param_spec_uint64 ("wait-time", "Wait time",
+      "The sleep owed to the CPU budget at the last clock wait", 0,
+      G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:n-waits:
+   *
+   * The number of clock waits so far.
+   */
+  param_specs[PROP_N_WAITS] =
+      g_param_spec_uint64 ("n-waits", "Number of waits",
+      "The number of clock waits so far", 0, G_MAXUINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:total-sleep-time:
+   *
+   * The time slept by the threads waiting on the clock so far.
+   */
+  param_specs[PROP_TOTAL_SLEEP_TIME] =
+      g_param_spec_uint64 ("total-sleep-time", "Total sleep time",
+      "The time slept so far", 0, G_MAXUINT64, 0,
+      G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  /**
+   * GstCpuThrottlingClock:stats-interval:
+   *
+   * Minimum time between two emissions of #GstCpuThrottlingClock::stats,
+   * 0 to disable them.
+   */
+  param_specs[PROP_STATS_INTERVAL] =
+      g_param_spec_uint64 ("stats-interval", "Statistics interval",
+      "Time between two statistics reports (0 = disabled)", 0, G_MAXUINT64,
+      DEFAULT_STATS_INTERVAL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (oclass, PROP_LAST, param_specs);
 
+  /**
+   * GstCpuThrottlingClock::stats:
+   * @clock: The #GstCpuThrottlingClock
+   * @stats: The statistics as returned by
+   * gst_cpu_throttling_clock_get_stats()
+   *
+   * Emitted from the evaluation thread every
+   * #GstCpuThrottlingClock:stats-interval.
+   */
+  signals[SIGNAL_STATS] =
+      g_signal_new ("stats", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+      0, NULL, NULL, NULL, G_TYPE_NONE, 1,
+      GST_TYPE_STRUCTURE | G_SIGNAL_TYPE_STATIC_SCOPE);
+
   clock_klass->wait = GST_DEBUG_FUNCPTR (_wait);
+  clock_klass->unschedule = GST_DEBUG_FUNCPTR (_unschedule);
   clock_klass->get_internal_time = _get_internal_time;
 }
 
 static void
 gst_cpu_throttling_clock_init (GstCpuThrottlingClock * self)
 {
+  guint i;
+
   self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
       GST_TYPE_CPU_THROTTLING_CLOCK, GstCpuThrottlingClockPrivate);
 
-  self->priv->current_wait_time = GST_MSECOND;
+  self->priv->current_wait_time = 0;
   self->priv->wanted_cpu_usage = 100;
-  self->priv->timer = gst_poll_new_timer ();
-  self->priv->time_between_evals = GST_SECOND / 4;
+  self->priv->time_between_evals = DEFAULT_EVALUATION_INTERVAL;
   self->priv->sclock = GST_CLOCK (gst_system_clock_obtain ());
 
+  self->priv->kp = DEFAULT_PROPORTIONAL_GAIN;
+  self->priv->ki = DEFAULT_INTEGRAL_GAIN;
+  self->priv->kd = DEFAULT_DERIVATIVE_GAIN;
+  self->priv->last_eval_time = GST_CLOCK_TIME_NONE;
 
-  getrusage (RUSAGE_SELF, &self->priv->last_usage);
+  self->priv->accounting = DEFAULT_ACCOUNTING;
+  self->priv->cgroup_root = get_default_cgroup_root ();
+  self->priv->detected_cgroup_path =
+      detect_cgroup_path (self->priv->cgroup_root);
+  self->priv->cfs_throttling_feedback = DEFAULT_CFS_THROTTLING_FEEDBACK;
+  self->priv->last_throttled_time = GST_CLOCK_TIME_NONE;
+  self->priv->weight = DEFAULT_WEIGHT;
+  self->priv->psi_path = g_strdup (DEFAULT_PSI_PATH);
+  self->priv->min_sleep_time = DEFAULT_MIN_SLEEP_TIME;
+  self->priv->stats_interval = DEFAULT_STATS_INTERVAL;
+  self->priv->last_stats_time = GST_CLOCK_TIME_NONE;
+  self->priv->sleepers = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) sleeper_free);
+  for (i = 0; i < N_PRESSURES; i++) {
+    self->priv->pressure_thresholds[i] = DEFAULT_PRESSURE_THRESHOLD;
+    self->priv->last_stall_times[i] = GST_CLOCK_TIME_NONE;
+  }
+  self->priv->target_usage = self->priv->wanted_cpu_usage;
+  self->priv->allowed_usage = self->priv->target_usage;
+  self->priv->bucket_time = GST_CLOCK_TIME_NONE;
+#ifdef HAVE_PTHREAD_GETCPUCLOCKID
+  self->priv->threads = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) thread_cpu_clock_free);
+#else
+  self->priv->threads = g_hash_table_new (NULL, NULL);
+#endif
 }
 
 GstCpuThrottlingClock *
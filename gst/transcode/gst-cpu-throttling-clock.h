@@ -31,6 +31,22 @@ typedef struct _GstCpuThrottlingClock GstCpuThrottlingClock;
 typedef struct _GstCpuThrottlingClockClass GstCpuThrottlingClockClass;
 typedef struct _GstCpuThrottlingClockPrivate GstCpuThrottlingClockPrivate;
 
+/**
+ * GstCpuThrottlingClockAccounting:
+ * @GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS: Account the CPU time of the
+ * whole process.
+ * @GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE: Account only the CPU time
+ * of the threads registered with the clock.
+ */
+typedef enum
+{
+  GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PROCESS,
+  GST_CPU_THROTTLING_CLOCK_ACCOUNTING_PIPELINE,
+} GstCpuThrottlingClockAccounting;
+
+#define GST_TYPE_CPU_THROTTLING_CLOCK_ACCOUNTING (gst_cpu_throttling_clock_accounting_get_type ())
+GType gst_cpu_throttling_clock_accounting_get_type (void);
+
 GType gst_cpu_throttling_clock_get_type (void) G_GNUC_CONST;
 
 #define GST_TYPE_CPU_THROTTLING_CLOCK (gst_cpu_throttling_clock_get_type ())
@@ -40,10 +56,18 @@ GType gst_cpu_throttling_clock_get_type (void) G_GNUC_CONST;
 #define GST_IS_CPU_THROTTLING_CLOCK_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CPU_THROTTLING_CLOCK))
 #define GST_CPU_THROTTLING_CLOCK_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_CPU_THROTTLING_CLOCK, GstCpuThrottlingClockClass))
 
+/**
+ * GstCpuThrottlingClockClass:
+ * @get_cpu_time: Returns the CPU time (user and system) consumed so far by
+ * what the clock is throttling.
+ */
 struct _GstCpuThrottlingClockClass
 {
   /*<private>*/
   GstClockClass parent_class;
+
+  /*<public>*/
+  GstClockTime (*get_cpu_time) (GstCpuThrottlingClock * self);
 };
 
 struct _GstCpuThrottlingClock
@@ -53,7 +77,17 @@ struct _GstCpuThrottlingClock
   GstCpuThrottlingClockPrivate *priv;
 };
 
+/* Where the kernel exposes the pressure stall information of the host */
+#define GST_CPU_THROTTLING_CLOCK_DEFAULT_PSI_PATH "/proc/pressure"
+
 GstCpuThrottlingClock * gst_cpu_throttling_clock_new (guint cpu_usage);
+void gst_cpu_throttling_clock_evaluate (GstCpuThrottlingClock * self,
+                                        GstClockTime now);
+GstClockTime gst_cpu_throttling_clock_charge (GstCpuThrottlingClock * self,
+                                              GstClockTime now);
+void gst_cpu_throttling_clock_add_thread (GstCpuThrottlingClock * self);
+void gst_cpu_throttling_clock_remove_thread (GstCpuThrottlingClock * self);
+GstStructure * gst_cpu_throttling_clock_get_stats (GstCpuThrottlingClock * self);
 
 G_END_DECLS
 
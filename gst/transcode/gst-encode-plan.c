@@ -0,0 +1,398 @@
+/*
+ * gst-encode-plan.c
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gst-encode-plan.h"
+
+/**
+ * SECTION: gst-encode-plan
+ * @title: Encoding plans
+ * @short_description: Remember the element factories encodebin picked
+ *
+ * For each profile, encodebin tries the muxers and encoders of the
+ * registry matching the profile formats until one works. Once a
+ * transcoding reached EOS with all its streams either encoded or passed
+ * through, the factories it ended up using, and the caps the encoders
+ * negotiated, are recorded in a process wide plan keyed by the profile.
+ * Following transcodings with the same profile get a copy of the profile
+ * with those factories set as preset names. encodebin still looks up the
+ * candidate factories for each stream, but only instantiates the recorded
+ * one instead of trying the candidates in rank order until one accepts
+ * the stream.
+ *
+ * Plans are checked against the registry before being used and dropped
+ * when one of their factories is gone or can not produce the recorded caps
+ * anymore, encodebin then autoplugs as usual.
+ */
+
+GST_DEBUG_CATEGORY_STATIC (gst_encode_plan_debug);
+#define GST_CAT_DEFAULT gst_encode_plan_debug
+
+typedef struct
+{
+  gchar *muxer;
+
+  /* For each stream profile, in the order of the container profile */
+  guint n_streams;
+  gchar **encoders;
+  GstCaps **caps;
+} EncodePlan;
+
+static GMutex plans_lock;
+/* profile key -> EncodePlan */
+static GHashTable *plans = NULL;
+
+static void
+encode_plan_free (EncodePlan * plan)
+{
+  guint i;
+
+  for (i = 0; i < plan->n_streams; i++) {
+    g_free (plan->encoders[i]);
+    if (plan->caps[i])
+      gst_caps_unref (plan->caps[i]);
+  }
+  g_free (plan->encoders);
+  g_free (plan->caps);
+  g_free (plan->muxer);
+  g_free (plan);
+}
+
+static void
+append_caps (GString * key, GstCaps * caps)
+{
+  gchar *str = caps ? gst_caps_to_string (caps) : NULL;
+
+  g_string_append_printf (key, "%s;", GST_STR_NULL (str));
+  g_free (str);
+  if (caps)
+    gst_caps_unref (caps);
+}
+
+static void
+append_profile_key (GString * key, GstEncodingProfile * profile)
+{
+  g_string_append_printf (key, "%s:%s:%s:%u:", G_OBJECT_TYPE_NAME (profile),
+      GST_STR_NULL (gst_encoding_profile_get_preset (profile)),
+      GST_STR_NULL (gst_encoding_profile_get_preset_name (profile)),
+      gst_encoding_profile_get_presence (profile));
+  append_caps (key, gst_encoding_profile_get_format (profile));
+  append_caps (key, gst_encoding_profile_get_restriction (profile));
+
+  if (GST_IS_ENCODING_CONTAINER_PROFILE (profile)) {
+    const GList *tmp;
+
+    g_string_append_c (key, '[');
+    for (tmp = gst_encoding_container_profile_get_profiles
+        (GST_ENCODING_CONTAINER_PROFILE (profile)); tmp; tmp = tmp->next)
+      append_profile_key (key, tmp->data);
+    g_string_append_c (key, ']');
+  }
+}
+
+static gchar *
+get_profile_key (GstEncodingProfile * profile)
+{
+  GString *key = g_string_new (NULL);
+
+  append_profile_key (key, profile);
+
+  return g_string_free (key, FALSE);
+}
+
+/* Returns the stream profiles, in order, the profile itself when it is
+ * not a container */
+static GList *
+get_stream_profiles (GstEncodingProfile * profile)
+{
+  if (GST_IS_ENCODING_CONTAINER_PROFILE (profile))
+    return g_list_copy ((GList *) gst_encoding_container_profile_get_profiles
+        (GST_ENCODING_CONTAINER_PROFILE (profile)));
+
+  return g_list_append (NULL, profile);
+}
+
+/* Must be called with the plans lock */
+static GHashTable *
+get_plans (void)
+{
+  if (!plans) {
+    GST_DEBUG_CATEGORY_INIT (gst_encode_plan_debug, "encodeplan", 0,
+        "Encoding plans");
+    plans = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) encode_plan_free);
+  }
+
+  return plans;
+}
+
+static gboolean
+factory_is_usable (const gchar * name, GstCaps * caps)
+{
+  gboolean res;
+  GstElementFactory *factory = gst_element_factory_find (name);
+
+  if (!factory)
+    return FALSE;
+
+  res = !caps || gst_element_factory_can_src_any_caps (factory, caps);
+  gst_object_unref (factory);
+
+  return res;
+}
+
+static gboolean
+encode_plan_is_valid (EncodePlan * plan)
+{
+  guint i;
+
+  if (plan->muxer && !factory_is_usable (plan->muxer, NULL))
+    return FALSE;
+
+  for (i = 0; i < plan->n_streams; i++) {
+    if (plan->encoders[i] &&
+        !factory_is_usable (plan->encoders[i], plan->caps[i]))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/**
+ * gst_encode_plan_apply:
+ * @profile: The profile to transcode to
+ *
+ * Returns: (transfer full) (nullable): A copy of @profile with the
+ * factories of its recorded plan set as preset names, %NULL if there is no
+ * usable plan for @profile.
+ */
+GstEncodingProfile *
+gst_encode_plan_apply (GstEncodingProfile * profile)
+{
+  guint i;
+  GList *tmp, *streams;
+  EncodePlan *plan;
+  GstEncodingProfile *copy = NULL;
+  gchar *key = get_profile_key (profile);
+
+  g_mutex_lock (&plans_lock);
+  plan = g_hash_table_lookup (get_plans (), key);
+  if (!plan)
+    goto done;
+
+  if (!encode_plan_is_valid (plan)) {
+    GST_INFO ("Plan for %s does not match the registry anymore", key);
+    g_hash_table_remove (plans, key);
+    goto done;
+  }
+
+  copy = gst_encoding_profile_copy (profile);
+  if (plan->muxer && GST_IS_ENCODING_CONTAINER_PROFILE (copy) &&
+      !gst_encoding_profile_get_preset_name (copy))
+    gst_encoding_profile_set_preset_name (copy, plan->muxer);
+
+  streams = get_stream_profiles (copy);
+  for (tmp = streams, i = 0; tmp && i < plan->n_streams; tmp = tmp->next, i++) {
+    if (plan->encoders[i] && !gst_encoding_profile_get_preset_name (tmp->data))
+      gst_encoding_profile_set_preset_name (tmp->data, plan->encoders[i]);
+  }
+  g_list_free (streams);
+
+  GST_DEBUG ("Using plan for %s", key);
+
+done:
+  g_mutex_unlock (&plans_lock);
+  g_free (key);
+
+  return copy;
+}
+
+/* Whether @caps, fed to an encodebin sink pad, already are in the format
+ * of one of the stream profiles, and are passed through without being
+ * encoded */
+static gboolean
+is_passed_through (GList * streams, GstCaps * caps)
+{
+  GList *tmp;
+  gboolean res = FALSE;
+
+  for (tmp = streams; tmp && !res; tmp = tmp->next) {
+    GstCaps *format = gst_encoding_profile_get_format (tmp->data);
+
+    res = format && gst_caps_can_intersect (caps, format);
+    if (format)
+      gst_caps_unref (format);
+  }
+
+  return res;
+}
+
+/* The number of streams fed to @encodebin which need an encoder */
+static guint
+count_streams_to_encode (GstElement * encodebin, GList * streams)
+{
+  guint res = 0;
+  GstIterator *it;
+  GValue item = G_VALUE_INIT;
+
+  it = gst_element_iterate_sink_pads (encodebin);
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstCaps *caps = gst_pad_get_current_caps (g_value_get_object (&item));
+
+    if (caps) {
+      if (!is_passed_through (streams, caps))
+        res++;
+      gst_caps_unref (caps);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+
+  return res;
+}
+
+/**
+ * gst_encode_plan_record:
+ * @profile: The profile @encodebin was configured with
+ * @encodebin: An encodebin which drained all its streams
+ *
+ * Records the muxer and encoders @encodebin uses, and the caps the
+ * encoders negotiated, as the plan for @profile. Must be called while the
+ * caps are still set, before @encodebin goes back to %GST_STATE_READY.
+ *
+ * Nothing is recorded if one of the encoders did not negotiate, if a
+ * stream which was not passed through has no encoder, or if no stream was
+ * encoded at all, so that remuxing does not replace the plan of a previous
+ * transcoding.
+ */
+void
+gst_encode_plan_record (GstEncodingProfile * profile, GstElement * encodebin)
+{
+  guint i;
+  GList *streams;
+  GstIterator *it;
+  gboolean complete = TRUE;
+  guint n_encoders = 0, n_to_encode;
+  GValue item = G_VALUE_INIT;
+  EncodePlan *plan = g_new0 (EncodePlan, 1);
+
+  streams = get_stream_profiles (profile);
+  n_to_encode = count_streams_to_encode (encodebin, streams);
+  plan->n_streams = g_list_length (streams);
+  plan->encoders = g_new0 (gchar *, plan->n_streams);
+  plan->caps = g_new0 (GstCaps *, plan->n_streams);
+
+  it = gst_bin_iterate_recurse (GST_BIN (encodebin));
+  while (complete && gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElement *element = g_value_get_object (&item);
+    GstElementFactory *factory = gst_element_get_factory (element);
+    const gchar *klass = factory ? gst_element_factory_get_metadata (factory,
+        GST_ELEMENT_METADATA_KLASS) : NULL;
+    const gchar *name = factory ?
+        gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory)) : NULL;
+
+    if (!klass || GST_IS_BIN (element)) {
+      /* Not a plain element */
+    } else if (strstr (klass, "Muxer")) {
+      g_free (plan->muxer);
+      plan->muxer = g_strdup (name);
+    } else if (strstr (klass, "Encoder")) {
+      GList *tmp;
+      GstPad *srcpad = gst_element_get_static_pad (element, "src");
+      GstCaps *caps = srcpad ? gst_pad_get_current_caps (srcpad) : NULL;
+
+      complete = caps != NULL;
+      for (tmp = streams, i = 0; caps && tmp; tmp = tmp->next, i++) {
+        GstCaps *format = gst_encoding_profile_get_format (tmp->data);
+        gboolean matches = !plan->encoders[i] && format &&
+            gst_caps_can_intersect (caps, format);
+
+        if (format)
+          gst_caps_unref (format);
+
+        if (matches) {
+          plan->encoders[i] = g_strdup (name);
+          plan->caps[i] = gst_caps_ref (caps);
+          n_encoders++;
+          break;
+        }
+      }
+
+      if (caps)
+        gst_caps_unref (caps);
+      if (srcpad)
+        gst_object_unref (srcpad);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+  g_list_free (streams);
+
+  if (!complete) {
+    GST_DEBUG_OBJECT (encodebin, "Not all encoders negotiated, no plan");
+    encode_plan_free (plan);
+
+    return;
+  }
+
+  if (n_encoders < n_to_encode) {
+    GST_DEBUG_OBJECT (encodebin, "Only %u encoders for %u streams to encode, "
+        "no plan", n_encoders, n_to_encode);
+    encode_plan_free (plan);
+
+    return;
+  }
+
+  if (!n_encoders) {
+    GST_DEBUG_OBJECT (encodebin, "Nothing was encoded, no plan");
+    encode_plan_free (plan);
+
+    return;
+  }
+
+  g_mutex_lock (&plans_lock);
+  GST_DEBUG_OBJECT (encodebin, "Recording plan with muxer %s",
+      GST_STR_NULL (plan->muxer));
+  g_hash_table_insert (get_plans (), get_profile_key (profile), plan);
+  g_mutex_unlock (&plans_lock);
+}
+
+/**
+ * gst_encode_plan_invalidate:
+ * @profile: A profile whose plan did not work
+ *
+ * Drops the plan recorded for @profile.
+ */
+void
+gst_encode_plan_invalidate (GstEncodingProfile * profile)
+{
+  gchar *key = get_profile_key (profile);
+
+  g_mutex_lock (&plans_lock);
+  g_hash_table_remove (get_plans (), key);
+  g_mutex_unlock (&plans_lock);
+  g_free (key);
+}
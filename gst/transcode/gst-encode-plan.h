@@ -0,0 +1,35 @@
+/*
+ * gst-encode-plan.h
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GST_ENCODE_PLAN_H__
+#define __GST_ENCODE_PLAN_H__
+
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+
+G_BEGIN_DECLS
+
+GstEncodingProfile * gst_encode_plan_apply      (GstEncodingProfile * profile);
+void                 gst_encode_plan_record     (GstEncodingProfile * profile,
+                                                 GstElement * encodebin);
+void                 gst_encode_plan_invalidate (GstEncodingProfile * profile);
+
+G_END_DECLS
+
+#endif /* #ifndef __GST_ENCODE_PLAN_H__*/
@@ -0,0 +1,787 @@
+/*
+ * gst-parallel-video-filter.c
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gst-parallel-video-filter.h"
+
+/**
+ * SECTION: gst-parallel-video-filter
+ * @title: GstParallelVideoFilter
+ * @short_description: Run copies of a stateless video filter in parallel
+ *
+ * The #GstParallelVideoFilter wraps a video filter together with copies of
+ * it, each running in the streaming thread of its own queue. Input frames
+ * are spread round-robin across the copies and the output is put back in
+ * the input order: each input frame gets a sequence number, the output of
+ * a copy is matched with its input by timestamp, and the frames a copy
+ * dropped are skipped instead of desynchronizing the output.
+ *
+ * This only works for filters producing exactly one output frame per
+ * input frame without depending on the previous ones, use
+ * gst_parallel_video_filter_is_stateless() to check a filter. A filter
+ * declares it is stateless by setting the "stateless" metadata of its
+ * element factory to "true", some well known stateless filters are
+ * accepted without it.
+ *
+ * Serialized events are handed to every copy, and passed downstream once
+ * all of them processed the frames coming before it. The events a copy
+ * makes itself are passed downstream after the frames it output before
+ * them.
+ */
+
+/* *INDENT-OFF* */
+GST_DEBUG_CATEGORY_STATIC (gst_parallel_video_filter_debug);
+#define GST_CAT_DEFAULT gst_parallel_video_filter_debug
+
+#define parent_class gst_parallel_video_filter_parent_class
+G_DEFINE_TYPE (GstParallelVideoFilter, gst_parallel_video_filter, GST_TYPE_BIN)
+
+struct _Worker
+{
+  GstParallelVideoFilter *self;
+  guint index;
+
+  /* Feeds the queue of the worker */
+  GstPad *srcpad;
+  /* Receives the output of the filter of the worker */
+  GstPad *sinkpad;
+
+  /* InFlight, input sent to the worker and not out of it yet */
+  GQueue in_flight;
+  /* Pending, output waiting for its turn */
+  GQueue pending;
+  /* Sequence number of the last buffer out of the worker */
+  guint64 last_seq;
+};
+
+/* Input handed to a worker */
+typedef struct
+{
+  /* Sequence number of a buffer, or of the first buffer after an event */
+  guint64 seq;
+  GstClockTime pts;
+  gboolean is_event;
+  GstEventType event_type;
+} InFlight;
+
+/* Output of a worker, with the sequence number of its input */
+typedef struct
+{
+  GstMiniObject *object;
+  guint64 seq;
+  /* An event the filter of the worker made itself, it goes out before the
+   * frame with sequence number @seq */
+  gboolean is_own_event;
+} Pending;
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static const gchar *stateless_filters[] = {
+  "videoconvert", "videoscale", "videoflip", "videobalance", "videocrop",
+  "videobox", "gamma", "alpha", "coloreffects", NULL
+};
+/* *INDENT-ON* */
+
+/**
+ * gst_parallel_video_filter_is_stateless:
+ * @filter: A video filter element
+ *
+ * Returns: %TRUE if @filter can be run in parallel over the frames of a
+ * stream.
+ */
+gboolean
+gst_parallel_video_filter_is_stateless (GstElement * filter)
+{
+  GstElementFactory *factory;
+  const gchar *stateless;
+
+  /* Only copies of plain elements can be made */
+  if (GST_IS_BIN (filter))
+    return FALSE;
+
+  factory = gst_element_get_factory (filter);
+  if (!factory)
+    return FALSE;
+
+  stateless = gst_element_factory_get_metadata (factory, "stateless");
+  if (stateless)
+    return !g_ascii_strcasecmp (stateless, "true");
+
+  return g_strv_contains (stateless_filters,
+      gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory)));
+}
+
+static GstElement *
+copy_filter (GstElement * filter)
+{
+  GstElement *copy;
+  GParamSpec **specs;
+  guint i, n_specs;
+
+  copy = gst_element_factory_create (gst_element_get_factory (filter), NULL);
+  if (!copy)
+    return NULL;
+
+  specs = g_object_class_list_properties (G_OBJECT_GET_CLASS (filter),
+      &n_specs);
+  for (i = 0; i < n_specs; i++) {
+    GValue value = G_VALUE_INIT;
+
+    if ((specs[i]->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE ||
+        (specs[i]->flags & G_PARAM_CONSTRUCT_ONLY) ||
+        !g_strcmp0 (specs[i]->name, "name") ||
+        !g_strcmp0 (specs[i]->name, "parent"))
+      continue;
+
+    g_value_init (&value, specs[i]->value_type);
+    g_object_get_property (G_OBJECT (filter), specs[i]->name, &value);
+    g_object_set_property (G_OBJECT (copy), specs[i]->name, &value);
+    g_value_unset (&value);
+  }
+  g_free (specs);
+
+  return copy;
+}
+
+static void
+pending_free (Pending * pending)
+{
+  if (pending->object)
+    gst_mini_object_unref (pending->object);
+  g_free (pending);
+}
+
+/* Must be called with the merge lock. Whether an event with the type of
+ * @event was handed to @worker and did not come out yet */
+static gboolean
+has_event_in_flight_unlocked (Worker * worker, GstEvent * event)
+{
+  GList *tmp;
+
+  for (tmp = worker->in_flight.head; tmp; tmp = tmp->next) {
+    InFlight *in = tmp->data;
+
+    if (in->is_event)
+      return in->event_type == GST_EVENT_TYPE (event);
+  }
+
+  return FALSE;
+}
+
+/* Must be called with the merge lock. Returns the sequence number of the
+ * input an output of @worker comes from, @event being the first output
+ * after what was in flight before an event. The in flight frames before it
+ * were dropped by the filter. */
+static guint64
+match_in_flight_unlocked (Worker * worker, gboolean event, GstClockTime pts)
+{
+  InFlight *in;
+  guint64 seq = worker->last_seq;
+
+  while ((in = g_queue_pop_head (&worker->in_flight))) {
+    gboolean found;
+
+    seq = in->seq;
+    if (event)
+      found = in->is_event;
+    else
+      found = !in->is_event && (!GST_CLOCK_TIME_IS_VALID (pts) ||
+          !GST_CLOCK_TIME_IS_VALID (in->pts) || in->pts >= pts);
+    if (!found && !in->is_event)
+      GST_LOG_OBJECT (worker->self, "Worker %u dropped frame %"
+          G_GUINT64_FORMAT, worker->index, in->seq);
+    g_free (in);
+
+    if (found)
+      break;
+  }
+
+  if (!event)
+    worker->last_seq = seq;
+
+  return seq;
+}
+
+/* Must be called with the merge lock. Buffers are output by increasing
+ * sequence number, the number a worker has nothing for is a dropped
+ * frame and is skipped. */
+static GstMiniObject *
+pop_next_unlocked (GstParallelVideoFilter * self)
+{
+  Worker *worker;
+  Pending *head;
+  GstMiniObject *object;
+  guint i;
+
+  while (TRUE) {
+    /* The events the filters made go out once the frames before them did */
+    for (i = 0; i < self->n_workers; i++) {
+      worker = &self->workers[i];
+      head = g_queue_peek_head (&worker->pending);
+      if (head && head->is_own_event && head->seq <= self->next_seq_out)
+        goto pop;
+    }
+
+    worker = &self->workers[self->next_seq_out % self->n_workers];
+    head = g_queue_peek_head (&worker->pending);
+    if (!head || head->is_own_event)
+      return NULL;
+
+    if (head->seq > self->next_seq_out) {
+      self->next_seq_out++;
+      continue;
+    }
+
+    if (GST_IS_BUFFER (head->object)) {
+      if (head->seq == self->next_seq_out)
+        self->next_seq_out++;
+      break;
+    }
+
+    /* Serialized event, all the workers must have reached it. The events
+     * their filters made before it go out first */
+    for (i = 0; i < self->n_workers; i++) {
+      head = g_queue_peek_head (&self->workers[i].pending);
+      if (!head || GST_IS_BUFFER (head->object))
+        return NULL;
+      if (head->is_own_event) {
+        worker = &self->workers[i];
+        goto pop;
+      }
+    }
+
+    for (i = 0; i < self->n_workers; i++) {
+      if (&self->workers[i] != worker)
+        pending_free (g_queue_pop_head (&self->workers[i].pending));
+    }
+    break;
+  }
+
+pop:
+  head = g_queue_pop_head (&worker->pending);
+  object = head->object;
+  head->object = NULL;
+  pending_free (head);
+
+  return object;
+}
+
+/* Must be called with the merge lock */
+static void
+push_pending_unlocked (Worker * worker, GstMiniObject * object)
+{
+  Pending *pending = g_new0 (Pending, 1);
+
+  pending->object = object;
+  if (GST_IS_BUFFER (object)) {
+    pending->seq = match_in_flight_unlocked (worker, FALSE,
+        GST_BUFFER_PTS (object));
+  } else if (has_event_in_flight_unlocked (worker, GST_EVENT (object))) {
+    pending->seq = match_in_flight_unlocked (worker, TRUE,
+        GST_CLOCK_TIME_NONE);
+  } else {
+    /* Made by the filter, no frame is consumed */
+    InFlight *in = g_queue_peek_head (&worker->in_flight);
+
+    GST_LOG_OBJECT (worker->self, "Worker %u made %" GST_PTR_FORMAT,
+        worker->index, object);
+    pending->is_own_event = TRUE;
+    pending->seq = in ? in->seq : worker->last_seq + 1;
+  }
+  g_queue_push_tail (&worker->pending, pending);
+}
+
+static GstFlowReturn
+drain (GstParallelVideoFilter * self)
+{
+  GstMiniObject *next;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  /* Only one thread pushes at a time so that the output stays ordered */
+  g_mutex_lock (&self->push_lock);
+  while (ret == GST_FLOW_OK) {
+    g_mutex_lock (&self->merge_lock);
+    next = self->flushing ? NULL : pop_next_unlocked (self);
+    g_mutex_unlock (&self->merge_lock);
+
+    if (!next)
+      break;
+
+    if (GST_IS_BUFFER (next))
+      ret = gst_pad_push (self->srcpad, GST_BUFFER (next));
+    else
+      gst_pad_push_event (self->srcpad, GST_EVENT (next));
+  }
+  g_mutex_unlock (&self->push_lock);
+
+  return ret;
+}
+
+static void
+clear_pending_unlocked (GstParallelVideoFilter * self)
+{
+  guint i;
+
+  for (i = 0; i < self->n_workers; i++)
+    g_queue_clear_full (&self->workers[i].pending,
+        (GDestroyNotify) pending_free);
+  self->next_seq_out = 0;
+}
+
+static void
+clear_in_flight_unlocked (GstParallelVideoFilter * self)
+{
+  guint i;
+
+  for (i = 0; i < self->n_workers; i++) {
+    g_queue_clear_full (&self->workers[i].in_flight, g_free);
+    self->workers[i].last_seq = 0;
+  }
+}
+
+static GstFlowReturn
+worker_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  Worker *worker = gst_pad_get_element_private (pad);
+  GstParallelVideoFilter *self = worker->self;
+
+  g_mutex_lock (&self->merge_lock);
+  if (self->flushing) {
+    g_mutex_unlock (&self->merge_lock);
+    gst_buffer_unref (buffer);
+
+    return GST_FLOW_FLUSHING;
+  }
+  push_pending_unlocked (worker, GST_MINI_OBJECT (buffer));
+  g_mutex_unlock (&self->merge_lock);
+
+  return drain (self);
+}
+
+static gboolean
+worker_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Worker *worker = gst_pad_get_element_private (pad);
+  GstParallelVideoFilter *self = worker->self;
+  gboolean forward = FALSE;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_FLUSH_START:
+      g_mutex_lock (&self->merge_lock);
+      if (!self->flushing) {
+        self->flushing = TRUE;
+        clear_pending_unlocked (self);
+        forward = TRUE;
+      }
+      g_mutex_unlock (&self->merge_lock);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      g_mutex_lock (&self->merge_lock);
+      if (++self->n_flush_stops == self->n_workers) {
+        self->n_flush_stops = 0;
+        self->flushing = FALSE;
+        clear_pending_unlocked (self);
+        forward = TRUE;
+      }
+      g_mutex_unlock (&self->merge_lock);
+      break;
+    default:
+      if (!GST_EVENT_IS_SERIALIZED (event)) {
+        forward = worker->index == 0;
+        break;
+      }
+
+      g_mutex_lock (&self->merge_lock);
+      if (self->flushing) {
+        g_mutex_unlock (&self->merge_lock);
+        gst_event_unref (event);
+
+        return FALSE;
+      }
+      push_pending_unlocked (worker, GST_MINI_OBJECT (event));
+      g_mutex_unlock (&self->merge_lock);
+
+      drain (self);
+
+      return TRUE;
+  }
+
+  if (forward)
+    return gst_pad_push_event (self->srcpad, event);
+
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static gboolean
+worker_sink_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  Worker *worker = gst_pad_get_element_private (pad);
+
+  return gst_pad_peer_query (worker->self->srcpad, query);
+}
+
+static gboolean
+worker_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Worker *worker = gst_pad_get_element_private (pad);
+
+  /* All the workers send the same upstream events */
+  if (worker->index != 0) {
+    gst_event_unref (event);
+
+    return TRUE;
+  }
+
+  return gst_pad_push_event (worker->self->sinkpad, event);
+}
+
+static gboolean
+worker_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  Worker *worker = gst_pad_get_element_private (pad);
+
+  return gst_pad_peer_query (worker->self->sinkpad, query);
+}
+
+static GstFlowReturn
+gst_parallel_video_filter_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buffer)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (parent);
+  InFlight *in = g_new0 (InFlight, 1);
+  Worker *worker;
+
+  in->seq = self->next_seq_in++;
+  in->pts = GST_BUFFER_PTS (buffer);
+  worker = &self->workers[in->seq % self->n_workers];
+
+  g_mutex_lock (&self->merge_lock);
+  g_queue_push_tail (&worker->in_flight, in);
+  g_mutex_unlock (&self->merge_lock);
+
+  return gst_pad_push (worker->srcpad, buffer);
+}
+
+static gboolean
+gst_parallel_video_filter_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (parent);
+  gboolean res = TRUE;
+  guint i;
+
+  g_mutex_lock (&self->merge_lock);
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP) {
+    self->next_seq_in = 0;
+    clear_in_flight_unlocked (self);
+  } else if (GST_EVENT_IS_SERIALIZED (event)) {
+    /* Tells the workers which frames come before the event */
+    for (i = 0; i < self->n_workers; i++) {
+      InFlight *in = g_new0 (InFlight, 1);
+
+      in->seq = self->next_seq_in;
+      in->pts = GST_CLOCK_TIME_NONE;
+      in->is_event = TRUE;
+      in->event_type = GST_EVENT_TYPE (event);
+      g_queue_push_tail (&self->workers[i].in_flight, in);
+    }
+  }
+  g_mutex_unlock (&self->merge_lock);
+
+  for (i = 0; i < self->n_workers; i++)
+    res &= gst_pad_push_event (self->workers[i].srcpad, gst_event_ref (event));
+  gst_event_unref (event);
+
+  return res;
+}
+
+static gboolean
+gst_parallel_video_filter_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (parent);
+
+  return gst_pad_peer_query (self->workers[0].srcpad, query);
+}
+
+static gboolean
+gst_parallel_video_filter_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (parent);
+
+  return gst_pad_push_event (self->sinkpad, event);
+}
+
+static gboolean
+gst_parallel_video_filter_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (parent);
+
+  return gst_pad_peer_query (self->workers[0].sinkpad, query);
+}
+
+static void
+set_workers_active (GstParallelVideoFilter * self, gboolean active)
+{
+  guint i;
+
+  for (i = 0; i < self->n_workers; i++) {
+    gst_pad_set_active (self->workers[i].srcpad, active);
+    gst_pad_set_active (self->workers[i].sinkpad, active);
+  }
+}
+
+static GstStateChangeReturn
+gst_parallel_video_filter_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstStateChangeReturn ret;
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      self->next_seq_in = 0;
+      self->flushing = FALSE;
+      self->n_flush_stops = 0;
+      set_workers_active (self, TRUE);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      set_workers_active (self, FALSE);
+
+      g_mutex_lock (&self->merge_lock);
+      clear_pending_unlocked (self);
+      clear_in_flight_unlocked (self);
+      g_mutex_unlock (&self->merge_lock);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_parallel_video_filter_dispose (GObject * object)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (object);
+  guint i;
+
+  if (self->workers) {
+    clear_pending_unlocked (self);
+    clear_in_flight_unlocked (self);
+    for (i = 0; i < self->n_workers; i++) {
+      if (self->workers[i].srcpad)
+        gst_object_unref (self->workers[i].srcpad);
+      if (self->workers[i].sinkpad)
+        gst_object_unref (self->workers[i].sinkpad);
+    }
+    g_free (self->workers);
+    self->workers = NULL;
+    self->n_workers = 0;
+  }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gst_parallel_video_filter_finalize (GObject * object)
+{
+  GstParallelVideoFilter *self = GST_PARALLEL_VIDEO_FILTER (object);
+
+  g_mutex_clear (&self->merge_lock);
+  g_mutex_clear (&self->push_lock);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_parallel_video_filter_class_init (GstParallelVideoFilterClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  object_class->dispose = gst_parallel_video_filter_dispose;
+  object_class->finalize = gst_parallel_video_filter_finalize;
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_change_state);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&sink_template));
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&src_template));
+
+  GST_DEBUG_CATEGORY_INIT (gst_parallel_video_filter_debug,
+      "parallelvideofilter", 0, "Frame parallel video filter");
+}
+
+static void
+gst_parallel_video_filter_init (GstParallelVideoFilter * self)
+{
+  g_mutex_init (&self->merge_lock);
+  g_mutex_init (&self->push_lock);
+
+  self->sinkpad = gst_pad_new_from_static_template (&sink_template, "sink");
+  gst_pad_set_chain_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_chain));
+  gst_pad_set_event_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_sink_event));
+  gst_pad_set_query_function (self->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_sink_query));
+  gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+  self->srcpad = gst_pad_new_from_static_template (&src_template, "src");
+  gst_pad_set_event_function (self->srcpad,
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_src_event));
+  gst_pad_set_query_function (self->srcpad,
+      GST_DEBUG_FUNCPTR (gst_parallel_video_filter_src_query));
+  gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+}
+
+static gboolean
+setup_worker (GstParallelVideoFilter * self, Worker * worker,
+    GstElement * filter)
+{
+  GstElement *queue;
+  GstPad *pad;
+  gchar *name;
+  gboolean linked;
+
+  queue = gst_element_factory_make ("queue", NULL);
+  if (!queue)
+    return FALSE;
+
+  gst_bin_add_many (GST_BIN (self), queue, filter, NULL);
+  if (!gst_element_link (queue, filter))
+    return FALSE;
+
+  /* The worker pads are not exposed, they only connect the inner queue
+   * and filter to the outer pads */
+  name = g_strdup_printf ("worker_src_%u", worker->index);
+  worker->srcpad = gst_pad_new (name, GST_PAD_SRC);
+  g_free (name);
+  gst_pad_set_element_private (worker->srcpad, worker);
+  gst_pad_set_event_function (worker->srcpad, worker_src_event);
+  gst_pad_set_query_function (worker->srcpad, worker_src_query);
+
+  name = g_strdup_printf ("worker_sink_%u", worker->index);
+  worker->sinkpad = gst_pad_new (name, GST_PAD_SINK);
+  g_free (name);
+  gst_pad_set_element_private (worker->sinkpad, worker);
+  gst_pad_set_chain_function (worker->sinkpad, worker_chain);
+  gst_pad_set_event_function (worker->sinkpad, worker_sink_event);
+  gst_pad_set_query_function (worker->sinkpad, worker_sink_query);
+
+  pad = gst_element_get_static_pad (queue, "sink");
+  linked = gst_pad_link_full (worker->srcpad, pad,
+      GST_PAD_LINK_CHECK_NOTHING) == GST_PAD_LINK_OK;
+  gst_object_unref (pad);
+
+  GST_OBJECT_LOCK (filter);
+  pad = gst_object_ref (filter->srcpads->data);
+  GST_OBJECT_UNLOCK (filter);
+  linked &= gst_pad_link_full (pad, worker->sinkpad,
+      GST_PAD_LINK_CHECK_NOTHING) == GST_PAD_LINK_OK;
+  gst_object_unref (pad);
+
+  return linked;
+}
+
+/**
+ * gst_parallel_video_filter_new:
+ * @filter: The stateless filter to run in parallel
+ * @n_workers: The number of copies of @filter to run
+ *
+ * @filter must be stateless, see gst_parallel_video_filter_is_stateless().
+ * Creates a bin running @filter and @n_workers - 1 copies of it in
+ * parallel. @filter becomes a child of the returned bin, and must be
+ * removed from it before being reused.
+ *
+ * Returns: (transfer floating): The new bin, or %NULL if @filter could
+ * not be copied.
+ */
+GstElement *
+gst_parallel_video_filter_new (GstElement * filter, guint n_workers)
+{
+  GstParallelVideoFilter *self;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_ELEMENT (filter), NULL);
+  g_return_val_if_fail (n_workers > 0, NULL);
+  g_return_val_if_fail (gst_parallel_video_filter_is_stateless (filter),
+      NULL);
+
+  self = g_object_new (GST_TYPE_PARALLEL_VIDEO_FILTER, NULL);
+  self->n_workers = n_workers;
+  self->workers = g_new0 (Worker, n_workers);
+  for (i = 0; i < n_workers; i++) {
+    Worker *worker = &self->workers[i];
+    GstElement *copy = i == 0 ? filter : copy_filter (filter);
+
+    worker->self = self;
+    worker->index = i;
+    g_queue_init (&worker->in_flight);
+    g_queue_init (&worker->pending);
+
+    if (!copy)
+      goto failed;
+
+    if (!setup_worker (self, worker, copy)) {
+      if (copy != filter && !GST_OBJECT_PARENT (copy))
+        gst_object_unref (copy);
+      goto failed;
+    }
+  }
+
+  return GST_ELEMENT (self);
+
+failed:
+  {
+    GST_ERROR ("Could not run %d copies of %" GST_PTR_FORMAT, n_workers,
+        filter);
+
+    if (GST_OBJECT_PARENT (filter) == GST_OBJECT (self))
+      gst_bin_remove (GST_BIN (self), filter);
+    gst_object_unref (gst_object_ref_sink (self));
+
+    return NULL;
+  }
+}
@@ -0,0 +1,80 @@
+/*
+ * gst-parallel-video-filter.h
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GST_PARALLEL_VIDEO_FILTER_H__
+#define __GST_PARALLEL_VIDEO_FILTER_H__
+
+#include <glib-object.h>
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstParallelVideoFilter GstParallelVideoFilter;
+typedef struct _GstParallelVideoFilterClass GstParallelVideoFilterClass;
+
+GType gst_parallel_video_filter_get_type (void) G_GNUC_CONST;
+
+#define GST_TYPE_PARALLEL_VIDEO_FILTER (gst_parallel_video_filter_get_type ())
+#define GST_PARALLEL_VIDEO_FILTER(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_PARALLEL_VIDEO_FILTER, GstParallelVideoFilter))
+#define GST_PARALLEL_VIDEO_FILTER_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_PARALLEL_VIDEO_FILTER, GstParallelVideoFilterClass))
+#define GST_IS_PARALLEL_VIDEO_FILTER(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_PARALLEL_VIDEO_FILTER))
+#define GST_IS_PARALLEL_VIDEO_FILTER_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_PARALLEL_VIDEO_FILTER))
+#define GST_PARALLEL_VIDEO_FILTER_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TYPE_PARALLEL_VIDEO_FILTER, GstParallelVideoFilterClass))
+
+typedef struct _Worker Worker;
+
+struct _GstParallelVideoFilterClass
+{
+  /*<private>*/
+  GstBinClass parent_class;
+};
+
+struct _GstParallelVideoFilter
+{
+  /*<private>*/
+  GstBin parent;
+
+  GstPad *sinkpad;
+  GstPad *srcpad;
+
+  Worker *workers;
+  guint n_workers;
+
+  /* Sequence number of the next input buffer, which goes to the worker
+   * at that number modulo n_workers. Only touched from the sinkpad
+   * streaming thread */
+  guint64 next_seq_in;
+
+  /* Protects the in flight input and the pending output of the workers */
+  GMutex merge_lock;
+  /* Held while pushing downstream so that the output stays ordered */
+  GMutex push_lock;
+  /* Sequence number of the next buffer to output */
+  guint64 next_seq_out;
+  gboolean flushing;
+  guint n_flush_stops;
+};
+
+gboolean gst_parallel_video_filter_is_stateless (GstElement * filter);
+GstElement * gst_parallel_video_filter_new (GstElement * filter,
+                                            guint n_workers);
+
+G_END_DECLS
+
+#endif /* #ifndef __GST_PARALLEL_VIDEO_FILTER_H__*/
@@ -0,0 +1,643 @@
+/* GStreamer
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * gstmultitranscodebin.c:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-multitranscodebin
+ *
+ * Transcodes its input into several renditions, one per
+ * #GstEncodingProfile set in #GstMultiTranscodeBin:profiles, decoding
+ * each stream only once. The raw streams are teed to one encodebin per
+ * rendition, each rendition being exposed on its own "src_%u" pad.
+ *
+ * When #GstMultiTranscodeBin:keyframe-interval is set, key units are
+ * forced at the same frames in all the video renditions so that they can
+ * be switched between, the encoders should then be configured not to
+ * place other keyframes.
+ */
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gsttranscoding.h"
+#include <gst/pbutils/pbutils.h>
+#include <gst/video/video.h>
+
+#include <gst/pbutils/missing-plugins.h>
+
+GST_DEBUG_CATEGORY_STATIC (gst_multi_transcodebin_debug);
+#define GST_CAT_DEFAULT gst_multi_transcodebin_debug
+
+static GstStaticPadTemplate multi_transcode_bin_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate multi_transcode_bin_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS_ANY);
+
+typedef struct
+{
+  GstEncodingProfile *profile;
+  GstElement *encodebin;
+  GstPad *srcpad;
+} Rendition;
+
+typedef struct
+{
+  GstBin parent;
+
+  GstElement *decodebin;
+  GstPad *sinkpad;
+
+  /* Rendition */
+  GPtrArray *renditions;
+  /* The tees and queues linking decodebin to the encodebins */
+  GList *branches;
+
+  GstClockTime keyframe_interval;
+} GstMultiTranscodeBin;
+
+typedef struct
+{
+  GstBinClass parent;
+
+} GstMultiTranscodeBinClass;
+
+typedef struct
+{
+  GstClockTime interval;
+  GstClockTime next;
+  guint count;
+} KeyUnitData;
+
+/* *INDENT-OFF* */
+#define parent_class gst_multi_transcode_bin_parent_class
+#define GST_TYPE_MULTI_TRANSCODE_BIN (gst_multi_transcode_bin_get_type ())
+#define GST_MULTI_TRANSCODE_BIN(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), GST_TYPE_MULTI_TRANSCODE_BIN, GstMultiTranscodeBin))
+
+#define DEFAULT_KEYFRAME_INTERVAL 0
+
+G_DEFINE_TYPE (GstMultiTranscodeBin, gst_multi_transcode_bin, GST_TYPE_BIN)
+enum
+{
+ PROP_0,
+ PROP_PROFILES,
+ PROP_KEYFRAME_INTERVAL,
+ LAST_PROP
+};
+
+static void
+post_missing_plugin_error (GstElement * dec, const gchar * element_name)
+{
+  GstMessage *msg;
+
+  msg = gst_missing_element_message_new (dec, element_name);
+  gst_element_post_message (dec, msg);
+
+  GST_ELEMENT_ERROR (dec, CORE, MISSING_PLUGIN,
+      ("Missing element '%s' - check your GStreamer installation.",
+          element_name), (NULL));
+}
+/* *INDENT-ON* */
+
+static void
+rendition_free (Rendition * rendition)
+{
+  g_object_unref (rendition->profile);
+  g_free (rendition);
+}
+
+static GstPadProbeReturn
+force_key_unit_probe_cb (GstPad * pad, GstPadProbeInfo * info,
+    KeyUnitData * data)
+{
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime ts = GST_BUFFER_PTS (buffer);
+
+  if (!GST_CLOCK_TIME_IS_VALID (ts))
+    return GST_PAD_PROBE_OK;
+
+  if (GST_CLOCK_TIME_IS_VALID (data->next) && ts < data->next)
+    return GST_PAD_PROBE_OK;
+
+  /* Sent right before the buffer so that tee hands it to all the encoders
+   * for the very same frame */
+  GST_LOG_OBJECT (pad, "Forcing key unit #%d at %" GST_TIME_FORMAT,
+      data->count, GST_TIME_ARGS (ts));
+  gst_pad_push_event (pad,
+      gst_video_event_new_downstream_force_key_unit (ts, GST_CLOCK_TIME_NONE,
+          GST_CLOCK_TIME_NONE, TRUE, data->count++));
+  data->next = (ts / data->interval + 1) * data->interval;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstElement *
+make_branch_element (GstMultiTranscodeBin * self, const gchar * factory_name)
+{
+  GstElement *element = gst_element_factory_make (factory_name, NULL);
+
+  if (!element) {
+    post_missing_plugin_error (GST_ELEMENT_CAST (self), factory_name);
+
+    return NULL;
+  }
+
+  gst_bin_add (GST_BIN (self), element);
+  self->branches = g_list_prepend (self->branches, element);
+
+  return element;
+}
+
+static gboolean
+link_rendition (GstMultiTranscodeBin * self, GstElement * tee,
+    GstPad * sinkpad)
+{
+  GstElement *queue;
+  GstPad *teepad, *queuepad;
+  GstPadLinkReturn lret;
+
+  queue = make_branch_element (self, "queue");
+  if (!queue)
+    return FALSE;
+
+  queuepad = gst_element_get_static_pad (queue, "src");
+  lret = gst_pad_link (queuepad, sinkpad);
+  gst_object_unref (queuepad);
+  if (G_UNLIKELY (lret != GST_PAD_LINK_OK))
+    goto link_failed;
+
+  teepad = gst_element_get_request_pad (tee, "src_%u");
+  queuepad = gst_element_get_static_pad (queue, "sink");
+  lret = gst_pad_link (teepad, queuepad);
+  gst_object_unref (queuepad);
+  gst_object_unref (teepad);
+  if (G_UNLIKELY (lret != GST_PAD_LINK_OK))
+    goto link_failed;
+
+  return gst_element_sync_state_with_parent (queue);
+
+link_failed:
+  {
+    GST_ELEMENT_ERROR_WITH_DETAILS (self, CORE, PAD, (NULL),
+        ("Couldn't link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT,
+            queue, sinkpad),
+        ("linking-error", GST_TYPE_PAD_LINK_RETURN, lret, NULL));
+
+    return FALSE;
+  }
+}
+
+static void
+pad_added_cb (GstElement * decodebin, GstPad * pad,
+    GstMultiTranscodeBin * self)
+{
+  GstCaps *caps;
+  GstElement *tee = NULL;
+  GstPad *teepad;
+  GstPadLinkReturn lret;
+  guint i, n_branches = 0;
+
+  caps = gst_pad_query_caps (pad, NULL);
+
+  GST_DEBUG_OBJECT (decodebin, "Pad added, caps: %" GST_PTR_FORMAT, caps);
+
+  for (i = 0; i < self->renditions->len; i++) {
+    Rendition *rendition = g_ptr_array_index (self->renditions, i);
+    GstPad *sinkpad = NULL;
+
+    g_signal_emit_by_name (rendition->encodebin, "request-pad", caps,
+        &sinkpad);
+    if (sinkpad == NULL) {
+      GST_INFO_OBJECT (self, "Rendition %d can not encode %" GST_PTR_FORMAT,
+          i, caps);
+      continue;
+    }
+
+    if (!tee) {
+      tee = make_branch_element (self, "tee");
+      if (!tee) {
+        gst_object_unref (sinkpad);
+        goto done;
+      }
+    }
+
+    if (link_rendition (self, tee, sinkpad))
+      n_branches++;
+    gst_object_unref (sinkpad);
+  }
+
+  if (n_branches == 0) {
+    gchar *stream_id = gst_pad_get_stream_id (pad);
+
+    GST_ELEMENT_WARNING_WITH_DETAILS (self, STREAM, FORMAT,
+        (NULL), ("Stream with caps: %" GST_PTR_FORMAT " can not be"
+            " encoded in any of the renditions", caps),
+        ("can-t-encode-stream", G_TYPE_BOOLEAN, TRUE,
+            "stream-caps", GST_TYPE_CAPS, caps,
+            "stream-id", G_TYPE_STRING, stream_id, NULL));
+
+    g_free (stream_id);
+    goto done;
+  }
+
+  if (self->keyframe_interval && n_branches > 1 &&
+      !g_strcmp0 (gst_structure_get_name (gst_caps_get_structure (caps, 0)),
+          "video/x-raw")) {
+    KeyUnitData *data = g_new0 (KeyUnitData, 1);
+
+    data->interval = self->keyframe_interval;
+    data->next = GST_CLOCK_TIME_NONE;
+    gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER,
+        (GstPadProbeCallback) force_key_unit_probe_cb, data, g_free);
+  }
+
+  gst_element_sync_state_with_parent (tee);
+  teepad = gst_element_get_static_pad (tee, "sink");
+  lret = gst_pad_link (pad, teepad);
+  gst_object_unref (teepad);
+  if (G_UNLIKELY (lret != GST_PAD_LINK_OK)) {
+    GST_ELEMENT_ERROR_WITH_DETAILS (self, CORE, PAD, (NULL),
+        ("Couldn't link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, pad, tee),
+        ("linking-error", GST_TYPE_PAD_LINK_RETURN, lret, NULL));
+  }
+
+done:
+  if (caps)
+    gst_caps_unref (caps);
+}
+
+static gboolean
+make_encodebins (GstMultiTranscodeBin * self)
+{
+  guint i;
+
+  GST_INFO_OBJECT (self, "making %d encodebins", self->renditions->len);
+
+  if (!self->renditions->len)
+    goto no_profile;
+
+  for (i = 0; i < self->renditions->len; i++) {
+    Rendition *rendition = g_ptr_array_index (self->renditions, i);
+    GstPad *pad;
+
+    rendition->encodebin = gst_element_factory_make ("encodebin", NULL);
+    if (!rendition->encodebin)
+      goto no_encodebin;
+
+    gst_bin_add (GST_BIN (self), rendition->encodebin);
+    g_object_set (rendition->encodebin, "profile", rendition->profile, NULL);
+
+    pad = gst_element_get_static_pad (rendition->encodebin, "src");
+    if (!gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (rendition->srcpad),
+            pad)) {
+      gst_object_unref (pad);
+      GST_ERROR_OBJECT (self, "Could not ghost %" GST_PTR_FORMAT " srcpad",
+          rendition->encodebin);
+
+      return FALSE;
+    }
+    gst_object_unref (pad);
+
+    if (!gst_element_sync_state_with_parent (rendition->encodebin))
+      return FALSE;
+  }
+
+  return TRUE;
+
+  /* ERRORS */
+no_encodebin:
+  {
+    post_missing_plugin_error (GST_ELEMENT_CAST (self), "encodebin");
+
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL),
+        ("No encodebin element, check your installation"));
+
+    return FALSE;
+  }
+no_profile:
+  {
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL),
+        ("No GstEncodingProfile set, can not run."));
+
+    return FALSE;
+  }
+}
+
+static gboolean
+make_decodebin (GstMultiTranscodeBin * self)
+{
+  GstPad *pad;
+  GST_INFO_OBJECT (self, "making new decodebin");
+
+  self->decodebin = gst_element_factory_make ("decodebin", NULL);
+
+  if (!self->decodebin)
+    goto no_decodebin;
+
+  g_signal_connect (self->decodebin, "pad-added", G_CALLBACK (pad_added_cb),
+      self);
+
+  gst_bin_add (GST_BIN (self), self->decodebin);
+  pad = gst_element_get_static_pad (self->decodebin, "sink");
+  if (!gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (self->sinkpad), pad)) {
+
+    gst_object_unref (pad);
+    GST_ERROR_OBJECT (self, "Could not ghost %" GST_PTR_FORMAT " sinkpad",
+        self->decodebin);
+
+    return FALSE;
+  }
+
+  gst_object_unref (pad);
+  return TRUE;
+
+  /* ERRORS */
+no_decodebin:
+  {
+    post_missing_plugin_error (GST_ELEMENT_CAST (self), "decodebin");
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL),
+        ("No decodebin element, check your installation"));
+
+    return FALSE;
+  }
+}
+
+static void
+remove_all_children (GstMultiTranscodeBin * self)
+{
+  GList *tmp;
+  guint i;
+
+  for (i = 0; i < self->renditions->len; i++) {
+    Rendition *rendition = g_ptr_array_index (self->renditions, i);
+
+    if (rendition->encodebin) {
+      gst_element_set_state (rendition->encodebin, GST_STATE_NULL);
+      gst_bin_remove (GST_BIN (self), rendition->encodebin);
+      rendition->encodebin = NULL;
+    }
+  }
+
+  for (tmp = self->branches; tmp; tmp = tmp->next) {
+    gst_element_set_state (tmp->data, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), tmp->data);
+  }
+  g_list_free (self->branches);
+  self->branches = NULL;
+
+  if (self->decodebin) {
+    gst_element_set_state (self->decodebin, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), self->decodebin);
+    self->decodebin = NULL;
+  }
+}
+
+static GstStateChangeReturn
+gst_multi_transcode_bin_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstStateChangeReturn ret;
+  GstMultiTranscodeBin *self = GST_MULTI_TRANSCODE_BIN (element);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+
+      if (!make_encodebins (self))
+        goto setup_failed;
+
+      if (!make_decodebin (self))
+        goto setup_failed;
+
+      break;
+    default:
+      break;
+  }
+
+  ret =
+      GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    goto beach;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      remove_all_children (self);
+      break;
+    default:
+      break;
+  }
+
+beach:
+  return ret;
+
+setup_failed:
+  remove_all_children (self);
+  return GST_STATE_CHANGE_FAILURE;
+}
+
+static void
+remove_renditions (GstMultiTranscodeBin * self)
+{
+  guint i;
+
+  for (i = 0; i < self->renditions->len; i++) {
+    Rendition *rendition = g_ptr_array_index (self->renditions, i);
+
+    gst_element_remove_pad (GST_ELEMENT (self), rendition->srcpad);
+  }
+
+  g_ptr_array_set_size (self->renditions, 0);
+}
+
+static void
+set_profiles (GstMultiTranscodeBin * self, const GValue * value)
+{
+  GstPadTemplate *pad_tmpl;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  if (GST_STATE (self) > GST_STATE_READY) {
+    GST_OBJECT_UNLOCK (self);
+    GST_ERROR_OBJECT (self, "Can not change the profiles while running");
+
+    return;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  remove_renditions (self);
+
+  pad_tmpl = gst_static_pad_template_get (&multi_transcode_bin_src_template);
+  for (i = 0; i < gst_value_array_get_size (value); i++) {
+    Rendition *rendition = g_new0 (Rendition, 1);
+    gchar *name = g_strdup_printf ("src_%u", i);
+
+    rendition->profile =
+        g_value_dup_object (gst_value_array_get_value (value, i));
+    rendition->srcpad = gst_ghost_pad_new_no_target_from_template (name,
+        pad_tmpl);
+    gst_pad_set_active (rendition->srcpad, TRUE);
+    gst_element_add_pad (GST_ELEMENT (self), rendition->srcpad);
+    g_ptr_array_add (self->renditions, rendition);
+
+    g_free (name);
+  }
+  gst_object_unref (pad_tmpl);
+
+  gst_element_no_more_pads (GST_ELEMENT (self));
+}
+
+static void
+gst_multi_transcode_bin_dispose (GObject * object)
+{
+  GstMultiTranscodeBin *self = (GstMultiTranscodeBin *) object;
+
+  if (self->renditions) {
+    g_ptr_array_unref (self->renditions);
+    self->renditions = NULL;
+  }
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gst_multi_transcode_bin_get_property (GObject * object,
+    guint prop_id, GValue * value, GParamSpec * pspec)
+{
+  GstMultiTranscodeBin *self = GST_MULTI_TRANSCODE_BIN (object);
+
+  switch (prop_id) {
+    case PROP_PROFILES:
+    {
+      guint i;
+
+      GST_OBJECT_LOCK (self);
+      for (i = 0; i < self->renditions->len; i++) {
+        Rendition *rendition = g_ptr_array_index (self->renditions, i);
+        GValue val = G_VALUE_INIT;
+
+        g_value_init (&val, GST_TYPE_ENCODING_PROFILE);
+        g_value_set_object (&val, rendition->profile);
+        gst_value_array_append_and_take_value (value, &val);
+      }
+      GST_OBJECT_UNLOCK (self);
+      break;
+    }
+    case PROP_KEYFRAME_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->keyframe_interval);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+gst_multi_transcode_bin_set_property (GObject * object,
+    guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+  GstMultiTranscodeBin *self = GST_MULTI_TRANSCODE_BIN (object);
+
+  switch (prop_id) {
+    case PROP_PROFILES:
+      set_profiles (self, value);
+      break;
+    case PROP_KEYFRAME_INTERVAL:
+      GST_OBJECT_LOCK (self);
+      self->keyframe_interval = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+  }
+}
+
+static void
+gst_multi_transcode_bin_class_init (GstMultiTranscodeBinClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *gstelement_klass;
+
+  object_class->dispose = gst_multi_transcode_bin_dispose;
+  object_class->get_property = gst_multi_transcode_bin_get_property;
+  object_class->set_property = gst_multi_transcode_bin_set_property;
+
+  gstelement_klass = (GstElementClass *) klass;
+  gstelement_klass->change_state =
+      GST_DEBUG_FUNCPTR (gst_multi_transcode_bin_change_state);
+
+  gst_element_class_add_pad_template (gstelement_klass,
+      gst_static_pad_template_get (&multi_transcode_bin_sink_template));
+  gst_element_class_add_pad_template (gstelement_klass,
+      gst_static_pad_template_get (&multi_transcode_bin_src_template));
+
+  GST_DEBUG_CATEGORY_INIT (gst_multi_transcodebin_debug, "multitranscodebin",
+      0, "MultiTranscodebin element");
+
+  /**
+   * GstMultiTranscodeBin:profiles:
+   *
+   * The #GstEncodingProfile of each rendition, rendition N being exposed
+   * on the "src_N" pad. This property must be set before going to
+   * %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_PROFILES,
+      gst_param_spec_array ("profiles", "Profiles",
+          "The GstEncodingProfile of each rendition",
+          g_param_spec_object ("profile", "Profile",
+              "The GstEncodingProfile of a rendition",
+              GST_TYPE_ENCODING_PROFILE,
+              G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS),
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMultiTranscodeBin:keyframe-interval:
+   *
+   * The interval at which key units are forced in all the video renditions
+   * at once, 0 to let each encoder place its keyframes.
+   */
+  g_object_class_install_property (object_class, PROP_KEYFRAME_INTERVAL,
+      g_param_spec_uint64 ("keyframe-interval", "Keyframe interval",
+          "Interval between the keyframes aligned across the video renditions "
+          "(0 = not aligned)", 0, G_MAXUINT64, DEFAULT_KEYFRAME_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+gst_multi_transcode_bin_init (GstMultiTranscodeBin * self)
+{
+  GstPadTemplate *pad_tmpl;
+
+  pad_tmpl = gst_static_pad_template_get (&multi_transcode_bin_sink_template);
+  self->sinkpad = gst_ghost_pad_new_no_target_from_template ("sink", pad_tmpl);
+  gst_pad_set_active (self->sinkpad, TRUE);
+  gst_element_add_pad (GST_ELEMENT (self), self->sinkpad);
+
+  gst_object_unref (pad_tmpl);
+
+  self->renditions = g_ptr_array_new_with_free_func ((GDestroyNotify)
+      rendition_free);
+  self->keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+}
@@ -23,9 +23,13 @@
 #endif
 
 #include "gsttranscoding.h"
+#include "gst-parallel-video-filter.h"
+#include "gst-encode-plan.h"
+#include "gst-autoplug-memo.h"
 #include <gst/pbutils/pbutils.h>
 
 #include <gst/pbutils/missing-plugins.h>
+#include <string.h>
 
 GST_DEBUG_CATEGORY_STATIC (gst_transcodebin_debug);
 #define GST_CAT_DEFAULT gst_transcodebin_debug
@@ -46,8 +50,27 @@ typedef struct
 {
   GstBin parent;
 
+  /* A parsebin when remuxing the streams matching the profile is
+   * possible, a decodebin otherwise */
   GstElement *decodebin;
+  gboolean parsing;
+  /* The decodebins plugged after parsebin for the streams which need to
+   * be re-encoded, protected by the object lock */
+  GList *stream_decodebins;
   GstElement *encodebin;
+  /* Whether encodebin got the factories of the recorded encoding plan */
+  gboolean using_plan;
+  /* Whether a stream of this run could not be linked to encodebin, the
+   * factories it used are then not recorded as the plan of the profile,
+   * protected by the object lock */
+  gboolean stream_refused;
+  /* Whether encodebin is kept from one run to the next */
+  gboolean recycle;
+  /* The encodebin sink pads linked during this run, and those kept from
+   * the previous run and not linked again yet, protected by the object
+   * lock */
+  GList *encoder_pads;
+  GList *recycled_pads;
 
   GstEncodingProfile *profile;
   gboolean avoid_reencoding;
@@ -56,6 +79,36 @@ typedef struct
 
   GstElement *audio_filter;
   GstElement *video_filter;
+  gchar *audio_filter_description;
+  gchar *video_filter_description;
+  guint video_filter_parallelism;
+  /* The filters made for a single stream, or the GstParallelVideoFilter
+   * wrapping them, protected by the object lock */
+  GList *stream_filters;
+
+  GstClockTime start_time;
+  GstClockTime stop_time;
+
+  gboolean decoupling_queues;
+  guint64 queue_max_size_time;
+  guint queue_max_size_bytes;
+  guint queue_max_size_buffers;
+  GstTranscodeQueueLeaky queue_leaky;
+  /* The decoupling queues, protected by the object lock */
+  GList *queues;
+  gint n_streams;
+  /* The streams refused before being decoded as the profile can not
+   * encode them */
+  gint n_skipped_streams;
+
+  /* The selectors of the streams to transcode, %NULL for all of them */
+  gchar **stream_selection;
+  /* stream-id -> whether the stream is selected, stream-id -> index of
+   * the stream among the ones of its type, and stream type -> number of
+   * streams of that type seen so far, protected by the object lock */
+  GHashTable *selected_streams;
+  GHashTable *stream_indexes;
+  GHashTable *n_streams_per_type;
 } GstTranscodeBin;
 
 typedef struct
@@ -73,6 +126,12 @@ typedef struct
 #define GST_TRANSCODE_BIN_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_TRANSCODE_BIN_TYPE, GstTranscodeBinClass))
 
 #define DEFAULT_AVOID_REENCODING   FALSE
+#define DEFAULT_DECOUPLING_QUEUES  TRUE
+#define DEFAULT_VIDEO_FILTER_PARALLELISM 1
+#define DEFAULT_QUEUE_MAX_SIZE_TIME GST_SECOND
+#define DEFAULT_QUEUE_MAX_SIZE_BYTES (10 * 1024 * 1024)
+#define DEFAULT_QUEUE_MAX_SIZE_BUFFERS 200
+#define DEFAULT_QUEUE_LEAKY GST_TRANSCODE_QUEUE_LEAKY_NONE
 
 G_DEFINE_TYPE (GstTranscodeBin, gst_transcode_bin, GST_TYPE_BIN)
 enum
@@ -82,6 +141,22 @@ enum
  PROP_AVOID_REENCODING,
  PROP_VIDEO_FILTER,
  PROP_AUDIO_FILTER,
+ PROP_START_TIME,
+ PROP_STOP_TIME,
+ PROP_DECOUPLING_QUEUES,
+ PROP_QUEUE_MAX_SIZE_TIME,
+ PROP_QUEUE_MAX_SIZE_BYTES,
+ PROP_QUEUE_MAX_SIZE_BUFFERS,
+ PROP_QUEUE_LEAKY,
+ PROP_QUEUE_LEVELS,
+ PROP_VIDEO_FILTER_PARALLELISM,
+ PROP_VIDEO_FILTER_DESCRIPTION,
+ PROP_AUDIO_FILTER_DESCRIPTION,
+ PROP_REMUXING,
+ PROP_SKIPPED_STREAMS,
+ PROP_STREAM_SELECTION,
+ PROP_AUTOPLUG_STATS,
+ PROP_RECYCLE,
  LAST_PROP
 };
 
@@ -99,33 +174,189 @@ post_missing_plugin_error (GstElement * dec, const gchar * element_name)
 }
 /* *INDENT-ON* */
 
+#define C_ENUM(v) ((gint) v)
+
+GType
+gst_transcode_queue_leaky_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {C_ENUM (GST_TRANSCODE_QUEUE_LEAKY_NONE), "GST_TRANSCODE_QUEUE_LEAKY_NONE",
+        "none"},
+    {C_ENUM (GST_TRANSCODE_QUEUE_LEAKY_UPSTREAM),
+        "GST_TRANSCODE_QUEUE_LEAKY_UPSTREAM", "upstream"},
+    {C_ENUM (GST_TRANSCODE_QUEUE_LEAKY_DOWNSTREAM),
+        "GST_TRANSCODE_QUEUE_LEAKY_DOWNSTREAM", "downstream"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp = g_enum_register_static ("GstTranscodeQueueLeaky", values);
+    g_once_init_leave (&id, tmp);
+  }
+
+  return (GType) id;
+}
+
+/* Lets decoding, filtering and encoding of a stream run in their own
+ * streaming threads */
+static GstPad *
+_insert_queue (GstTranscodeBin * self, GstPad * pad, const gchar * stage,
+    gint stream)
+{
+  GstElement *queue;
+  GstPad *queue_sink, *queue_src;
+  gchar *name;
+
+  if (!self->decoupling_queues)
+    return pad;
+
+  name = g_strdup_printf ("%s-queue-%d", stage, stream);
+  queue = gst_element_factory_make ("queue", name);
+  g_free (name);
+  if (!queue) {
+    post_missing_plugin_error (GST_ELEMENT_CAST (self), "queue");
+
+    return pad;
+  }
+
+  GST_OBJECT_LOCK (self);
+  g_object_set (queue, "max-size-time", self->queue_max_size_time,
+      "max-size-bytes", self->queue_max_size_bytes,
+      "max-size-buffers", self->queue_max_size_buffers,
+      "leaky", C_ENUM (self->queue_leaky), NULL);
+  self->queues = g_list_prepend (self->queues, queue);
+  GST_OBJECT_UNLOCK (self);
+
+  gst_bin_add (GST_BIN (self), queue);
+  queue_sink = gst_element_get_static_pad (queue, "sink");
+  if (G_UNLIKELY (gst_pad_link (pad, queue_sink) != GST_PAD_LINK_OK)) {
+    GST_ELEMENT_ERROR (self, CORE, PAD, (NULL),
+        ("Couldn't link %" GST_PTR_FORMAT " to %" GST_PTR_FORMAT, pad,
+            queue));
+  }
+  gst_object_unref (queue_sink);
+  gst_element_sync_state_with_parent (queue);
+
+  /* The queue keeps a reference on its pad */
+  queue_src = gst_element_get_static_pad (queue, "src");
+  gst_object_unref (queue_src);
+
+  return queue_src;
+}
+
+static GstStructure *
+get_queue_levels (GstTranscodeBin * self)
+{
+  GList *tmp;
+  GstStructure *levels = gst_structure_new_empty ("queue-levels");
+
+  GST_OBJECT_LOCK (self);
+  for (tmp = self->queues; tmp; tmp = tmp->next) {
+    guint64 level_time;
+    guint level_bytes, level_buffers;
+    GstStructure *level;
+
+    g_object_get (tmp->data, "current-level-time", &level_time,
+        "current-level-bytes", &level_bytes,
+        "current-level-buffers", &level_buffers, NULL);
+    level = gst_structure_new (GST_OBJECT_NAME (tmp->data),
+        "current-level-time", G_TYPE_UINT64, level_time,
+        "current-level-bytes", G_TYPE_UINT, level_bytes,
+        "current-level-buffers", G_TYPE_UINT, level_buffers, NULL);
+    gst_structure_set (levels, GST_OBJECT_NAME (tmp->data),
+        GST_TYPE_STRUCTURE, level, NULL);
+    gst_structure_free (level);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return levels;
+}
+
+/* Instantiates a filter for a single stream */
+static GstElement *
+make_stream_filter (GstTranscodeBin * self, const gchar * description)
+{
+  GError *err = NULL;
+  GstElement *filter;
+
+  filter = gst_parse_bin_from_description_full (description, TRUE, NULL,
+      GST_PARSE_FLAG_NO_SINGLE_ELEMENT_BINS, &err);
+  if (!filter) {
+    GST_ELEMENT_ERROR (self, CORE, FAILED, (NULL),
+        ("Could not create filter '%s': %s", description, err->message));
+    g_clear_error (&err);
+
+    return NULL;
+  }
+
+  return filter;
+}
+
 static GstPad *
 _insert_filter (GstTranscodeBin * self, GstPad * sinkpad, GstPad * pad,
     GstCaps * caps)
 {
   GstPad *filter_src = NULL, *filter_sink = NULL;
   GstElement *filter = NULL;
+  gchar *description = NULL;
+  gboolean is_video = FALSE;
+  const gchar *media;
 
-  if (self->video_filter &&
-      !g_strcmp0 (gst_structure_get_name (gst_caps_get_structure (caps, 0)),
-          "video/x-raw")) {
+  media = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  GST_OBJECT_LOCK (self);
+  if (!g_strcmp0 (media, "video/x-raw")) {
+    is_video = TRUE;
+    description = g_strdup (self->video_filter_description);
     filter = self->video_filter;
-  } else if (self->audio_filter &&
-      !g_strcmp0 (gst_structure_get_name (gst_caps_get_structure (caps, 0)),
-          "audio/x-raw")) {
+  } else if (!g_strcmp0 (media, "audio/x-raw")) {
+    description = g_strdup (self->audio_filter_description);
     filter = self->audio_filter;
   }
+  GST_OBJECT_UNLOCK (self);
+
+  if (description) {
+    filter = make_stream_filter (self, description);
+    g_free (description);
+  } else if (filter && GST_OBJECT_PARENT (filter)) {
+    GST_ELEMENT_WARNING (self, CORE, NOT_IMPLEMENTED, (NULL),
+        ("%" GST_PTR_FORMAT " already filters another stream, use the %s"
+            " property to filter all of them", filter, is_video ?
+            "video-filter-description" : "audio-filter-description"));
+
+    return pad;
+  }
 
   if (!filter)
     return pad;
 
+  if (is_video && self->video_filter_parallelism > 1) {
+    if (gst_parallel_video_filter_is_stateless (filter)) {
+      GstElement *parallel_filter = gst_parallel_video_filter_new (filter,
+          self->video_filter_parallelism);
+
+      if (parallel_filter)
+        filter = parallel_filter;
+    } else {
+      GST_ELEMENT_WARNING (self, CORE, NOT_IMPLEMENTED, (NULL),
+          ("%" GST_PTR_FORMAT " is not stateless, it can not process frames"
+              " in parallel", filter));
+    }
+  }
+
   /* We are guaranteed filters only have 1 unique sinkpad and srcpad */
   GST_OBJECT_LOCK (filter);
   filter_sink = filter->sinkpads->data;
   filter_src = filter->srcpads->data;
   GST_OBJECT_UNLOCK (filter);
 
-  gst_bin_add (GST_BIN (self), gst_object_ref (filter));
+  if (filter != self->video_filter && filter != self->audio_filter) {
+    GST_OBJECT_LOCK (self);
+    self->stream_filters = g_list_prepend (self->stream_filters, filter);
+    GST_OBJECT_UNLOCK (self);
+  }
+
+  gst_bin_add (GST_BIN (self), filter);
   if (G_UNLIKELY (gst_pad_link (pad, filter_sink) != GST_PAD_LINK_OK)) {
     GstCaps *othercaps = gst_pad_get_current_caps (sinkpad);
     caps = gst_pad_get_current_caps (pad);
@@ -144,22 +375,425 @@ _insert_filter (GstTranscodeBin * self, GstPad * sinkpad, GstPad * pad,
   return filter_src;
 }
 
+static gboolean
+has_range (GstTranscodeBin * self)
+{
+  return GST_CLOCK_TIME_IS_VALID (self->start_time) ||
+      GST_CLOCK_TIME_IS_VALID (self->stop_time);
+}
+
+/* Drops what decodebin outputs until the range seek flushed it */
+static GstPadProbeReturn
+range_seek_probe_cb (GstPad * pad, GstPadProbeInfo * info, gpointer udata)
+{
+  if (GST_PAD_PROBE_INFO_TYPE (info) & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP)
+      return GST_PAD_PROBE_REMOVE;
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  return GST_PAD_PROBE_DROP;
+}
+
+static void
+do_range_seek (GstElement * element, gpointer udata)
+{
+  GstTranscodeBin *self = GST_TRANSCODE_BIN (element);
+  GstPad *pad = NULL;
+  GstClockTime start, stop;
+
+  GST_OBJECT_LOCK (self);
+  start = GST_CLOCK_TIME_IS_VALID (self->start_time) ? self->start_time : 0;
+  stop = self->stop_time;
+  if (self->decodebin) {
+    GST_OBJECT_LOCK (self->decodebin);
+    if (self->decodebin->srcpads)
+      pad = gst_object_ref (self->decodebin->srcpads->data);
+    GST_OBJECT_UNLOCK (self->decodebin);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (!pad)
+    return;
+
+  /* decodebin has no sink element to send the seek to, send it upstream
+   * from one of its pads */
+  GST_INFO_OBJECT (self, "Seeking to [%" GST_TIME_FORMAT " - %"
+      GST_TIME_FORMAT "]", GST_TIME_ARGS (start), GST_TIME_ARGS (stop));
+  if (!gst_pad_send_event (pad, gst_event_new_seek (1.0, GST_FORMAT_TIME,
+              GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_ACCURATE,
+              GST_SEEK_TYPE_SET, start,
+              GST_CLOCK_TIME_IS_VALID (stop) ? GST_SEEK_TYPE_SET :
+              GST_SEEK_TYPE_NONE, stop))) {
+    GST_ELEMENT_ERROR (self, CORE, SEEK, (NULL),
+        ("Could not seek to the range to transcode"));
+  }
+
+  gst_object_unref (pad);
+}
+
+static void
+no_more_pads_cb (GstElement * decodebin, GstTranscodeBin * self)
+{
+  /* Seeking from the streaming thread could deadlock */
+  gst_element_call_async (GST_ELEMENT (self), do_range_seek, NULL, NULL);
+}
+
+static gboolean
+stream_profile_accepts (GstEncodingProfile * profile, const gchar * media)
+{
+  if (GST_IS_ENCODING_VIDEO_PROFILE (profile))
+    return g_str_has_prefix (media, "video/") ||
+        g_str_has_prefix (media, "image/");
+
+  if (GST_IS_ENCODING_AUDIO_PROFILE (profile))
+    return g_str_has_prefix (media, "audio/");
+
+  /* We can not tell what other kinds of profiles take */
+  return TRUE;
+}
+
+/* Whether the profile has a stream profile for the media type of the
+ * elementary stream described by @caps */
+static gboolean
+profile_wants_stream (GstTranscodeBin * self, GstCaps * caps)
+{
+  GList *tmp;
+  const gchar *media;
+
+  if (!caps || gst_caps_is_empty (caps) || gst_caps_is_any (caps))
+    return TRUE;
+
+  media = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  if (!GST_IS_ENCODING_CONTAINER_PROFILE (self->profile))
+    return stream_profile_accepts (self->profile, media);
+
+  for (tmp = (GList *)
+      gst_encoding_container_profile_get_profiles
+      (GST_ENCODING_CONTAINER_PROFILE (self->profile)); tmp; tmp = tmp->next) {
+    if (stream_profile_accepts (tmp->data, media))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+static const gchar *
+get_stream_type (GstCaps * caps)
+{
+  const gchar *media;
+
+  if (!caps || gst_caps_is_empty (caps) || gst_caps_is_any (caps))
+    return "other";
+
+  media = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  if (g_str_has_prefix (media, "video/") || g_str_has_prefix (media, "image/"))
+    return "video";
+  if (g_str_has_prefix (media, "audio/"))
+    return "audio";
+  if (g_str_has_prefix (media, "text/") ||
+      g_str_has_prefix (media, "subpicture/") || strstr (media, "subtitle"))
+    return "text";
+
+  return "other";
+}
+
+static gchar *
+get_stream_language (GstPad * pad)
+{
+  gchar *language = NULL;
+  GstTagList *tags = NULL;
+  GstStream *stream = gst_pad_get_stream (pad);
+
+  if (stream) {
+    tags = gst_stream_get_tags (stream);
+    gst_object_unref (stream);
+  }
+
+  if (!tags) {
+    GstEvent *event = gst_pad_get_sticky_event (pad, GST_EVENT_TAG, 0);
+
+    if (event) {
+      gst_event_parse_tag (event, &tags);
+      gst_tag_list_ref (tags);
+      gst_event_unref (event);
+    }
+  }
+
+  if (tags) {
+    gst_tag_list_get_string (tags, GST_TAG_LANGUAGE_CODE, &language);
+    gst_tag_list_unref (tags);
+  }
+
+  return language;
+}
+
+/* Whether @selector, as described in #GstTranscodeBin:stream-selection,
+ * matches the stream */
+static gboolean
+selector_matches (const gchar * selector, const gchar * stream_id,
+    const gchar * type, guint index, const gchar * language)
+{
+  gsize len;
+  const gchar *value;
+
+  if (g_str_has_prefix (selector, "id:"))
+    return !g_strcmp0 (selector + 3, stream_id);
+
+  value = strchr (selector, ':');
+  len = value ? (gsize) (value - selector) : strlen (selector);
+  if (len != strlen (type) || strncmp (selector, type, len))
+    return FALSE;
+
+  if (!value)
+    return TRUE;
+
+  value++;
+  if (g_ascii_isdigit (*value))
+    return g_ascii_strtoull (value, NULL, 10) == index;
+
+  return language && !g_ascii_strncasecmp (language, value, strlen (value));
+}
+
+/* Whether @selector selects the streams of @type by language */
+static gboolean
+is_language_selector (const gchar * selector, const gchar * type)
+{
+  gsize len = strlen (type);
+
+  return !strncmp (selector, type, len) && selector[len] == ':' &&
+      selector[len + 1] && !g_ascii_isdigit (selector[len + 1]);
+}
+
+/* Whether the stream exposed on @pad is selected. The demuxers do not
+ * always tag the streams before exposing them, when the language is
+ * needed and still unknown the stream is kept and the decision is only
+ * cached once @final, when the decoded stream is exposed */
+static gboolean
+stream_is_selected (GstTranscodeBin * self, GstPad * pad, GstCaps * caps,
+    gboolean final)
+{
+  guint i, index;
+  gpointer cached;
+  const gchar *type;
+  gchar *stream_id, *language;
+  gboolean selected = FALSE, needs_language = FALSE;
+
+  GST_OBJECT_LOCK (self);
+  if (!self->stream_selection || !*self->stream_selection) {
+    GST_OBJECT_UNLOCK (self);
+
+    return TRUE;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  stream_id = gst_pad_get_stream_id (pad);
+  if (!stream_id) {
+    GST_INFO_OBJECT (self, "%" GST_PTR_FORMAT " has no stream-id, keeping it",
+        pad);
+
+    return TRUE;
+  }
+
+  type = get_stream_type (caps);
+  language = get_stream_language (pad);
+
+  GST_OBJECT_LOCK (self);
+  if (g_hash_table_lookup_extended (self->selected_streams, stream_id, NULL,
+          &cached)) {
+    selected = GPOINTER_TO_INT (cached);
+    goto done;
+  }
+
+  /* The index is given once, a stream checked again must keep it */
+  if (g_hash_table_lookup_extended (self->stream_indexes, stream_id, NULL,
+          &cached)) {
+    index = GPOINTER_TO_UINT (cached);
+  } else {
+    index = GPOINTER_TO_UINT (g_hash_table_lookup (self->n_streams_per_type,
+            type));
+    g_hash_table_insert (self->n_streams_per_type, (gpointer) type,
+        GUINT_TO_POINTER (index + 1));
+    g_hash_table_insert (self->stream_indexes, g_strdup (stream_id),
+        GUINT_TO_POINTER (index));
+  }
+
+  for (i = 0; self->stream_selection[i] && !selected; i++) {
+    selected = selector_matches (self->stream_selection[i], stream_id, type,
+        index, language);
+    needs_language |= !language &&
+        is_language_selector (self->stream_selection[i], type);
+  }
+
+  if (!selected && needs_language && !final) {
+    GST_DEBUG_OBJECT (self, "%s stream %u (%s) has no language yet, keeping "
+        "it until it is decoded", type, index, stream_id);
+    selected = TRUE;
+    goto done;
+  }
+
+  GST_INFO_OBJECT (self, "%s stream %u (%s, language: %s) selected: %d",
+      type, index, stream_id, GST_STR_NULL (language), selected);
+  g_hash_table_insert (self->selected_streams, g_strdup (stream_id),
+      GINT_TO_POINTER (selected));
+
+done:
+  GST_OBJECT_UNLOCK (self);
+
+  g_free (language);
+  g_free (stream_id);
+
+  return selected;
+}
+
+/* Stops autoplugging after the demuxer for the streams the profile can not
+ * encode, or which are not selected, so they are never parsed nor
+ * decoded */
+static gboolean
+autoplug_continue_cb (GstElement * decodebin, GstPad * pad, GstCaps * caps,
+    GstTranscodeBin * self)
+{
+  GstElement *parent = gst_pad_get_parent_element (pad);
+  GstElementFactory *factory = parent ? gst_element_get_factory (parent) :
+      NULL;
+  gboolean from_demuxer = factory &&
+      gst_element_factory_list_is_type (factory,
+      GST_ELEMENT_FACTORY_TYPE_DEMUXER);
+
+  if (parent)
+    gst_object_unref (parent);
+
+  if (!from_demuxer || (profile_wants_stream (self, caps) &&
+          stream_is_selected (self, pad, caps, FALSE)))
+    return TRUE;
+
+  GST_DEBUG_OBJECT (self, "Not plugging anything for %" GST_PTR_FORMAT,
+      caps);
+
+  return FALSE;
+}
+
+/* Returns %TRUE if the stream exposed on @pad was skipped */
+static gboolean
+skip_unwanted_stream (GstTranscodeBin * self, GstPad * pad, GstCaps * caps)
+{
+  if (profile_wants_stream (self, caps) &&
+      stream_is_selected (self, pad, caps, TRUE))
+    return FALSE;
+
+  GST_INFO_OBJECT (self, "Skipping %" GST_PTR_FORMAT " (%" GST_PTR_FORMAT
+      "), it is not selected or the profile has no stream for it", pad,
+      caps);
+  g_atomic_int_inc (&self->n_skipped_streams);
+  g_object_notify (G_OBJECT (self), "skipped-streams");
+
+  return TRUE;
+}
+
+static const gchar *
+get_media_type (GstCaps * caps)
+{
+  if (!caps || gst_caps_is_empty (caps) || gst_caps_is_any (caps))
+    return NULL;
+
+  return gst_structure_get_name (gst_caps_get_structure (caps, 0));
+}
+
+/* Returns a sink pad of the recycled encodebin which was fed with @media
+ * during the previous run, its stream group can be reused */
+static GstPad *
+take_recycled_pad (GstTranscodeBin * self, const gchar * media)
+{
+  GList *tmp;
+  GstPad *res = NULL;
+
+  if (!media)
+    return NULL;
+
+  GST_OBJECT_LOCK (self);
+  for (tmp = self->recycled_pads; tmp; tmp = tmp->next) {
+    if (!g_strcmp0 (g_object_get_data (tmp->data, "transcodebin-media-type"),
+            media)) {
+      res = tmp->data;
+      self->recycled_pads = g_list_delete_link (self->recycled_pads, tmp);
+      self->encoder_pads = g_list_prepend (self->encoder_pads,
+          gst_object_ref (res));
+      break;
+    }
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return res;
+}
+
+/* All the streams of the run are exposed, the recycled encodebin pads
+ * which were not linked again would keep the muxer waiting */
+static void
+release_recycled_pads_cb (GstElement * decodebin, GstTranscodeBin * self)
+{
+  GList *tmp, *pads;
+
+  GST_OBJECT_LOCK (self);
+  pads = self->recycled_pads;
+  self->recycled_pads = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  for (tmp = pads; tmp; tmp = tmp->next) {
+    GST_DEBUG_OBJECT (self, "Releasing unused %" GST_PTR_FORMAT, tmp->data);
+    gst_element_release_request_pad (self->encodebin, tmp->data);
+  }
+  g_list_free_full (pads, gst_object_unref);
+}
+
 static void
 pad_added_cb (GstElement * decodebin, GstPad * pad, GstTranscodeBin * self)
 {
   GstCaps *caps;
-  GstPad *sinkpad = NULL;
+  GstPad *sinkpad = NULL, *filter_src;
   GstPadLinkReturn lret;
+  gint stream;
 
   caps = gst_pad_query_caps (pad, NULL);
+  if (skip_unwanted_stream (self, pad, caps)) {
+    gst_caps_unref (caps);
+
+    return;
+  }
 
   GST_DEBUG_OBJECT (decodebin, "Pad added, caps: %" GST_PTR_FORMAT, caps);
 
-  g_signal_emit_by_name (self->encodebin, "request-pad", caps, &sinkpad);
+  /* Reserved by parsed_pad_added_cb for the stream decodebin */
+  sinkpad = g_object_steal_data (G_OBJECT (decodebin),
+      "transcodebin-recycled-pad");
+  if (!sinkpad)
+    sinkpad = take_recycled_pad (self, get_media_type (caps));
+
+  if (sinkpad) {
+    GST_DEBUG_OBJECT (self, "Reusing %" GST_PTR_FORMAT, sinkpad);
+  } else {
+    g_signal_emit_by_name (self->encodebin, "request-pad", caps, &sinkpad);
+    if (sinkpad) {
+      g_object_set_data_full (G_OBJECT (sinkpad), "transcodebin-media-type",
+          g_strdup (get_media_type (caps)), g_free);
+      GST_OBJECT_LOCK (self);
+      self->encoder_pads = g_list_prepend (self->encoder_pads,
+          gst_object_ref (sinkpad));
+      GST_OBJECT_UNLOCK (self);
+    }
+  }
 
   if (sinkpad == NULL) {
     gchar *stream_id = gst_pad_get_stream_id (pad);
 
+    /* The next runs will let encodebin autoplug again */
+    if (self->using_plan)
+      gst_encode_plan_invalidate (self->profile);
+    GST_OBJECT_LOCK (self);
+    self->stream_refused = TRUE;
+    GST_OBJECT_UNLOCK (self);
+
     GST_ELEMENT_WARNING_WITH_DETAILS (self, STREAM, FORMAT,
         (NULL), ("Stream with caps: %" GST_PTR_FORMAT " can not be"
             " encoded in the defined encoding formats",
@@ -175,12 +809,25 @@ pad_added_cb (GstElement * decodebin, GstPad * pad, GstTranscodeBin * self)
   if (caps)
     gst_caps_unref (caps);
 
-  pad = _insert_filter (self, sinkpad, pad, caps);
+  if (has_range (self))
+    gst_pad_add_probe (pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+        GST_PAD_PROBE_TYPE_EVENT_FLUSH, range_seek_probe_cb, NULL, NULL);
+
+  stream = g_atomic_int_add (&self->n_streams, 1);
+  pad = _insert_queue (self, pad, "decode", stream);
+  filter_src = _insert_filter (self, sinkpad, pad, caps);
+  if (filter_src != pad)
+    pad = _insert_queue (self, filter_src, "filter", stream);
   lret = gst_pad_link (pad, sinkpad);
   if (G_UNLIKELY (lret != GST_PAD_LINK_OK)) {
     GstCaps *othercaps = gst_pad_query_caps (sinkpad, NULL);
     caps = gst_pad_get_current_caps (pad);
 
+    GST_OBJECT_LOCK (self);
+    self->stream_refused = TRUE;
+    GST_OBJECT_UNLOCK (self);
+
     GST_ELEMENT_ERROR_WITH_DETAILS (self, CORE, PAD,
         (NULL),
         ("Couldn't link pads:\n    %" GST_PTR_FORMAT ": %" GST_PTR_FORMAT
@@ -200,10 +847,47 @@ pad_added_cb (GstElement * decodebin, GstPad * pad, GstTranscodeBin * self)
   gst_object_unref (sinkpad);
 }
 
+/* encodebin drained all the streams: record the factories it picked while
+ * the caps they negotiated are still set, they are dropped when going back
+ * to %GST_STATE_READY */
+static GstPadProbeReturn
+src_event_probe_cb (GstPad * pad, GstPadProbeInfo * info,
+    GstTranscodeBin * self)
+{
+  GstElement *encodebin = NULL;
+  GstEncodingProfile *profile = NULL;
+
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) != GST_EVENT_EOS)
+    return GST_PAD_PROBE_OK;
+
+  GST_OBJECT_LOCK (self);
+  if (self->encodebin && self->profile && !self->stream_refused) {
+    encodebin = gst_object_ref (self->encodebin);
+    profile = g_object_ref (self->profile);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (encodebin) {
+    gst_encode_plan_record (profile, encodebin);
+    gst_object_unref (encodebin);
+    g_object_unref (profile);
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
 static gboolean
 make_encodebin (GstTranscodeBin * self)
 {
   GstPad *pad;
+  GstEncodingProfile *profile;
+
+  if (self->encodebin) {
+    GST_INFO_OBJECT (self, "reusing encodebin from the previous run");
+
+    return TRUE;
+  }
+
   GST_INFO_OBJECT (self, "making new encodebin");
 
   if (!self->profile)
@@ -214,7 +898,17 @@ make_encodebin (GstTranscodeBin * self)
     goto no_encodebin;
 
   gst_bin_add (GST_BIN (self), self->encodebin);
-  g_object_set (self->encodebin, "profile", self->profile, NULL);
+  /* encodebin still looks up the candidate factories, the preset names of
+   * the plan only make it instantiate the recorded ones */
+  profile = gst_encode_plan_apply (self->profile);
+  self->using_plan = profile != NULL;
+  if (profile) {
+    GST_INFO_OBJECT (self, "Using the recorded encoding plan");
+    g_object_set (self->encodebin, "profile", profile, NULL);
+    g_object_unref (profile);
+  } else {
+    g_object_set (self->encodebin, "profile", self->profile, NULL);
+  }
 
   pad = gst_element_get_static_pad (self->encodebin, "src");
   if (!gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (self->srcpad), pad)) {
@@ -249,10 +943,127 @@ no_profile:
   }
 }
 
+/* Whether the parsed stream matches the format of one of the stream
+ * profiles so it can be muxed without being decoded */
+static gboolean
+can_remux (GstTranscodeBin * self, GstCaps * caps)
+{
+  GList *tmp;
+  gboolean res = FALSE;
+
+  if (!GST_IS_ENCODING_CONTAINER_PROFILE (self->profile))
+    return FALSE;
+
+  for (tmp = (GList *)
+      gst_encoding_container_profile_get_profiles
+      (GST_ENCODING_CONTAINER_PROFILE (self->profile)); tmp && !res;
+      tmp = tmp->next) {
+    GstCaps *encodecaps = gst_encoding_profile_get_format (tmp->data);
+    GstCaps *restrictions = gst_encoding_profile_get_restriction (tmp->data);
+
+    res = !restrictions && gst_caps_can_intersect (caps, encodecaps);
+
+    gst_caps_unref (encodecaps);
+    if (restrictions)
+      gst_caps_unref (restrictions);
+  }
+
+  return res;
+}
+
+static void
+parsed_pad_added_cb (GstElement * parsebin, GstPad * pad,
+    GstTranscodeBin * self)
+{
+  GstCaps *caps;
+  gchar *media;
+  const gchar *type;
+  GstElement *decodebin;
+  GstPad *sinkpad;
+
+  caps = gst_pad_query_caps (pad, NULL);
+  if (skip_unwanted_stream (self, pad, caps)) {
+    gst_caps_unref (caps);
+
+    return;
+  }
+
+  if (can_remux (self, caps)) {
+    GST_DEBUG_OBJECT (self, "Remuxing %" GST_PTR_FORMAT, caps);
+    gst_caps_unref (caps);
+    pad_added_cb (parsebin, pad, self);
+
+    return;
+  }
+
+  GST_DEBUG_OBJECT (self, "Decoding %" GST_PTR_FORMAT, caps);
+  type = get_stream_type (caps);
+  gst_caps_unref (caps);
+
+  decodebin = gst_element_factory_make ("decodebin", NULL);
+  if (!decodebin) {
+    post_missing_plugin_error (GST_ELEMENT_CAST (self), "decodebin");
+    GST_ELEMENT_ERROR (self, CORE, MISSING_PLUGIN, (NULL),
+        ("No decodebin element, check your installation"));
+
+    return;
+  }
+
+  /* The decoded pad is only exposed after parsebin is done, reserve the
+   * recycled encodebin pad before the unused ones get released */
+  media = g_strdup_printf ("%s/x-raw", type);
+  sinkpad = take_recycled_pad (self, media);
+  g_free (media);
+  if (sinkpad)
+    g_object_set_data_full (G_OBJECT (decodebin), "transcodebin-recycled-pad",
+        sinkpad, gst_object_unref);
+
+  g_signal_connect (decodebin, "pad-added", G_CALLBACK (pad_added_cb), self);
+  g_signal_connect (decodebin, "autoplug-continue",
+      G_CALLBACK (autoplug_continue_cb), self);
+  gst_autoplug_memo_attach (decodebin);
+  GST_OBJECT_LOCK (self);
+  self->stream_decodebins = g_list_prepend (self->stream_decodebins,
+      decodebin);
+  GST_OBJECT_UNLOCK (self);
+
+  gst_bin_add (GST_BIN (self), decodebin);
+  sinkpad = gst_element_get_static_pad (decodebin, "sink");
+  if (gst_pad_link (pad, sinkpad) != GST_PAD_LINK_OK)
+    GST_ELEMENT_ERROR (self, CORE, PAD, (NULL),
+        ("Could not link %" GST_PTR_FORMAT " to a decoder", pad));
+  gst_object_unref (sinkpad);
+
+  gst_element_sync_state_with_parent (decodebin);
+}
+
+/* Parses the input and only plugs decoders for the streams not matching
+ * the profile, streams which already match are remuxed without any
+ * decoder factory being loaded */
+static gboolean
+make_parsebin (GstTranscodeBin * self)
+{
+  self->decodebin = gst_element_factory_make ("parsebin", NULL);
+  if (!self->decodebin)
+    return FALSE;
+
+  GST_INFO_OBJECT (self, "making new parsebin");
+  self->parsing = TRUE;
+  g_signal_connect (self->decodebin, "pad-added",
+      G_CALLBACK (parsed_pad_added_cb), self);
+
+  return TRUE;
+}
+
 static gboolean
 make_decodebin (GstTranscodeBin * self)
 {
   GstPad *pad;
+
+  self->parsing = FALSE;
+  if (self->avoid_reencoding && make_parsebin (self))
+    goto add;
+
   GST_INFO_OBJECT (self, "making new decodebin");
 
   self->decodebin = gst_element_factory_make ("decodebin", NULL);
@@ -289,6 +1100,16 @@ make_decodebin (GstTranscodeBin * self)
   g_signal_connect (self->decodebin, "pad-added", G_CALLBACK (pad_added_cb),
       self);
 
+add:
+  g_signal_connect (self->decodebin, "autoplug-continue",
+      G_CALLBACK (autoplug_continue_cb), self);
+  gst_autoplug_memo_attach (self->decodebin);
+  g_signal_connect (self->decodebin, "no-more-pads",
+      G_CALLBACK (release_recycled_pads_cb), self);
+  if (has_range (self))
+    g_signal_connect (self->decodebin, "no-more-pads",
+        G_CALLBACK (no_more_pads_cb), self);
+
   gst_bin_add (GST_BIN (self), self->decodebin);
   pad = gst_element_get_static_pad (self->decodebin, "sink");
   if (!gst_ghost_pad_set_target (GST_GHOST_PAD_CAST (self->sinkpad), pad)) {
@@ -315,13 +1136,77 @@ no_decodebin:
 }
 
 static void
-remove_all_children (GstTranscodeBin * self)
+remove_encodebin (GstTranscodeBin * self)
 {
+  GList *pads;
+
+  GST_OBJECT_LOCK (self);
+  pads = g_list_concat (self->encoder_pads, self->recycled_pads);
+  self->encoder_pads = NULL;
+  self->recycled_pads = NULL;
+  GST_OBJECT_UNLOCK (self);
+  g_list_free_full (pads, gst_object_unref);
+
   if (self->encodebin) {
     gst_element_set_state (self->encodebin, GST_STATE_NULL);
     gst_bin_remove (GST_BIN (self), self->encodebin);
     self->encodebin = NULL;
   }
+}
+
+static void
+remove_all_children (GstTranscodeBin * self)
+{
+  GList *tmp, *queues, *filters, *decodebins;
+
+  GST_OBJECT_LOCK (self);
+  queues = self->queues;
+  self->queues = NULL;
+  self->n_streams = 0;
+  self->n_skipped_streams = 0;
+  self->stream_refused = FALSE;
+  g_hash_table_remove_all (self->selected_streams);
+  g_hash_table_remove_all (self->stream_indexes);
+  g_hash_table_remove_all (self->n_streams_per_type);
+  GST_OBJECT_UNLOCK (self);
+
+  for (tmp = queues; tmp; tmp = tmp->next) {
+    gst_element_set_state (tmp->data, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), tmp->data);
+  }
+  g_list_free (queues);
+
+  /* The encoders stay instantiated and opened, in READY, and their stream
+   * groups get fed again by the streams of the next run */
+  if (self->encodebin && self->recycle) {
+    GST_INFO_OBJECT (self, "Keeping %" GST_PTR_FORMAT " for the next run",
+        self->encodebin);
+    GST_OBJECT_LOCK (self);
+    self->recycled_pads = g_list_concat (self->recycled_pads,
+        self->encoder_pads);
+    self->encoder_pads = NULL;
+    GST_OBJECT_UNLOCK (self);
+  } else {
+    remove_encodebin (self);
+  }
+
+  GST_OBJECT_LOCK (self);
+  filters = self->stream_filters;
+  self->stream_filters = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  for (tmp = filters; tmp; tmp = tmp->next) {
+    GstElement *filter = tmp->data;
+
+    gst_element_set_state (filter, GST_STATE_NULL);
+    /* Keep the user provided video filter for the next run */
+    if (self->video_filter &&
+        GST_OBJECT_PARENT (self->video_filter) == GST_OBJECT (filter))
+      gst_bin_remove (GST_BIN (filter), self->video_filter);
+    if (GST_OBJECT_PARENT (filter) == GST_OBJECT (self))
+      gst_bin_remove (GST_BIN (self), filter);
+  }
+  g_list_free (filters);
 
   if (self->video_filter && GST_OBJECT_PARENT (self->video_filter)) {
     gst_element_set_state (self->video_filter, GST_STATE_NULL);
@@ -333,6 +1218,17 @@ remove_all_children (GstTranscodeBin * self)
     gst_bin_remove (GST_BIN (self), self->audio_filter);
   }
 
+  GST_OBJECT_LOCK (self);
+  decodebins = self->stream_decodebins;
+  self->stream_decodebins = NULL;
+  GST_OBJECT_UNLOCK (self);
+
+  for (tmp = decodebins; tmp; tmp = tmp->next) {
+    gst_element_set_state (tmp->data, GST_STATE_NULL);
+    gst_bin_remove (GST_BIN (self), tmp->data);
+  }
+  g_list_free (decodebins);
+
   if (self->decodebin) {
     gst_element_set_state (self->decodebin, GST_STATE_NULL);
     gst_bin_remove (GST_BIN (self), self->decodebin);
@@ -370,6 +1266,9 @@ gst_transcode_bin_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PAUSED_TO_READY:
       remove_all_children (self);
       break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      remove_encodebin (self);
+      break;
     default:
       break;
   }
@@ -389,6 +1288,16 @@ gst_transcode_bin_dispose (GObject * object)
 
   g_clear_object (&self->video_filter);
   g_clear_object (&self->audio_filter);
+  g_clear_pointer (&self->video_filter_description, g_free);
+  g_clear_pointer (&self->audio_filter_description, g_free);
+  g_clear_pointer (&self->stream_selection, g_strfreev);
+  g_clear_pointer (&self->selected_streams, g_hash_table_unref);
+  g_clear_pointer (&self->stream_indexes, g_hash_table_unref);
+  g_clear_pointer (&self->n_streams_per_type, g_hash_table_unref);
+  g_list_free_full (self->encoder_pads, gst_object_unref);
+  self->encoder_pads = NULL;
+  g_list_free_full (self->recycled_pads, gst_object_unref);
+  self->recycled_pads = NULL;
 
   G_OBJECT_CLASS (gst_transcode_bin_parent_class)->dispose (object);
 }
@@ -420,6 +1329,81 @@ gst_transcode_bin_get_property (GObject * object,
       g_value_set_object (value, self->video_filter);
       GST_OBJECT_UNLOCK (self);
       break;
+    case PROP_START_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->start_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STOP_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->stop_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_DECOUPLING_QUEUES:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->decoupling_queues);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->queue_max_size_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_BYTES:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->queue_max_size_bytes);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_BUFFERS:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->queue_max_size_buffers);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_LEAKY:
+      GST_OBJECT_LOCK (self);
+      g_value_set_enum (value, self->queue_leaky);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_LEVELS:
+      g_value_take_boxed (value, get_queue_levels (self));
+      break;
+    case PROP_REMUXING:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->parsing && !self->stream_decodebins
+          && g_atomic_int_get (&self->n_streams));
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_SKIPPED_STREAMS:
+      g_value_set_uint (value, g_atomic_int_get (&self->n_skipped_streams));
+      break;
+    case PROP_AUTOPLUG_STATS:
+      g_value_take_boxed (value, gst_autoplug_memo_get_stats ());
+      break;
+    case PROP_RECYCLE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->recycle);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STREAM_SELECTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boxed (value, self->stream_selection);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_PARALLELISM:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->video_filter_parallelism);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->video_filter_description);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AUDIO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->audio_filter_description);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -461,10 +1445,24 @@ gst_transcode_bin_set_property (GObject * object,
 
   switch (prop_id) {
     case PROP_PROFILE:
+    {
+      GstEncodingProfile *profile = g_value_dup_object (value), *old;
+      gboolean changed;
+
       GST_OBJECT_LOCK (self);
-      self->profile = g_value_dup_object (value);
+      old = self->profile;
+      changed = !old || !profile || !gst_encoding_profile_is_equal (old,
+          profile);
+      self->profile = profile;
       GST_OBJECT_UNLOCK (self);
+
+      /* A recycled encodebin is only good for the profile it was made for */
+      if (changed && self->encodebin && GST_STATE (self) <= GST_STATE_READY)
+        remove_encodebin (self);
+      if (old)
+        g_object_unref (old);
       break;
+    }
     case PROP_AVOID_REENCODING:
       GST_OBJECT_LOCK (self);
       self->avoid_reencoding = g_value_get_boolean (value);
@@ -476,6 +1474,69 @@ gst_transcode_bin_set_property (GObject * object,
     case PROP_VIDEO_FILTER:
       _set_filter (self, g_value_dup_object (value), &self->video_filter);
       break;
+    case PROP_START_TIME:
+      GST_OBJECT_LOCK (self);
+      self->start_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STOP_TIME:
+      GST_OBJECT_LOCK (self);
+      self->stop_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_DECOUPLING_QUEUES:
+      GST_OBJECT_LOCK (self);
+      self->decoupling_queues = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_TIME:
+      GST_OBJECT_LOCK (self);
+      self->queue_max_size_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_BYTES:
+      GST_OBJECT_LOCK (self);
+      self->queue_max_size_bytes = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_MAX_SIZE_BUFFERS:
+      GST_OBJECT_LOCK (self);
+      self->queue_max_size_buffers = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_QUEUE_LEAKY:
+      GST_OBJECT_LOCK (self);
+      self->queue_leaky = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_RECYCLE:
+      GST_OBJECT_LOCK (self);
+      self->recycle = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STREAM_SELECTION:
+      GST_OBJECT_LOCK (self);
+      g_strfreev (self->stream_selection);
+      self->stream_selection = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_PARALLELISM:
+      GST_OBJECT_LOCK (self);
+      self->video_filter_parallelism = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->video_filter_description);
+      self->video_filter_description = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AUDIO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->audio_filter_description);
+      self->audio_filter_description = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -526,6 +1587,33 @@ gst_transcode_bin_class_init (GstTranscodeBinClass * klass)
       g_param_spec_object ("video-filter", "Video filter",
           "the video filter(s) to apply, if possible",
           GST_TYPE_ELEMENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstTranscodeBin:video-filter-parallelism:
+   *
+   * The number of copies of the #GstTranscodeBin:video-filter processing
+   * frames in parallel, each in its own thread. This only applies to
+   * stateless filters, others keep processing frames one at a time.
+   */
+  g_object_class_install_property (object_class, PROP_VIDEO_FILTER_PARALLELISM,
+      g_param_spec_uint ("video-filter-parallelism", "Video filter parallelism",
+          "Number of frames the video filter processes in parallel, if it is "
+          "stateless", 1, G_MAXUINT16, DEFAULT_VIDEO_FILTER_PARALLELISM,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:video-filter-description:
+   *
+   * A gst-launch style description of the video filter, a new instance of
+   * it is made for each decoded video stream so that several streams can be
+   * filtered concurrently. Takes precedence over
+   * #GstTranscodeBin:video-filter.
+   */
+  g_object_class_install_property (object_class, PROP_VIDEO_FILTER_DESCRIPTION,
+      g_param_spec_string ("video-filter-description",
+          "Video filter description",
+          "Description of the video filter to instantiate for each video "
+          "stream", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstTranscodeBin:audio-filter:
    *
@@ -535,6 +1623,177 @@ gst_transcode_bin_class_init (GstTranscodeBinClass * klass)
       g_param_spec_object ("audio-filter", "Audio filter",
           "the audio filter(s) to apply, if possible",
           GST_TYPE_ELEMENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:audio-filter-description:
+   *
+   * A gst-launch style description of the audio filter, a new instance of
+   * it is made for each decoded audio stream. Takes precedence over
+   * #GstTranscodeBin:audio-filter.
+   */
+  g_object_class_install_property (object_class, PROP_AUDIO_FILTER_DESCRIPTION,
+      g_param_spec_string ("audio-filter-description",
+          "Audio filter description",
+          "Description of the audio filter to instantiate for each audio "
+          "stream", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:start-time:
+   *
+   * The position in the input stream to start transcoding from, the
+   * output starts at 0. This property must be set before going to
+   * %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_START_TIME,
+      g_param_spec_uint64 ("start-time", "Start time",
+          "Position of the input stream to start transcoding from",
+          0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:stop-time:
+   *
+   * The position in the input stream to stop transcoding at. This
+   * property must be set before going to %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_STOP_TIME,
+      g_param_spec_uint64 ("stop-time", "Stop time",
+          "Position of the input stream to stop transcoding at",
+          0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:decoupling-queues:
+   *
+   * Whether to insert a queue after the decoder and after the filter of
+   * each stream, so that decoding, filtering and encoding run in their
+   * own streaming threads. The queues are configured with the queue-*
+   * properties. This property must be set before going to
+   * %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_DECOUPLING_QUEUES,
+      g_param_spec_boolean ("decoupling-queues", "Decoupling queues",
+          "Whether to decouple decoding, filtering and encoding with queues",
+          DEFAULT_DECOUPLING_QUEUES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_QUEUE_MAX_SIZE_TIME,
+      g_param_spec_uint64 ("queue-max-size-time", "Queue max size time",
+          "Max amount of data in each decoupling queue (in ns, 0=disable)",
+          0, G_MAXUINT64, DEFAULT_QUEUE_MAX_SIZE_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_QUEUE_MAX_SIZE_BYTES,
+      g_param_spec_uint ("queue-max-size-bytes", "Queue max size bytes",
+          "Max amount of data in each decoupling queue (in bytes, 0=disable)",
+          0, G_MAXUINT, DEFAULT_QUEUE_MAX_SIZE_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_QUEUE_MAX_SIZE_BUFFERS,
+      g_param_spec_uint ("queue-max-size-buffers", "Queue max size buffers",
+          "Max number of buffers in each decoupling queue (0=disable)",
+          0, G_MAXUINT, DEFAULT_QUEUE_MAX_SIZE_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_QUEUE_LEAKY,
+      g_param_spec_enum ("queue-leaky", "Queue leaky",
+          "Where the decoupling queues drop buffers when full",
+          GST_TYPE_TRANSCODE_QUEUE_LEAKY, DEFAULT_QUEUE_LEAKY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:queue-levels:
+   *
+   * The current level of each decoupling queue, as a structure with one
+   * field per queue named after it ("decode-queue-N" or "filter-queue-N"
+   * for stream N). Each field holds a structure with the
+   * "current-level-time", "current-level-bytes" and
+   * "current-level-buffers" of the queue: a stream whose decode queue is
+   * full is bottlenecked downstream, by its filter or encoder.
+   */
+  g_object_class_install_property (object_class, PROP_QUEUE_LEVELS,
+      g_param_spec_boxed ("queue-levels", "Queue levels",
+          "The current level of each decoupling queue", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:remuxing:
+   *
+   * Whether all the streams exposed so far are remuxed without being
+   * decoded. With #GstTranscodeBin:avoid-reencoding set, the input is only
+   * parsed and decoders are plugged for the streams not matching the
+   * profile, so when all of them match no decoder is ever loaded.
+   */
+  g_object_class_install_property (object_class, PROP_REMUXING,
+      g_param_spec_boolean ("remuxing", "Remuxing",
+          "Whether all the streams are remuxed without being decoded", FALSE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:skipped-streams:
+   *
+   * The number of input streams which were neither parsed nor decoded
+   * because the profile has no stream profile of their media type, for
+   * example the video of a file transcoded to an audio only format.
+   */
+  g_object_class_install_property (object_class, PROP_SKIPPED_STREAMS,
+      g_param_spec_uint ("skipped-streams", "Skipped streams",
+          "Number of streams skipped without being decoded", 0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:stream-selection:
+   *
+   * The streams to transcode, the others are dropped at the demuxer
+   * without being decoded. A stream is selected when it matches any of
+   * the selectors, which can be:
+   *
+   * - "id:<stream-id>": the stream with that stream-id
+   * - "<type>": all the streams of that type, "video", "audio" or "text"
+   * - "<type>:<index>": the stream of that type with that index, in the
+   *   order the demuxer exposes them, starting at 0
+   * - "<type>:<language>": the streams of that type tagged with a language
+   *   code starting with <language>, "en" matching "en" and "eng"
+   *
+   * The language comes from the #GstStream of the stream or its tags. A
+   * stream whose language is still unknown when the demuxer exposes it is
+   * decoded and only dropped if it is not tagged once decoded.
+   *
+   * %NULL or an empty array selects all the streams.
+   */
+  g_object_class_install_property (object_class, PROP_STREAM_SELECTION,
+      g_param_spec_boxed ("stream-selection", "Stream selection",
+          "Selectors of the streams to transcode", G_TYPE_STRV,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:autoplug-stats:
+   *
+   * The statistics of the process wide memo of the factories the decoding
+   * elements can plug for a given caps. The structure holds the "hits" and
+   * "misses" G_TYPE_UINT64 fields, counting the streams whose factories
+   * came from the memo or had to be looked up in the registry, and the
+   * "size" G_TYPE_UINT field, the number of caps currently memoized.
+   */
+  g_object_class_install_property (object_class, PROP_AUTOPLUG_STATS,
+      g_param_spec_boxed ("autoplug-stats", "Autoplug statistics",
+          "Statistics of the memo of the factories plugged for each caps",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstTranscodeBin:recycle:
+   *
+   * Keep the encodebin, with its encoders and muxer, when going back to
+   * %GST_STATE_READY so that the next run reuses them instead of plugging
+   * new ones. The next run streams are linked to the encoding branches the
+   * previous run streams of the same media type used, the branches left
+   * unused are released once the input exposed all its streams. Setting a
+   * different #GstTranscodeBin:profile drops the encodebin.
+   */
+  g_object_class_install_property (object_class, PROP_RECYCLE,
+      g_param_spec_boolean ("recycle", "Recycle",
+          "Keep the encoding elements from one run to the next", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -554,8 +1813,26 @@ gst_transcode_bin_init (GstTranscodeBin * self)
   self->srcpad = gst_ghost_pad_new_no_target_from_template ("src", pad_tmpl);
   gst_pad_set_active (self->srcpad, TRUE);
   gst_element_add_pad (GST_ELEMENT (self), self->srcpad);
+  gst_pad_add_probe (self->srcpad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      (GstPadProbeCallback) src_event_probe_cb, self, NULL);
 
   gst_object_unref (pad_tmpl);
+
+  self->start_time = GST_CLOCK_TIME_NONE;
+  self->stop_time = GST_CLOCK_TIME_NONE;
+
+  self->video_filter_parallelism = DEFAULT_VIDEO_FILTER_PARALLELISM;
+  self->decoupling_queues = DEFAULT_DECOUPLING_QUEUES;
+  self->queue_max_size_time = DEFAULT_QUEUE_MAX_SIZE_TIME;
+  self->queue_max_size_bytes = DEFAULT_QUEUE_MAX_SIZE_BYTES;
+  self->queue_max_size_buffers = DEFAULT_QUEUE_MAX_SIZE_BUFFERS;
+  self->queue_leaky = DEFAULT_QUEUE_LEAKY;
+
+  self->selected_streams = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  self->stream_indexes = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  self->n_streams_per_type = g_hash_table_new (g_str_hash, g_str_equal);
 }
 
 static gboolean
@@ -573,6 +1850,9 @@ plugin_init (GstPlugin * plugin)
   res &= gst_element_register (plugin, "uritranscodebin", GST_RANK_NONE,
       gst_uri_transcode_bin_get_type ());
 
+  res &= gst_element_register (plugin, "multitranscodebin", GST_RANK_NONE,
+      gst_multi_transcode_bin_get_type ());
+
   return res;
 }
 
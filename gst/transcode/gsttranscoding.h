@@ -25,7 +25,45 @@
 
 #include <gst/gst.h>
 
+/**
+ * GstTranscodePacing:
+ * @GST_TRANSCODE_PACING_NONE: Process buffers as fast as possible, the sink
+ * does not synchronize on the clock at all.
+ * @GST_TRANSCODE_PACING_CPU_BUDGET: Synchronize on a #GstCpuThrottlingClock
+ * so that the transcoding process stays within its CPU usage budget.
+ * @GST_TRANSCODE_PACING_REALTIME: Synchronize on the system clock so that the
+ * stream is transcoded at its nominal playback speed.
+ */
+typedef enum
+{
+  GST_TRANSCODE_PACING_NONE,
+  GST_TRANSCODE_PACING_CPU_BUDGET,
+  GST_TRANSCODE_PACING_REALTIME,
+} GstTranscodePacing;
+
+#define GST_TYPE_TRANSCODE_PACING (gst_transcode_pacing_get_type ())
+
+/**
+ * GstTranscodeQueueLeaky:
+ * @GST_TRANSCODE_QUEUE_LEAKY_NONE: The decoupling queues block when full.
+ * @GST_TRANSCODE_QUEUE_LEAKY_UPSTREAM: Incoming buffers are dropped when a
+ * decoupling queue is full.
+ * @GST_TRANSCODE_QUEUE_LEAKY_DOWNSTREAM: The oldest buffers are dropped when
+ * a decoupling queue is full.
+ */
+typedef enum
+{
+  GST_TRANSCODE_QUEUE_LEAKY_NONE,
+  GST_TRANSCODE_QUEUE_LEAKY_UPSTREAM,
+  GST_TRANSCODE_QUEUE_LEAKY_DOWNSTREAM,
+} GstTranscodeQueueLeaky;
+
+#define GST_TYPE_TRANSCODE_QUEUE_LEAKY (gst_transcode_queue_leaky_get_type ())
+
+GType gst_transcode_pacing_get_type (void);
+GType gst_transcode_queue_leaky_get_type (void);
 GType gst_transcode_bin_get_type (void);
 GType gst_uri_transcode_bin_get_type (void);
+GType gst_multi_transcode_bin_get_type (void);
 
 #endif /* __GST_TRANSCODING_H__ */
@@ -24,6 +24,8 @@
 
 #include "gsttranscoding.h"
 #include "gst-cpu-throttling-clock.h"
+#include "gst-cpu-governor.h"
+#include "gst-autoplug-memo.h"
 #include <gst/pbutils/pbutils.h>
 
 #include <gst/pbutils/missing-plugins.h>
@@ -42,16 +44,28 @@ typedef struct
 
   GstElement *audio_filter;
   GstElement *video_filter;
+  guint video_filter_parallelism;
+  gchar *video_filter_description;
+  gchar *audio_filter_description;
+  gchar **stream_selection;
 
   GstEncodingProfile *profile;
   gboolean avoid_reencoding;
   guint wanted_cpu_usage;
+  guint cpu_weight;
+  GstTranscodePacing pacing;
 
   GstElement *sink;
   gchar *dest_uri;
 
   GstClock *cpu_clock;
 
+  GstClockTime start_time;
+  GstClockTime stop_time;
+
+  /* Whether the source, transcodebin and sink are kept from one run to
+   * the next */
+  gboolean recycle;
 } GstUriTranscodeBin;
 
 typedef struct
@@ -70,6 +84,7 @@ typedef struct
 #define GST_URI_TRANSCODE_BIN_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj), GST_URI_TRANSCODE_BIN_TYPE, GstUriTranscodeBinClass))
 
 #define DEFAULT_AVOID_REENCODING   FALSE
+#define DEFAULT_PACING GST_TRANSCODE_PACING_CPU_BUDGET
 
 G_DEFINE_TYPE (GstUriTranscodeBin, gst_uri_transcode_bin, GST_TYPE_PIPELINE)
 enum
@@ -84,6 +99,23 @@ enum
  PROP_CPU_USAGE,
  PROP_VIDEO_FILTER,
  PROP_AUDIO_FILTER,
+ PROP_PACING,
+ PROP_CPU_WEIGHT,
+ PROP_CPU_GOVERNOR,
+ PROP_START_TIME,
+ PROP_STOP_TIME,
+ PROP_VIDEO_FILTER_PARALLELISM,
+ PROP_VIDEO_FILTER_DESCRIPTION,
+ PROP_AUDIO_FILTER_DESCRIPTION,
+ PROP_REMUXING,
+ PROP_SKIPPED_STREAMS,
+ PROP_STREAM_SELECTION,
+ PROP_AUTOPLUG_STATS,
+ PROP_RECYCLE,
+ PROP_PSI_PATH,
+ PROP_CPU_PRESSURE_THRESHOLD,
+ PROP_IO_PRESSURE_THRESHOLD,
+ PROP_MEMORY_PRESSURE_THRESHOLD,
  LAST_PROP
 };
 
@@ -101,6 +133,73 @@ post_missing_plugin_error (GstElement * dec, const gchar * element_name)
 }
 /* *INDENT-ON* */
 
+#define C_ENUM(v) ((gint) v)
+
+GType
+gst_transcode_pacing_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {C_ENUM (GST_TRANSCODE_PACING_NONE), "GST_TRANSCODE_PACING_NONE", "none"},
+    {C_ENUM (GST_TRANSCODE_PACING_CPU_BUDGET),
+        "GST_TRANSCODE_PACING_CPU_BUDGET", "cpu-budget"},
+    {C_ENUM (GST_TRANSCODE_PACING_REALTIME), "GST_TRANSCODE_PACING_REALTIME",
+        "realtime"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp = g_enum_register_static ("GstTranscodePacing", values);
+    g_once_init_leave (&id, tmp);
+  }
+
+  return (GType) id;
+}
+
+/* Must be called without the object lock as the pipeline takes it when
+ * changing its clock */
+static void
+update_pacing (GstUriTranscodeBin * self)
+{
+  GstTranscodePacing pacing;
+  GstElement *sink = NULL;
+
+  GST_OBJECT_LOCK (self);
+  pacing = self->pacing;
+  if (self->sink)
+    sink = gst_object_ref (self->sink);
+  GST_OBJECT_UNLOCK (self);
+
+  if (pacing == GST_TRANSCODE_PACING_CPU_BUDGET && self->cpu_clock)
+    gst_pipeline_use_clock (GST_PIPELINE (self), self->cpu_clock);
+  else
+    gst_pipeline_auto_clock (GST_PIPELINE (self));
+
+  if (sink) {
+    if (pacing == GST_TRANSCODE_PACING_NONE)
+      g_object_set (sink, "sync", FALSE, NULL);
+    else
+      g_object_set (sink, "sync", TRUE, "max-lateness", GST_CLOCK_TIME_NONE,
+          NULL);
+    gst_object_unref (sink);
+  }
+}
+
+static void
+configure_transcodebin (GstUriTranscodeBin * self)
+{
+  g_object_set (self->transcodebin, "profile", self->profile,
+      "video-filter", self->video_filter,
+      "video-filter-parallelism", self->video_filter_parallelism,
+      "video-filter-description", self->video_filter_description,
+      "audio-filter", self->audio_filter,
+      "audio-filter-description", self->audio_filter_description,
+      "stream-selection", self->stream_selection,
+      "avoid-reencoding", self->avoid_reencoding,
+      "start-time", self->start_time, "stop-time", self->stop_time,
+      "recycle", self->recycle, NULL);
+}
+
 static gboolean
 make_transcodebin (GstUriTranscodeBin * self)
 {
@@ -110,11 +209,7 @@ make_transcodebin (GstUriTranscodeBin * self)
   if (!self->transcodebin)
     goto no_decodebin;
 
-  g_object_set (self->transcodebin, "profile", self->profile,
-      "video-filter", self->video_filter,
-      "audio-filter", self->audio_filter,
-      "avoid-reencoding", self->avoid_reencoding, NULL);
-
+  configure_transcodebin (self);
   gst_bin_add (GST_BIN (self), self->transcodebin);
   if (!gst_element_link (self->transcodebin, self->sink))
     return FALSE;
@@ -147,8 +242,7 @@ make_dest (GstUriTranscodeBin * self)
     goto no_sink;
 
   gst_bin_add (GST_BIN (self), self->sink);
-  g_object_set (self->sink, "sync", TRUE, "max-lateness", GST_CLOCK_TIME_NONE,
-      NULL);
+  update_pacing (self);
   return TRUE;
 
 invalid_uri:
@@ -269,6 +363,32 @@ remove_all_children (GstUriTranscodeBin * self)
   }
 }
 
+/* Points the children kept from the previous run to the new URIs,
+ * returns %FALSE if the source or the sink can not handle them */
+static gboolean
+recycle_children (GstUriTranscodeBin * self)
+{
+  GError *err = NULL;
+
+  if (!GST_IS_URI_HANDLER (self->src) || !GST_IS_URI_HANDLER (self->sink))
+    return FALSE;
+
+  if (!gst_uri_handler_set_uri (GST_URI_HANDLER (self->src), self->source_uri,
+          &err) || !gst_uri_handler_set_uri (GST_URI_HANDLER (self->sink),
+          self->dest_uri, &err)) {
+    GST_INFO_OBJECT (self, "Can not recycle the elements: %s",
+        err ? err->message : "URI not handled");
+    g_clear_error (&err);
+
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (self, "Recycling the elements of the previous run");
+  configure_transcodebin (self);
+
+  return TRUE;
+}
+
 static GstStateChangeReturn
 gst_uri_transcode_bin_change_state (GstElement * element,
     GstStateChange transition)
@@ -279,6 +399,13 @@ gst_uri_transcode_bin_change_state (GstElement * element,
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
 
+      if (self->transcodebin) {
+        if (recycle_children (self))
+          goto set_paused;
+
+        remove_all_children (self);
+      }
+
       if (!make_dest (self))
         goto setup_failed;
 
@@ -288,6 +415,7 @@ gst_uri_transcode_bin_change_state (GstElement * element,
       if (!make_source (self))
         goto setup_failed;
 
+set_paused:
       if (gst_element_set_state (self->sink,
               GST_STATE_PAUSED) == GST_STATE_CHANGE_FAILURE) {
         GST_ERROR_OBJECT (self,
@@ -322,6 +450,10 @@ gst_uri_transcode_bin_change_state (GstElement * element,
 
   switch (transition) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      if (!self->recycle)
+        remove_all_children (self);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
       remove_all_children (self);
       break;
     default:
@@ -336,6 +468,38 @@ setup_failed:
   return GST_STATE_CHANGE_FAILURE;
 }
 
+static void
+gst_uri_transcode_bin_handle_message (GstBin * bin, GstMessage * msg)
+{
+  GstUriTranscodeBin *self = GST_URI_TRANSCODE_BIN (bin);
+
+  /* Stream status messages are posted synchronously from the streaming
+   * threads, let the clock account for their CPU time */
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_STREAM_STATUS && self->cpu_clock) {
+    GstStreamStatusType type;
+    GstElement *owner;
+
+    gst_message_parse_stream_status (msg, &type, &owner);
+    if (type == GST_STREAM_STATUS_TYPE_ENTER)
+      gst_cpu_throttling_clock_add_thread (GST_CPU_THROTTLING_CLOCK
+          (self->cpu_clock));
+    else if (type == GST_STREAM_STATUS_TYPE_LEAVE)
+      gst_cpu_throttling_clock_remove_thread (GST_CPU_THROTTLING_CLOCK
+          (self->cpu_clock));
+  }
+
+  GST_BIN_CLASS (parent_class)->handle_message (bin, msg);
+}
+
+/* Forwards the clock statistics as a `cpu-throttle-stats` element message */
+static void
+cpu_clock_stats_cb (GstCpuThrottlingClock * clock, const GstStructure * stats,
+    GstUriTranscodeBin * self)
+{
+  gst_element_post_message (GST_ELEMENT (self),
+      gst_message_new_element (GST_OBJECT (self), gst_structure_copy (stats)));
+}
+
 static void
 gst_uri_transcode_bin_constructed (GObject * object)
 {
@@ -344,7 +508,9 @@ gst_uri_transcode_bin_constructed (GObject * object)
 
   self->cpu_clock =
       GST_CLOCK (gst_cpu_throttling_clock_new (self->wanted_cpu_usage));
-  gst_pipeline_use_clock (GST_PIPELINE (self), self->cpu_clock);
+  g_signal_connect (self->cpu_clock, "stats", G_CALLBACK (cpu_clock_stats_cb),
+      self);
+  update_pacing (self);
 #endif
 
   ((GObjectClass *) parent_class)->constructed (object);
@@ -357,6 +523,12 @@ gst_uri_transcode_bin_dispose (GObject * object)
 
   g_clear_object (&self->video_filter);
   g_clear_object (&self->audio_filter);
+  g_clear_pointer (&self->video_filter_description, g_free);
+  g_clear_pointer (&self->audio_filter_description, g_free);
+  g_clear_pointer (&self->stream_selection, g_strfreev);
+  if (self->cpu_clock)
+    g_signal_handlers_disconnect_by_func (self->cpu_clock,
+        cpu_clock_stats_cb, self);
   g_clear_object (&self->cpu_clock);
 
   G_OBJECT_CLASS (gst_uri_transcode_bin_parent_class)->dispose (object);
@@ -414,6 +586,84 @@ gst_uri_transcode_bin_get_property (GObject * object,
       g_value_set_object (value, self->audio_filter);
       GST_OBJECT_UNLOCK (self);
       break;
+    case PROP_PACING:
+      GST_OBJECT_LOCK (self);
+      g_value_set_enum (value, self->pacing);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CPU_WEIGHT:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->cpu_weight);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CPU_GOVERNOR:
+      g_value_take_object (value, gst_cpu_governor_get_default ());
+      break;
+    case PROP_START_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->start_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STOP_TIME:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint64 (value, self->stop_time);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_PARALLELISM:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->video_filter_parallelism);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->video_filter_description);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AUDIO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_string (value, self->audio_filter_description);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STREAM_SELECTION:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boxed (value, self->stream_selection);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AUTOPLUG_STATS:
+      g_value_take_boxed (value, gst_autoplug_memo_get_stats ());
+      break;
+    case PROP_RECYCLE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->recycle);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_PSI_PATH:
+    case PROP_CPU_PRESSURE_THRESHOLD:
+    case PROP_IO_PRESSURE_THRESHOLD:
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+      /* The clock has the same properties */
+      if (self->cpu_clock)
+        g_object_get_property (G_OBJECT (self->cpu_clock), pspec->name, value);
+      else
+        g_param_value_set_default (pspec, value);
+      break;
+    case PROP_REMUXING:
+    case PROP_SKIPPED_STREAMS:
+    {
+      GstElement *transcodebin = NULL;
+
+      GST_OBJECT_LOCK (self);
+      if (self->transcodebin)
+        transcodebin = gst_object_ref (self->transcodebin);
+      GST_OBJECT_UNLOCK (self);
+
+      /* Those are only known by the transcodebin while running */
+      if (transcodebin) {
+        g_object_get_property (G_OBJECT (transcodebin), pspec->name, value);
+        gst_object_unref (transcodebin);
+      }
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -427,9 +677,32 @@ gst_uri_transcode_bin_set_property (GObject * object,
 
   switch (prop_id) {
     case PROP_PROFILE:
+    {
+      GstEncodingProfile *old;
+
       GST_OBJECT_LOCK (self);
+      old = self->profile;
       self->profile = g_value_dup_object (value);
       GST_OBJECT_UNLOCK (self);
+      if (old)
+        g_object_unref (old);
+      break;
+    }
+    case PROP_RECYCLE:
+      GST_OBJECT_LOCK (self);
+      self->recycle = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_PSI_PATH:
+    case PROP_CPU_PRESSURE_THRESHOLD:
+    case PROP_IO_PRESSURE_THRESHOLD:
+    case PROP_MEMORY_PRESSURE_THRESHOLD:
+#if HAVE_GETRUSAGE
+      g_object_set_property (G_OBJECT (self->cpu_clock), pspec->name, value);
+#else
+      GST_ERROR_OBJECT (self,
+          "No CPU usage throttling support for that platform");
+#endif
       break;
     case PROP_DEST_URI:
       GST_OBJECT_LOCK (self);
@@ -487,6 +760,67 @@ gst_uri_transcode_bin_set_property (GObject * object,
       self->video_filter = g_value_dup_object (value);
       GST_OBJECT_UNLOCK (self);
       break;
+    case PROP_PACING:
+      GST_OBJECT_LOCK (self);
+      self->pacing = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (self);
+      update_pacing (self);
+      break;
+    case PROP_START_TIME:
+      GST_OBJECT_LOCK (self);
+      self->start_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STOP_TIME:
+      GST_OBJECT_LOCK (self);
+      self->stop_time = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_PARALLELISM:
+      GST_OBJECT_LOCK (self);
+      self->video_filter_parallelism = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_VIDEO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->video_filter_description);
+      self->video_filter_description = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_AUDIO_FILTER_DESCRIPTION:
+      GST_OBJECT_LOCK (self);
+      g_free (self->audio_filter_description);
+      self->audio_filter_description = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_STREAM_SELECTION:
+      GST_OBJECT_LOCK (self);
+      g_strfreev (self->stream_selection);
+      self->stream_selection = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    case PROP_CPU_WEIGHT:
+#if HAVE_GETRUSAGE
+    {
+      GstCpuGovernor *governor = NULL;
+
+      GST_OBJECT_LOCK (self);
+      self->cpu_weight = g_value_get_uint (value);
+      if (self->cpu_weight)
+        governor = gst_cpu_governor_get_default ();
+      g_object_set (self->cpu_clock, "governor", governor, "weight",
+          MAX (self->cpu_weight, 1), NULL);
+      GST_OBJECT_UNLOCK (self);
+
+      if (governor)
+        gst_object_unref (governor);
+      break;
+    }
+#else
+      GST_ERROR_OBJECT (self,
+          "No CPU usage throttling support for that platform");
+      break;
+#endif
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
   }
@@ -507,6 +841,9 @@ gst_uri_transcode_bin_class_init (GstUriTranscodeBinClass * klass)
   gstelement_klass->change_state =
       GST_DEBUG_FUNCPTR (gst_uri_transcode_bin_change_state);
 
+  GST_BIN_CLASS (klass)->handle_message =
+      GST_DEBUG_FUNCPTR (gst_uri_transcode_bin_handle_message);
+
   GST_DEBUG_CATEGORY_INIT (gst_uri_transcodebin_debug, "uritranscodebin", 0,
       "UriTranscodebin element");
 
@@ -560,6 +897,43 @@ gst_uri_transcode_bin_class_init (GstUriTranscodeBinClass * klass)
       g_param_spec_object ("video-filter", "Video filter",
           "the video filter(s) to apply, if possible",
           GST_TYPE_ELEMENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstUriTranscodeBin:video-filter-parallelism:
+   *
+   * The number of copies of the #GstUriTranscodeBin:video-filter
+   * processing frames in parallel, if it is stateless. This property must
+   * be set before going to %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_VIDEO_FILTER_PARALLELISM,
+      g_param_spec_uint ("video-filter-parallelism", "Video filter parallelism",
+          "Number of frames the video filter processes in parallel, if it is "
+          "stateless", 1, G_MAXUINT16, 1,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:video-filter-description:
+   *
+   * A gst-launch style description of the video filter to instantiate for
+   * each decoded video stream, see #GstTranscodeBin:video-filter-description.
+   */
+  g_object_class_install_property (object_class, PROP_VIDEO_FILTER_DESCRIPTION,
+      g_param_spec_string ("video-filter-description",
+          "Video filter description",
+          "Description of the video filter to instantiate for each video "
+          "stream", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:audio-filter-description:
+   *
+   * A gst-launch style description of the audio filter to instantiate for
+   * each decoded audio stream, see #GstTranscodeBin:audio-filter-description.
+   */
+  g_object_class_install_property (object_class, PROP_AUDIO_FILTER_DESCRIPTION,
+      g_param_spec_string ("audio-filter-description",
+          "Audio filter description",
+          "Description of the audio filter to instantiate for each audio "
+          "stream", NULL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   /**
    * GstUriTranscodeBin:audio-filter:
    *
@@ -569,10 +943,188 @@ gst_uri_transcode_bin_class_init (GstUriTranscodeBinClass * klass)
       g_param_spec_object ("audio-filter", "Audio filter",
           "the audio filter(s) to apply, if possible",
           GST_TYPE_ELEMENT, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:pacing:
+   *
+   * How the transcoding speed is paced. Use #GST_TRANSCODE_PACING_NONE for
+   * batch jobs where the output should be produced as fast as possible, in
+   * that mode the sink does not synchronize and the CPU throttling clock is
+   * not used at all.
+   */
+  g_object_class_install_property (object_class, PROP_PACING,
+      g_param_spec_enum ("pacing", "Pacing",
+          "How the transcoding speed is paced", GST_TYPE_TRANSCODE_PACING,
+          DEFAULT_PACING, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:cpu-weight:
+   *
+   * When non zero, the pipeline shares the CPU budget of the process wide
+   * #GstUriTranscodeBin:cpu-governor with the other pipelines having a
+   * weight, instead of using its own #GstUriTranscodeBin:cpu-usage.
+   * Pipelines with a higher weight get a bigger share of the budget.
+   */
+  g_object_class_install_property (object_class, PROP_CPU_WEIGHT,
+      g_param_spec_uint ("cpu-weight", "CPU weight",
+          "Weight of the pipeline in the process wide CPU budget "
+          "(0 = use its own budget)", 0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:cpu-governor:
+   *
+   * The process wide governor splitting its #GstCpuGovernor:cpu-usage
+   * between the pipelines with a #GstUriTranscodeBin:cpu-weight.
+   */
+  g_object_class_install_property (object_class, PROP_CPU_GOVERNOR,
+      g_param_spec_object ("cpu-governor", "CPU governor",
+          "The process wide CPU governor", GST_TYPE_OBJECT,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:start-time:
+   *
+   * The position in the source to start transcoding from, the output
+   * starts at 0. This property must be set before going to
+   * %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_START_TIME,
+      g_param_spec_uint64 ("start-time", "Start time",
+          "Position of the source to start transcoding from",
+          0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:stop-time:
+   *
+   * The position in the source to stop transcoding at. This property must
+   * be set before going to %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_STOP_TIME,
+      g_param_spec_uint64 ("stop-time", "Stop time",
+          "Position of the source to stop transcoding at",
+          0, G_MAXUINT64, GST_CLOCK_TIME_NONE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:remuxing:
+   *
+   * Whether all the streams are remuxed without being decoded, see
+   * #GstTranscodeBin:remuxing.
+   */
+  g_object_class_install_property (object_class, PROP_REMUXING,
+      g_param_spec_boolean ("remuxing", "Remuxing",
+          "Whether all the streams are remuxed without being decoded", FALSE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:skipped-streams:
+   *
+   * The number of input streams skipped without being decoded, see
+   * #GstTranscodeBin:skipped-streams.
+   */
+  g_object_class_install_property (object_class, PROP_SKIPPED_STREAMS,
+      g_param_spec_uint ("skipped-streams", "Skipped streams",
+          "Number of streams skipped without being decoded", 0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:stream-selection:
+   *
+   * The streams to transcode, see #GstTranscodeBin:stream-selection. This
+   * property must be set before going to %GST_STATE_PAUSED or higher.
+   */
+  g_object_class_install_property (object_class, PROP_STREAM_SELECTION,
+      g_param_spec_boxed ("stream-selection", "Stream selection",
+          "Selectors of the streams to transcode", G_TYPE_STRV,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:autoplug-stats:
+   *
+   * The statistics of the memo of the factories plugged for each caps,
+   * see #GstTranscodeBin:autoplug-stats.
+   */
+  g_object_class_install_property (object_class, PROP_AUTOPLUG_STATS,
+      g_param_spec_boxed ("autoplug-stats", "Autoplug statistics",
+          "Statistics of the memo of the factories plugged for each caps",
+          GST_TYPE_STRUCTURE, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:recycle:
+   *
+   * Keep the source, the sink and the transcodebin, with its encoders,
+   * when going back to %GST_STATE_READY. A new run can then be started by
+   * setting new #GstUriTranscodeBin:source-uri and
+   * #GstUriTranscodeBin:dest-uri, the kept elements are pointed to them
+   * instead of being made again. They are made again when they can not
+   * handle the new URIs. See #GstTranscodeBin:recycle.
+   */
+  g_object_class_install_property (object_class, PROP_RECYCLE,
+      g_param_spec_boolean ("recycle", "Recycle",
+          "Keep the elements from one run to the next", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:psi-path:
+   *
+   * The directory containing the pressure stall information files read
+   * by the CPU throttling clock, see
+   * #GstUriTranscodeBin:cpu-pressure-threshold.
+   */
+  g_object_class_install_property (object_class, PROP_PSI_PATH,
+      g_param_spec_string ("psi-path", "PSI path",
+          "The directory containing the pressure stall information files",
+          GST_CPU_THROTTLING_CLOCK_DEFAULT_PSI_PATH,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:cpu-pressure-threshold:
+   *
+   * The percentage of time some tasks of the host can be stalled waiting
+   * for a CPU before the transcoding slows down, 0 to ignore the CPU
+   * pressure. Only used with the #GST_TRANSCODE_PACING_CPU_BUDGET pacing.
+   */
+  g_object_class_install_property (object_class, PROP_CPU_PRESSURE_THRESHOLD,
+      g_param_spec_double ("cpu-pressure-threshold", "CPU pressure threshold",
+          "Percentage of CPU stall time above which to back off "
+          "(0 = disabled)", 0, 100, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:io-pressure-threshold:
+   *
+   * Like #GstUriTranscodeBin:cpu-pressure-threshold for the time some tasks
+   * were stalled waiting for I/O.
+   */
+  g_object_class_install_property (object_class, PROP_IO_PRESSURE_THRESHOLD,
+      g_param_spec_double ("io-pressure-threshold", "I/O pressure threshold",
+          "Percentage of I/O stall time above which to back off "
+          "(0 = disabled)", 0, 100, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstUriTranscodeBin:memory-pressure-threshold:
+   *
+   * Like #GstUriTranscodeBin:cpu-pressure-threshold for the time some tasks
+   * were stalled waiting for memory.
+   */
+  g_object_class_install_property (object_class,
+      PROP_MEMORY_PRESSURE_THRESHOLD,
+      g_param_spec_double ("memory-pressure-threshold",
+          "Memory pressure threshold",
+          "Percentage of memory stall time above which to back off "
+          "(0 = disabled)", 0, 100, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_uri_transcode_bin_init (GstUriTranscodeBin * self)
 {
   self->wanted_cpu_usage = 100;
+  self->pacing = DEFAULT_PACING;
+  self->start_time = GST_CLOCK_TIME_NONE;
+  self->stop_time = GST_CLOCK_TIME_NONE;
+  self->video_filter_parallelism = 1;
 }
@@ -0,0 +1,181 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the wake ups, the throughput and the CPU usage of a CPU bound
+ * thread throttled by a clock it waits on after each frame like a sink
+ * would:
+ *
+ * - "baseline" reproduces the original GstCpuThrottlingClock: every wait
+ *   sleeps a fixed time, nudged by 0.1 ms every 250 ms depending on
+ *   whether the process used more or less than the target.
+ * - "per-wait" is the current clock without a minimum sleep time: it
+ *   charges the CPU used to its budget and sleeps on every wait that
+ *   overdraws it.
+ * - "batched" is the current clock with a 10 ms minimum sleep time, small
+ *   overdrafts are carried over to the next waits instead.
+ *
+ * The CPU usage is the one of the whole run, in percent of the processors.
+ *
+ * Usage: cpuclock [CPU_USAGE [FRAME_COST_US [DURATION_S]]] */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#include "gst-cpu-throttling-clock.h"
+
+#define BASELINE_EVALUATION_INTERVAL (GST_SECOND / 4)
+#define BASELINE_STEP (GST_MSECOND / 10)
+
+static volatile guint64 sink;
+
+/* Burns @cost of wall clock time on the CPU */
+static void
+burn (GstClockTime cost)
+{
+  gint64 end = g_get_monotonic_time () + GST_TIME_AS_USECONDS (cost);
+
+  while (g_get_monotonic_time () < end)
+    sink++;
+}
+
+static GstClockTime
+get_cpu_time (void)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+
+  return GST_TIMEVAL_TO_TIME (ru.ru_utime) +
+      GST_TIMEVAL_TO_TIME (ru.ru_stime);
+}
+
+static void
+print_results (const gchar * name, gdouble elapsed, guint64 n_sleeps,
+    guint64 n_frames, GstClockTime cpu_time)
+{
+  g_print ("%-10s %8.1f wake ups/s %8.1f frames/s %5.1f%% CPU\n", name,
+      n_sleeps / elapsed, n_frames / elapsed,
+      gst_guint64_to_gdouble (cpu_time) / GST_SECOND / elapsed * 100 /
+      g_get_num_processors ());
+}
+
+/* The wait of the clock before it was reworked, evaluating the usage from
+ * the waiting thread instead of a periodic clock callback. The wait time is
+ * kept within [0, 1s] as intended, the original wrapped around below 0 */
+static void
+run_baseline (guint cpu_usage, GstClockTime frame_cost,
+    GstClockTime duration)
+{
+  guint64 n_frames = 0, n_sleeps = 0;
+  GstClockTime wait_time = GST_MSECOND;
+  GstClockTime start_cpu = get_cpu_time (), last_cpu = start_cpu;
+  gint64 start = g_get_monotonic_time (), last_eval = start, now;
+
+  while ((now = g_get_monotonic_time ()) - start <
+      GST_TIME_AS_USECONDS (duration)) {
+    if (now - last_eval >= GST_TIME_AS_USECONDS (BASELINE_EVALUATION_INTERVAL)) {
+      GstClockTime cpu = get_cpu_time ();
+      gdouble usage = gst_guint64_to_gdouble (cpu - last_cpu) /
+          BASELINE_EVALUATION_INTERVAL * 100 / g_get_num_processors ();
+
+      if (usage < cpu_usage)
+        wait_time = wait_time > BASELINE_STEP ? wait_time - BASELINE_STEP : 0;
+      else
+        wait_time = MIN (wait_time + BASELINE_STEP, GST_SECOND);
+      last_cpu = cpu;
+      last_eval = now;
+    }
+
+    burn (frame_cost);
+    if (wait_time) {
+      g_usleep (GST_TIME_AS_USECONDS (wait_time));
+      n_sleeps++;
+    }
+    n_frames++;
+  }
+
+  print_results ("baseline", (g_get_monotonic_time () - start) /
+      (gdouble) G_USEC_PER_SEC, n_sleeps, n_frames,
+      get_cpu_time () - start_cpu);
+}
+
+static void
+run (const gchar * name, guint cpu_usage, GstClockTime min_sleep_time,
+    GstClockTime frame_cost, GstClockTime duration)
+{
+  GstClockID id;
+  GstStructure *stats;
+  guint64 n_frames = 0, n_sleeps = 0;
+  gdouble elapsed;
+  GstClockTime start_cpu = get_cpu_time ();
+  GstCpuThrottlingClock *clock = gst_cpu_throttling_clock_new (cpu_usage);
+  gint64 start = g_get_monotonic_time ();
+
+  gst_object_ref_sink (clock);
+  g_object_set (clock, "min-sleep-time", (guint64) min_sleep_time, NULL);
+  id = gst_clock_new_single_shot_id (GST_CLOCK (clock), 0);
+
+  while (g_get_monotonic_time () - start < GST_TIME_AS_USECONDS (duration)) {
+    burn (frame_cost);
+    gst_clock_id_wait (id, NULL);
+    n_frames++;
+  }
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  stats = gst_cpu_throttling_clock_get_stats (clock);
+  gst_structure_get_uint64 (stats, "n-sleeps", &n_sleeps);
+  gst_structure_free (stats);
+
+  print_results (name, elapsed, n_sleeps, n_frames,
+      get_cpu_time () - start_cpu);
+
+  gst_clock_id_unref (id);
+  gst_object_unref (clock);
+}
+
+int
+main (int argc, char **argv)
+{
+  guint cpu_usage = 50;
+  GstClockTime frame_cost = 200 * GST_USECOND, duration = 5 * GST_SECOND;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    cpu_usage = atoi (argv[1]);
+  if (argc > 2)
+    frame_cost = atoi (argv[2]) * GST_USECOND;
+  if (argc > 3)
+    duration = atoi (argv[3]) * GST_SECOND;
+
+  g_print ("%u%% of the CPUs, %" G_GUINT64_FORMAT " us per frame\n",
+      cpu_usage, GST_TIME_AS_USECONDS (frame_cost));
+
+  run_baseline (cpu_usage, frame_cost, duration);
+  run ("per-wait", cpu_usage, 0, frame_cost, duration);
+  run ("batched", cpu_usage, 10 * GST_MSECOND, frame_cost, duration);
+
+  return 0;
+}
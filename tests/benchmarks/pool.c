@@ -0,0 +1,137 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the time a GstTranscoderPool takes to run many short jobs
+ * transcoding the same file the same way, with and without
+ * #GstTranscoderPool:recycle, where the setup of each job weighs as much
+ * as the transcoding itself.
+ *
+ * Usage: pool [N_JOBS [MAX_JOBS [N_FRAMES]]] */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+#include <gst/transcoding/transcoder/gsttranscoderpool.h>
+
+#include "transcoder-test-utils.h"
+
+/* Motion JPEG so that every job decodes and encodes its stream */
+#define SOURCE_PIPELINE "videotestsrc num-buffers=%u ! " \
+  "video/x-raw,width=320,height=240,framerate=30/1 ! " \
+  "jpegenc ! avimux ! filesink location=\"%s\""
+
+static gboolean
+make_source (const gchar * filename, guint n_frames)
+{
+  GError *err = NULL;
+  gchar *description = g_strdup_printf (SOURCE_PIPELINE, n_frames, filename);
+  gboolean res = transcoder_test_run_pipeline (description, &err);
+
+  if (!res) {
+    g_printerr ("Could not create the source: %s\n",
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+  }
+  g_free (description);
+
+  return res;
+}
+
+static void
+run (const gchar * name, gboolean recycle, const gchar * tmpdir,
+    const gchar * source_uri, GstEncodingProfile * profile, guint n_jobs,
+    guint max_jobs)
+{
+  guint i, done = 0, failed = 0, recycled = 0;
+  gdouble elapsed;
+  GstStructure *stats;
+  GstTranscoderPool *pool = gst_transcoder_pool_new (max_jobs);
+  gint64 start = g_get_monotonic_time ();
+
+  gst_transcoder_pool_set_recycle (pool, recycle);
+  for (i = 0; i < n_jobs; i++) {
+    gchar *basename = g_strdup_printf ("%s-%u.mp4", name, i);
+    gchar *filename = g_build_filename (tmpdir, basename, NULL);
+    gchar *dest_uri = gst_filename_to_uri (filename, NULL);
+
+    gst_transcoder_pool_push (pool, source_uri, dest_uri, profile, 0);
+    g_free (dest_uri);
+    g_free (filename);
+    g_free (basename);
+  }
+  gst_transcoder_pool_wait (pool);
+  elapsed = (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC;
+
+  stats = gst_transcoder_pool_get_stats (pool);
+  gst_structure_get_uint (stats, "done", &done);
+  gst_structure_get_uint (stats, "failed", &failed);
+  gst_structure_get_uint (stats, "recycled", &recycled);
+  gst_structure_free (stats);
+  gst_object_unref (pool);
+
+  g_print ("%-10s %4u jobs (%u failed, %u recycled) in %7.3f s: "
+      "%7.2f ms/job %7.2f jobs/s\n", name, done + failed, failed, recycled,
+      elapsed, elapsed * 1000 / MAX (n_jobs, 1), n_jobs / elapsed);
+}
+
+int
+main (int argc, char **argv)
+{
+  gchar *tmpdir, *filename, *source_uri;
+  GstEncodingProfile *profile;
+  guint n_jobs = argc > 1 ? atoi (argv[1]) : 50;
+  guint max_jobs = argc > 2 ? atoi (argv[2]) : 1;
+  guint n_frames = argc > 3 ? atoi (argv[3]) : 10;
+
+  gst_init (&argc, &argv);
+
+  tmpdir = g_dir_make_tmp ("bench-pool-XXXXXX", NULL);
+  if (!tmpdir)
+    return 1;
+
+  filename = g_build_filename (tmpdir, "source.avi", NULL);
+  if (!make_source (filename, n_frames)) {
+    g_free (filename);
+    transcoder_test_remove_dir (tmpdir);
+    g_free (tmpdir);
+
+    return 1;
+  }
+  source_uri = gst_filename_to_uri (filename, NULL);
+  g_free (filename);
+  profile = transcoder_test_make_profile ("video/quicktime,variant=iso",
+      "video/x-h264", NULL);
+
+  g_print ("%u jobs of %u frames, %u at a time\n", n_jobs, n_frames,
+      max_jobs);
+  run ("new", FALSE, tmpdir, source_uri, profile, n_jobs, max_jobs);
+  run ("recycled", TRUE, tmpdir, source_uri, profile, n_jobs, max_jobs);
+
+  g_object_unref (profile);
+  g_free (source_uri);
+  transcoder_test_remove_dir (tmpdir);
+  g_free (tmpdir);
+
+  return 0;
+}
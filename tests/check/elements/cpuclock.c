@@ -0,0 +1,431 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+#include <gst/check/gstcheck.h>
+
+#include "gst-cpu-throttling-clock.h"
+
+/* CPU time burnt by the simulated pipeline for each frame */
+#define FRAME_COST (2 * GST_MSECOND)
+#define EVALUATION_INTERVAL (GST_SECOND / 4)
+
+/* Usage, in percent, the measure has to stay within once converged */
+#define CONVERGENCE_TOLERANCE 5.0
+/* Maximum time to converge after a start or a target change */
+#define MAX_CONVERGENCE_TIME (2 * GST_SECOND)
+/* How far past the target the usage may go while converging */
+#define MAX_OVERSHOOT 5.0
+
+/* Clock feeding the controller with the CPU time of a simulated pipeline
+ * instead of the one of the process */
+typedef struct
+{
+  GstCpuThrottlingClock parent;
+
+  GstClockTime cpu_time;
+  GstClockTime now;
+} FakeCpuClock;
+
+typedef struct
+{
+  GstCpuThrottlingClockClass parent_class;
+} FakeCpuClockClass;
+
+GType fake_cpu_clock_get_type (void);
+G_DEFINE_TYPE (FakeCpuClock, fake_cpu_clock, GST_TYPE_CPU_THROTTLING_CLOCK);
+
+static GstClockTime
+fake_cpu_clock_get_cpu_time (GstCpuThrottlingClock * clock)
+{
+  return ((FakeCpuClock *) clock)->cpu_time;
+}
+
+static void
+fake_cpu_clock_class_init (FakeCpuClockClass * klass)
+{
+  GST_CPU_THROTTLING_CLOCK_CLASS (klass)->get_cpu_time =
+      fake_cpu_clock_get_cpu_time;
+}
+
+static void
+fake_cpu_clock_init (FakeCpuClock * self)
+{
+}
+
+static gchar *tmpdir;
+
+/* Gives the clock exactly one CPU and no pressure information whatever
+ * the machine running the test */
+static void
+setup (void)
+{
+  gchar *filename;
+
+  tmpdir = g_dir_make_tmp ("cpuclock-XXXXXX", NULL);
+  fail_unless (tmpdir != NULL);
+
+  filename = g_build_filename (tmpdir, "cpu.max", NULL);
+  fail_unless (g_file_set_contents (filename, "100000 100000\n", -1, NULL));
+  g_free (filename);
+}
+
+static void
+teardown (void)
+{
+  gchar *filename = g_build_filename (tmpdir, "cpu.max", NULL);
+
+  g_remove (filename);
+  g_rmdir (tmpdir);
+  g_free (filename);
+  g_free (tmpdir);
+}
+
+static FakeCpuClock *
+fake_cpu_clock_new (guint cpu_usage)
+{
+  FakeCpuClock *clock = g_object_new (fake_cpu_clock_get_type (),
+      "cpu-usage", cpu_usage, "cgroup-path", tmpdir, "psi-path", tmpdir,
+      "stats-interval", (guint64) 0, NULL);
+
+  gst_object_ref_sink (clock);
+
+  /* The first evaluation only starts measuring */
+  clock->now = GST_SECOND;
+  gst_cpu_throttling_clock_evaluate (GST_CPU_THROTTLING_CLOCK (clock),
+      clock->now);
+
+  return clock;
+}
+
+/* Simulates one evaluation interval of a single threaded pipeline that
+ * would use @demand of a CPU unthrottled: each frame burns @frame_cost of
+ * CPU, then waits on the clock and sleeps for as long as it is told to.
+ * Returns the usage measured by the controller. */
+static gdouble
+simulate_interval (FakeCpuClock * clock, gdouble demand,
+    GstClockTime frame_cost)
+{
+  gdouble usage;
+  guint n_sleeps = 0;
+  GstClockTime sleep_time, end = clock->now + EVALUATION_INTERVAL;
+
+  while (clock->now < end) {
+    clock->cpu_time += frame_cost;
+    clock->now += (GstClockTime) (frame_cost / demand);
+
+    sleep_time = gst_cpu_throttling_clock_charge (GST_CPU_THROTTLING_CLOCK
+        (clock), clock->now);
+    if (sleep_time) {
+      clock->now += sleep_time;
+      n_sleeps++;
+    }
+  }
+
+  gst_cpu_throttling_clock_evaluate (GST_CPU_THROTTLING_CLOCK (clock),
+      clock->now);
+
+  g_object_get (clock, "measured-usage", &usage, NULL);
+  GST_DEBUG ("%" GST_TIME_FORMAT ": usage %f, %u sleeps",
+      GST_TIME_ARGS (clock->now), usage, n_sleeps);
+
+  return usage;
+}
+
+/* Runs the simulation for @duration and checks that the measured usage
+ * converges to @target within @max_convergence_time without going further
+ * than MAX_OVERSHOOT past it */
+static void
+check_convergence_full (FakeCpuClock * clock, gdouble target,
+    gdouble demand, GstClockTime frame_cost, GstClockTime duration,
+    GstClockTime max_convergence_time)
+{
+  gdouble usage, first_usage = -1, overshoot = 0;
+  GstClockTime start = clock->now, converged = GST_CLOCK_TIME_NONE;
+
+  while (clock->now < start + duration) {
+    usage = simulate_interval (clock, demand, frame_cost);
+    if (first_usage < 0)
+      first_usage = usage;
+    overshoot = MAX (overshoot, first_usage > target ? target - usage :
+        usage - target);
+
+    if (ABS (usage - target) <= CONVERGENCE_TOLERANCE) {
+      if (!GST_CLOCK_TIME_IS_VALID (converged))
+        converged = clock->now - start;
+    } else {
+      converged = GST_CLOCK_TIME_NONE;
+    }
+  }
+
+  fail_unless (GST_CLOCK_TIME_IS_VALID (converged),
+      "Usage did not converge to %f%% (last %f%%)", target, usage);
+  fail_unless (converged <= max_convergence_time,
+      "Usage converged in %" GST_TIME_FORMAT, GST_TIME_ARGS (converged));
+  fail_unless (overshoot <= MAX_OVERSHOOT,
+      "Usage overshot a %f%% target by %f%%", target, overshoot);
+}
+
+static void
+check_convergence (FakeCpuClock * clock, gdouble target, gdouble demand,
+    GstClockTime duration, GstClockTime max_convergence_time)
+{
+  check_convergence_full (clock, target, demand, FRAME_COST, duration,
+      max_convergence_time);
+}
+
+GST_START_TEST (test_converges_from_cpu_bound)
+{
+  FakeCpuClock *clock = fake_cpu_clock_new (50);
+
+  check_convergence (clock, 50, 1.0, 4 * MAX_CONVERGENCE_TIME,
+      MAX_CONVERGENCE_TIME);
+
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_follows_target_change)
+{
+  FakeCpuClock *clock = fake_cpu_clock_new (75);
+
+  check_convergence (clock, 75, 1.0, 4 * MAX_CONVERGENCE_TIME,
+      MAX_CONVERGENCE_TIME);
+
+  g_object_set (clock, "cpu-usage", 25, NULL);
+  check_convergence (clock, 25, 1.0, 4 * MAX_CONVERGENCE_TIME,
+      MAX_CONVERGENCE_TIME);
+
+  g_object_set (clock, "cpu-usage", 50, NULL);
+  check_convergence (clock, 50, 1.0, 4 * MAX_CONVERGENCE_TIME,
+      MAX_CONVERGENCE_TIME);
+
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_frame_size_independent)
+{
+  FakeCpuClock *clock;
+  guint i, n_sleeps = 0;
+  GstClockTime sleep_time;
+  GstClockTime frame_costs[] = { 100 * GST_USECOND, 20 * GST_MSECOND };
+
+  /* The budget only depends on the CPU used, not on how many times the
+   * pipeline waits on the clock to use it */
+  for (i = 0; i < G_N_ELEMENTS (frame_costs); i++) {
+    clock = fake_cpu_clock_new (50);
+    check_convergence_full (clock, 50, 1.0, frame_costs[i],
+        4 * MAX_CONVERGENCE_TIME, MAX_CONVERGENCE_TIME);
+    gst_object_unref (clock);
+  }
+
+  /* Small frames only sleep once they owe min-sleep-time */
+  clock = fake_cpu_clock_new (50);
+  g_object_set (clock, "min-sleep-time", (guint64) 10 * GST_MSECOND, NULL);
+  for (i = 0; i < 1000; i++) {
+    clock->cpu_time += 100 * GST_USECOND;
+    clock->now += 100 * GST_USECOND;
+    sleep_time = gst_cpu_throttling_clock_charge (GST_CPU_THROTTLING_CLOCK
+        (clock), clock->now);
+    if (sleep_time) {
+      fail_unless (sleep_time >= 10 * GST_MSECOND);
+      clock->now += sleep_time;
+      n_sleeps++;
+    }
+  }
+  /* 100ms of CPU at 50%: 100ms owed, paid in 10ms sleeps */
+  fail_unless (n_sleeps >= 9 && n_sleeps <= 10, "Slept %u times", n_sleeps);
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+static gpointer
+wait_thread (GstClockID id)
+{
+  return GINT_TO_POINTER (gst_clock_id_wait (id, NULL));
+}
+
+GST_START_TEST (test_unschedule_interrupts_sleep)
+{
+  GThread *thread;
+  GstClockID id;
+  GstClockReturn ret;
+  gint64 start;
+  FakeCpuClock *clock = fake_cpu_clock_new (1);
+
+  id = gst_clock_new_single_shot_id (GST_CLOCK (clock), 0);
+
+  /* Starts the budget, then overdraws it by a second of CPU at 1%: the
+   * next wait has to sleep for as long as the clock ever sleeps */
+  fail_unless_equals_int (gst_clock_id_wait (id, NULL), GST_CLOCK_OK);
+  clock->cpu_time += GST_SECOND;
+
+  start = g_get_monotonic_time ();
+  thread = g_thread_new ("wait", (GThreadFunc) wait_thread, id);
+  g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  gst_clock_id_unschedule (id);
+  ret = GPOINTER_TO_INT (g_thread_join (thread));
+
+  fail_unless_equals_int (ret, GST_CLOCK_UNSCHEDULED);
+  fail_unless (g_get_monotonic_time () - start < 500 *
+      G_TIME_SPAN_MILLISECOND, "Unscheduling did not interrupt the sleep");
+
+  gst_clock_id_unref (id);
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_parent_cgroup_quota)
+{
+  gdouble usage;
+  gchar *child, *filename;
+  FakeCpuClock *clock = fake_cpu_clock_new (100);
+
+  /* The quota of a parent applies to an overridden cgroup path too */
+  child = g_build_filename (tmpdir, "child", NULL);
+  fail_unless (g_mkdir (child, 0700) == 0);
+  filename = g_build_filename (child, "cpu.max", NULL);
+  fail_unless (g_file_set_contents (filename, "max 100000\n", -1, NULL));
+  g_object_set (clock, "cgroup-root", tmpdir, "cgroup-path", child, NULL);
+
+  clock->cpu_time += EVALUATION_INTERVAL / 2;
+  clock->now += EVALUATION_INTERVAL;
+  gst_cpu_throttling_clock_evaluate (GST_CPU_THROTTLING_CLOCK (clock),
+      clock->now);
+  g_object_get (clock, "measured-usage", &usage, NULL);
+  fail_unless (ABS (usage - 50) < 0.1, "Measured %f%% of one CPU", usage);
+
+  g_remove (filename);
+  g_rmdir (child);
+  g_free (filename);
+  g_free (child);
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_no_windup_below_target)
+{
+  guint64 wait_time;
+  FakeCpuClock *clock = fake_cpu_clock_new (50);
+
+  /* A pipeline bound by something else than the CPU never gets slowed
+   * down, and does not accumulate a debt to pay once it speeds up */
+  check_convergence (clock, 20, 0.2, 4 * MAX_CONVERGENCE_TIME,
+      EVALUATION_INTERVAL);
+  g_object_get (clock, "wait-time", &wait_time, NULL);
+  fail_unless_equals_uint64 (wait_time, 0);
+
+  check_convergence (clock, 50, 1.0, 4 * MAX_CONVERGENCE_TIME,
+      MAX_CONVERGENCE_TIME);
+
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+/* Simulates a CPU bound pipeline for @duration while the host has tasks
+ * stalled on the CPU @stall percent of the time, as reported by the `cpu`
+ * PSI file, and returns the last measured usage */
+static gdouble
+simulate_cpu_pressure (FakeCpuClock * clock, gdouble stall,
+    GstClockTime duration, guint64 * total)
+{
+  gdouble usage = 0;
+  gchar *filename = g_build_filename (tmpdir, "cpu", NULL);
+  GstClockTime start = clock->now;
+
+  while (clock->now < start + duration) {
+    gchar *contents;
+
+    *total += (guint64) (EVALUATION_INTERVAL / GST_USECOND * stall / 100);
+    contents = g_strdup_printf ("some avg10=%.2f avg60=%.2f avg300=%.2f "
+        "total=%" G_GUINT64_FORMAT "\n"
+        "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n", stall, stall,
+        stall, *total);
+    fail_unless (g_file_set_contents (filename, contents, -1, NULL));
+    g_free (contents);
+
+    usage = simulate_interval (clock, 1.0, FRAME_COST);
+  }
+  g_free (filename);
+
+  return usage;
+}
+
+GST_START_TEST (test_cpu_pressure_backoff)
+{
+  gdouble usage;
+  guint64 total = 0;
+  gchar *filename = g_build_filename (tmpdir, "cpu", NULL);
+  FakeCpuClock *clock = fake_cpu_clock_new (50);
+
+  g_object_set (clock, "cpu-pressure-threshold", 10.0, NULL);
+
+  /* A stall below the threshold leaves the target alone */
+  usage = simulate_cpu_pressure (clock, 5, 4 * MAX_CONVERGENCE_TIME, &total);
+  fail_unless (ABS (usage - 50) <= CONVERGENCE_TOLERANCE,
+      "Usage %f%% with the pressure below the threshold", usage);
+
+  /* Above it the clock backs off by the excess until the stall clears */
+  usage = simulate_cpu_pressure (clock, 40, 4 * MAX_CONVERGENCE_TIME, &total);
+  fail_unless (usage < 50 - 30 + CONVERGENCE_TOLERANCE,
+      "Usage %f%% with the pressure 30%% over the threshold", usage);
+
+  usage = simulate_cpu_pressure (clock, 0, 4 * MAX_CONVERGENCE_TIME, &total);
+  fail_unless (ABS (usage - 50) <= CONVERGENCE_TOLERANCE,
+      "Usage %f%% once the pressure cleared", usage);
+
+  g_remove (filename);
+  g_free (filename);
+  gst_object_unref (clock);
+}
+
+GST_END_TEST;
+
+static Suite *
+cpuclock_suite (void)
+{
+  Suite *s = suite_create ("cpuclock");
+  TCase *tc = tcase_create ("controller");
+
+  suite_add_tcase (s, tc);
+  tcase_add_checked_fixture (tc, setup, teardown);
+  tcase_add_test (tc, test_converges_from_cpu_bound);
+  tcase_add_test (tc, test_follows_target_change);
+  tcase_add_test (tc, test_no_windup_below_target);
+  tcase_add_test (tc, test_frame_size_independent);
+  tcase_add_test (tc, test_unschedule_interrupts_sleep);
+  tcase_add_test (tc, test_parent_cgroup_quota);
+  tcase_add_test (tc, test_cpu_pressure_backoff);
+
+  return s;
+}
+
+GST_CHECK_MAIN (cpuclock);
@@ -0,0 +1,206 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/pbutils/pbutils.h>
+
+#include "transcoder-test-utils.h"
+
+#define N_FRAMES 30
+
+static gchar *tmpdir;
+
+static void
+setup (void)
+{
+  tmpdir = g_dir_make_tmp ("multitranscodebin-XXXXXX", NULL);
+  fail_unless (tmpdir != NULL);
+}
+
+static void
+teardown (void)
+{
+  transcoder_test_remove_dir (tmpdir);
+  g_free (tmpdir);
+}
+
+static void
+set_profiles (GstElement * element, GstEncodingProfile * first, ...)
+{
+  va_list args;
+  GstEncodingProfile *profile;
+  GValue profiles = G_VALUE_INIT;
+
+  g_value_init (&profiles, GST_TYPE_ARRAY);
+  va_start (args, first);
+  for (profile = first; profile; profile = va_arg (args, GstEncodingProfile *)) {
+    GValue value = G_VALUE_INIT;
+
+    g_value_init (&value, GST_TYPE_ENCODING_PROFILE);
+    g_value_take_object (&value, profile);
+    gst_value_array_append_and_take_value (&profiles, &value);
+  }
+  va_end (args);
+
+  g_object_set_property (G_OBJECT (element), "profiles", &profiles);
+  g_value_unset (&profiles);
+}
+
+static void
+add_output (GstElement * pipeline, GstElement * multitranscodebin,
+    const gchar * padname, const gchar * filename)
+{
+  GstElement *sink = gst_element_factory_make ("filesink", NULL);
+
+  g_object_set (sink, "location", filename, NULL);
+  gst_bin_add (GST_BIN (pipeline), sink);
+  fail_unless (gst_element_link_pads (multitranscodebin, padname, sink,
+          "sink"));
+}
+
+static void
+deep_element_added_cb (GstBin * pipeline, GstBin * bin, GstElement * element,
+    gint * n_decoders)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+
+  if (factory && gst_element_factory_list_is_type (factory,
+          GST_ELEMENT_FACTORY_TYPE_DECODER))
+    g_atomic_int_inc (n_decoders);
+}
+
+/* Checks @filename holds a single video stream of @width x @height */
+static void
+check_rendition (const gchar * filename, gint width, gint height)
+{
+  GList *streams;
+  GError *err = NULL;
+  GstDiscoverer *discoverer;
+  GstDiscovererInfo *info;
+  GstClockTime duration;
+  gchar *uri = gst_filename_to_uri (filename, NULL);
+
+  discoverer = gst_discoverer_new (10 * GST_SECOND, &err);
+  fail_unless (discoverer != NULL);
+  info = gst_discoverer_discover_uri (discoverer, uri, &err);
+  fail_unless (info != NULL, "Could not discover %s: %s", uri,
+      err ? err->message : "");
+  fail_unless_equals_int (gst_discoverer_info_get_result (info),
+      GST_DISCOVERER_OK);
+
+  duration = gst_discoverer_info_get_duration (info);
+  fail_unless (duration > 900 * GST_MSECOND &&
+      duration < 1100 * GST_MSECOND, "%s lasts %" GST_TIME_FORMAT, filename,
+      GST_TIME_ARGS (duration));
+
+  streams = gst_discoverer_info_get_video_streams (info);
+  fail_unless_equals_int (g_list_length (streams), 1);
+  fail_unless_equals_int (gst_discoverer_video_info_get_width
+      (streams->data), width);
+  fail_unless_equals_int (gst_discoverer_video_info_get_height
+      (streams->data), height);
+  gst_discoverer_stream_info_list_free (streams);
+
+  gst_discoverer_info_unref (info);
+  gst_object_unref (discoverer);
+  g_free (uri);
+}
+
+GST_START_TEST (test_decode_once_into_two_renditions)
+{
+  GstMessage *msg;
+  GstCaps *caps;
+  gint n_decoders = 0;
+  GstElement *pipeline, *src, *capsfilter, *enc, *multitranscodebin;
+  gchar *large = g_build_filename (tmpdir, "large.mkv", NULL);
+  gchar *small = g_build_filename (tmpdir, "small.mkv", NULL);
+
+  if (!transcoder_test_have_elements ("videotestsrc", "decodebin",
+          "encodebin", "jpegenc", "jpegdec", "matroskamux", "matroskademux",
+          NULL))
+    goto done;
+
+  pipeline = gst_pipeline_new (NULL);
+  src = gst_element_factory_make ("videotestsrc", NULL);
+  g_object_set (src, "num-buffers", N_FRAMES, NULL);
+  capsfilter = gst_element_factory_make ("capsfilter", NULL);
+  caps = gst_caps_from_string ("video/x-raw,width=320,height=240,"
+      "framerate=30/1");
+  g_object_set (capsfilter, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  /* Encoded input, for multitranscodebin to decode */
+  enc = gst_element_factory_make ("jpegenc", NULL);
+  multitranscodebin = gst_element_factory_make ("multitranscodebin", NULL);
+  fail_unless (multitranscodebin != NULL);
+  set_profiles (multitranscodebin,
+      transcoder_test_make_profile ("video/x-matroska", "image/jpeg",
+          "video/x-raw,width=320,height=240"),
+      transcoder_test_make_profile ("video/x-matroska", "image/jpeg",
+          "video/x-raw,width=160,height=120"), NULL);
+
+  gst_bin_add_many (GST_BIN (pipeline), src, capsfilter, enc,
+      multitranscodebin, NULL);
+  fail_unless (gst_element_link_many (src, capsfilter, enc, multitranscodebin,
+          NULL));
+  g_signal_connect (pipeline, "deep-element-added",
+      G_CALLBACK (deep_element_added_cb), &n_decoders);
+  add_output (pipeline, multitranscodebin, "src_0", large);
+  add_output (pipeline, multitranscodebin, "src_1", small);
+
+  fail_unless (gst_element_set_state (pipeline, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  /* The stream is decoded once and teed to both renditions */
+  fail_unless_equals_int (n_decoders, 1);
+  check_rendition (large, 320, 240);
+  check_rendition (small, 160, 120);
+
+done:
+  g_free (large);
+  g_free (small);
+}
+
+GST_END_TEST;
+
+static Suite *
+multitranscodebin_suite (void)
+{
+  Suite *s = suite_create ("multitranscodebin");
+  TCase *tc = tcase_create ("general");
+
+  suite_add_tcase (s, tc);
+  tcase_set_timeout (tc, 60);
+  tcase_add_checked_fixture (tc, setup, teardown);
+  tcase_add_test (tc, test_decode_once_into_two_renditions);
+
+  return s;
+}
+
+GST_CHECK_MAIN (multitranscodebin);
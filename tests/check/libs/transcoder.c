@@ -0,0 +1,151 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/check/gstcheck.h>
+#include <gst/pbutils/pbutils.h>
+#include <gst/transcoding/transcoder/gsttranscoder.h>
+
+#include "transcoder-test-utils.h"
+
+/* 5 seconds with a keyframe every second */
+#define SOURCE_PIPELINE "videotestsrc num-buffers=150 ! " \
+  "video/x-raw,width=320,height=240,framerate=30/1 ! " \
+  "x264enc key-int-max=30 ! h264parse ! mp4mux ! filesink location=\"%s\""
+
+static gchar *tmpdir;
+
+static void
+setup (void)
+{
+  tmpdir = g_dir_make_tmp ("transcoder-XXXXXX", NULL);
+  fail_unless (tmpdir != NULL);
+}
+
+static void
+teardown (void)
+{
+  transcoder_test_remove_dir (tmpdir);
+  g_free (tmpdir);
+}
+
+static gchar *
+make_h264_mp4 (void)
+{
+  GError *err = NULL;
+  gchar *filename = g_build_filename (tmpdir, "source.mp4", NULL);
+  gchar *description = g_strdup_printf (SOURCE_PIPELINE, filename);
+  gchar *uri = gst_filename_to_uri (filename, NULL);
+
+  fail_unless (transcoder_test_run_pipeline (description, &err),
+      "Could not run %s: %s", description, err ? err->message : "");
+
+  g_free (description);
+  g_free (filename);
+
+  return uri;
+}
+
+GST_START_TEST (test_smart_render_trims_h264_mp4)
+{
+  GList *streams;
+  GstCaps *caps;
+  GstElement *pipeline;
+  GError *err = NULL;
+  GstClockTime duration;
+  GstTranscoder *transcoder;
+  GstDiscoverer *discoverer;
+  GstDiscovererInfo *info;
+  GstEncodingProfile *profile;
+  gchar *source_uri, *dest_uri, *filename;
+
+  if (!transcoder_test_have_elements ("videotestsrc", "x264enc", "h264parse", "mp4mux",
+          "qtdemux", "avdec_h264", "concat", NULL))
+    return;
+
+  source_uri = make_h264_mp4 ();
+  filename = g_build_filename (tmpdir, "trimmed.mp4", NULL);
+  dest_uri = gst_filename_to_uri (filename, NULL);
+  profile = transcoder_test_make_profile ("video/quicktime,variant=iso",
+      "video/x-h264", NULL);
+
+  /* Cuts in the middle of the second and fourth GOPs, so that the head and
+   * tail are re-encoded and the third GOP is copied. The copied range must
+   * be remuxed by its own segment, not split again */
+  transcoder = gst_transcoder_new_full (source_uri, dest_uri, profile, NULL);
+  gst_transcoder_set_avoid_reencoding (transcoder, TRUE);
+  pipeline = gst_transcoder_get_pipeline (transcoder);
+  g_object_set (pipeline, "start-time", 1500 * GST_MSECOND,
+      "stop-time", 3500 * GST_MSECOND, NULL);
+  gst_object_unref (pipeline);
+
+  fail_unless (gst_transcoder_run (transcoder, &err), "Trimming failed: %s",
+      err ? err->message : "");
+  gst_object_unref (transcoder);
+
+  discoverer = gst_discoverer_new (10 * GST_SECOND, &err);
+  fail_unless (discoverer != NULL);
+  info = gst_discoverer_discover_uri (discoverer, dest_uri, &err);
+  fail_unless (info != NULL, "Could not discover %s: %s", dest_uri,
+      err ? err->message : "");
+  fail_unless_equals_int (gst_discoverer_info_get_result (info),
+      GST_DISCOVERER_OK);
+
+  duration = gst_discoverer_info_get_duration (info);
+  fail_unless (duration > 1900 * GST_MSECOND &&
+      duration < 2100 * GST_MSECOND, "Trimmed to %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (duration));
+
+  streams = gst_discoverer_info_get_video_streams (info);
+  fail_unless_equals_int (g_list_length (streams), 1);
+  caps = gst_discoverer_stream_info_get_caps (streams->data);
+  fail_unless (gst_structure_has_name (gst_caps_get_structure (caps, 0),
+          "video/x-h264"));
+  gst_caps_unref (caps);
+  gst_discoverer_stream_info_list_free (streams);
+
+  gst_discoverer_info_unref (info);
+  gst_object_unref (discoverer);
+  g_object_unref (profile);
+  g_free (source_uri);
+  g_free (dest_uri);
+  g_free (filename);
+}
+
+GST_END_TEST;
+
+static Suite *
+transcoder_suite (void)
+{
+  Suite *s = suite_create ("transcoder");
+  TCase *tc = tcase_create ("smart-render");
+
+  suite_add_tcase (s, tc);
+  tcase_set_timeout (tc, 120);
+  tcase_add_checked_fixture (tc, setup, teardown);
+  tcase_add_test (tc, test_smart_render_trims_h264_mp4);
+
+  return s;
+}
+
+GST_CHECK_MAIN (transcoder);
@@ -0,0 +1,128 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <glib/gstdio.h>
+
+#include "transcoder-test-utils.h"
+
+/* Whether all the element factories are installed, the tests needing them
+ * are skipped otherwise */
+gboolean
+transcoder_test_have_elements (const gchar * first, ...)
+{
+  va_list args;
+  const gchar *name;
+  gboolean res = TRUE;
+
+  va_start (args, first);
+  for (name = first; name && res; name = va_arg (args, const gchar *)) {
+    GstElementFactory *factory = gst_element_factory_find (name);
+
+    if (!factory)
+      GST_INFO ("Missing %s, skipping", name);
+    res = factory != NULL;
+    if (factory)
+      gst_object_unref (factory);
+  }
+  va_end (args);
+
+  return res;
+}
+
+/* Runs the gst-launch style @description until EOS */
+gboolean
+transcoder_test_run_pipeline (const gchar * description, GError ** error)
+{
+  GstMessage *msg;
+  GstElement *pipeline;
+  gboolean res;
+
+  pipeline = gst_parse_launch (description, error);
+  if (!pipeline)
+    return FALSE;
+
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE) {
+    g_set_error (error, GST_CORE_ERROR, GST_CORE_ERROR_STATE_CHANGE,
+        "Could not start %s", description);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+    gst_object_unref (pipeline);
+
+    return FALSE;
+  }
+
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  res = GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS;
+  if (!res)
+    gst_message_parse_error (msg, error, NULL);
+  gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return res;
+}
+
+/* Removes @dirname and the files it contains */
+void
+transcoder_test_remove_dir (const gchar * dirname)
+{
+  const gchar *name;
+  GDir *dir = g_dir_open (dirname, 0, NULL);
+
+  while (dir && (name = g_dir_read_name (dir))) {
+    gchar *filename = g_build_filename (dirname, name, NULL);
+
+    g_remove (filename);
+    g_free (filename);
+  }
+  if (dir)
+    g_dir_close (dir);
+  g_rmdir (dirname);
+}
+
+/* A @container profile with a single @video_format stream, restricted to
+ * @video_restriction when not %NULL */
+GstEncodingProfile *
+transcoder_test_make_profile (const gchar * container,
+    const gchar * video_format, const gchar * video_restriction)
+{
+  GstCaps *caps = gst_caps_from_string (container);
+  GstCaps *restriction = video_restriction ?
+      gst_caps_from_string (video_restriction) : NULL;
+  GstEncodingContainerProfile *profile =
+      gst_encoding_container_profile_new (NULL, NULL, caps, NULL);
+
+  gst_caps_unref (caps);
+  caps = gst_caps_from_string (video_format);
+  gst_encoding_container_profile_add_profile (profile,
+      (GstEncodingProfile *) gst_encoding_video_profile_new (caps, NULL,
+          restriction, 0));
+  gst_caps_unref (caps);
+  if (restriction)
+    gst_caps_unref (restriction);
+
+  return (GstEncodingProfile *) profile;
+}
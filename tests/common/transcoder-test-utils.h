@@ -0,0 +1,42 @@
+/* GStreamer
+ *
+ * Copyright (C) 2015 Thibault Saunier <tsaunier@gnome.org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Fixtures shared by the tests and the benchmarks */
+
+#ifndef __TRANSCODER_TEST_UTILS_H__
+#define __TRANSCODER_TEST_UTILS_H__
+
+#include <gst/gst.h>
+#include <gst/pbutils/pbutils.h>
+
+G_BEGIN_DECLS
+
+gboolean             transcoder_test_have_elements      (const gchar * first,
+                                                         ...) G_GNUC_NULL_TERMINATED;
+gboolean             transcoder_test_run_pipeline       (const gchar * description,
+                                                         GError ** error);
+void                 transcoder_test_remove_dir         (const gchar * dirname);
+GstEncodingProfile * transcoder_test_make_profile       (const gchar * container,
+                                                         const gchar * video_format,
+                                                         const gchar * video_restriction);
+
+G_END_DECLS
+
+#endif /* __TRANSCODER_TEST_UTILS_H__ */
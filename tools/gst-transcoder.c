@@ -22,6 +22,7 @@
 
 #include "utils.h"
 #include "../gst-libs/gst/transcoding/transcoder/gsttranscoder.h"
+#include "../gst-libs/gst/transcoding/transcoder/gsttranscoderpool.h"
 
 static const gchar *HELP_SUMMARY =
     "gst-transcoder-1.0 transcodes a stream defined by its first <input-uri>\n"
@@ -54,15 +55,36 @@ static const gchar *HELP_SUMMARY =
     "\n"
     "Encoding targets describe well known formats which\n"
     "those are provided in '.gep' files. You can list\n"
-    "available ones using the `--list` argument.\n";
+    "available ones using the `--list` argument.\n"
+    "\n"
+    "Batch mode\n"
+    "==========\n"
+    "\n"
+    "With `--batch <manifest>` the jobs are read from the manifest instead\n"
+    "of the command line, one job per line in the CSV form:\n"
+    "\n"
+    "    <input>,<output>[,<encoding-format>[,<size>[,<framerate>[,<rate>]]]]\n"
+    "\n"
+    "Empty fields fall back to the command line options, empty lines\n"
+    "and lines starting with '#' are ignored. `--jobs` sets how many\n"
+    "files are transcoded at the same time, and `--threads` how many\n"
+    "threads their encoders and decoders share. With `--recycle` the\n"
+    "pipeline of a finished job is reused by the next one, which makes\n"
+    "batches of short files with the same format faster.\n";
 
 typedef struct
 {
   gint cpu_usage, rate;
+  gint parallel_segments;
+  gint jobs, threads;
+  gdouble cpu_pressure, io_pressure, memory_pressure;
+  gboolean recycle;
   gboolean list;
   GstEncodingProfile *profile;
   gchar *src_uri, *dest_uri, *encoding_format, *size;
   gchar *framerate;
+  gchar *batch;
+  gchar **selection;
 } Settings;
 
 static void
@@ -70,6 +92,8 @@ settings_init (Settings * settings)
 {
   settings->cpu_usage = 100;
   settings->rate = -1;
+  settings->parallel_segments = 1;
+  settings->jobs = 1;
   settings->encoding_format = NULL;
   settings->size = NULL;
   settings->framerate = NULL;
@@ -79,9 +103,13 @@ static void
 position_updated_cb (GstTranscoder * transcoder, GstClockTime pos)
 {
   GstClockTime dur = -1;
+  gboolean remuxing = FALSE;
   gchar status[64] = { 0, };
+  GstElement *pipeline = gst_transcoder_get_pipeline (transcoder);
 
   g_object_get (transcoder, "duration", &dur, NULL);
+  g_object_get (pipeline, "remuxing", &remuxing, NULL);
+  gst_object_unref (pipeline);
 
   memset (status, ' ', sizeof (status) - 1);
 
@@ -93,7 +121,8 @@ position_updated_cb (GstTranscoder * transcoder, GstClockTime pos)
     pstr[9] = '\0';
     g_snprintf (dstr, 32, "%" GST_TIME_FORMAT, GST_TIME_ARGS (dur));
     dstr[9] = '\0';
-    g_print ("%s / %s %s\r", pstr, dstr, status);
+    g_print ("%s / %s (%s) %s\r", pstr, dstr,
+        remuxing ? "remux" : "transcode", status);
   }
 }
 
@@ -210,6 +239,9 @@ list_encoding_targets (void)
 {
   GList *tmp, *targets = gst_encoding_list_all_targets (NULL);
 
+  /* Probes all the profiles at once, in parallel, when not cached yet */
+  probe_encoding_targets (targets);
+
   for (tmp = targets; tmp; tmp = tmp->next) {
     GstEncodingTarget *target = tmp->data;
     GList *usable_profiles = get_usable_profiles (target);
@@ -222,10 +254,18 @@ list_encoding_targets (void)
           gst_encoding_target_get_category (target),
           gst_encoding_target_get_description (target));
 
-      for (tmpprof = usable_profiles; tmpprof; tmpprof = tmpprof->next)
-        g_print ("     - %s: %s",
-            gst_encoding_profile_get_name (tmpprof->data),
+      for (tmpprof = usable_profiles; tmpprof; tmpprof = tmpprof->next) {
+        gchar **factories = get_profile_factories (target, tmpprof->data);
+        gchar *factories_str = factories ? g_strjoinv (", ", factories) :
+            NULL;
+
+        g_print ("     - %s: %s", gst_encoding_profile_get_name (tmpprof->data),
             gst_encoding_profile_get_description (tmpprof->data));
+        if (factories_str && *factories_str)
+          g_print (" (%s)", factories_str);
+        g_free (factories_str);
+        g_strfreev (factories);
+      }
 
       g_print ("\n");
       g_list_free (usable_profiles);
@@ -284,6 +324,156 @@ _warning_cb (GstTranscoder * transcoder, GError * error, GstStructure * details)
   warn ("Got warning: %s", error->message);
 }
 
+static void
+_job_error_cb (GstTranscoderPool * pool, guint job_id, GError * err,
+    GstStructure * details)
+{
+  error ("Job %u FAILED: %s", job_id, err->message);
+}
+
+static void
+_job_started_cb (GstTranscoderPool * pool, guint job_id,
+    GstTranscoder * transcoder, Settings * settings)
+{
+  gst_transcoder_set_stream_selection (transcoder,
+      (const gchar * const *) settings->selection);
+  gst_transcoder_set_pressure_thresholds (transcoder, settings->cpu_pressure,
+      settings->io_pressure, settings->memory_pressure);
+}
+
+static void
+_job_done_cb (GstTranscoderPool * pool, guint job_id)
+{
+  ok ("Job %u DONE.", job_id);
+}
+
+static gboolean
+push_batch_job (GstTranscoderPool * pool, Settings * defaults, gchar * line)
+{
+  gchar **fields = g_strsplit (line, ",", 6);
+  Settings settings = *defaults;
+  gboolean res = FALSE;
+  guint i, job_id;
+
+  for (i = 0; fields[i]; i++)
+    g_strstrip (fields[i]);
+
+  if (i < 2 || !*fields[0] || !*fields[1]) {
+    error ("Invalid batch job '%s', expected at least"
+        " <input>,<output>", line);
+    goto done;
+  }
+
+  settings.src_uri = ensure_uri (fields[0]);
+  settings.dest_uri = ensure_uri (fields[1]);
+  if (i > 2 && *fields[2])
+    settings.encoding_format = fields[2];
+  if (i > 3 && *fields[3])
+    settings.size = fields[3];
+  if (i > 4 && *fields[4])
+    settings.framerate = fields[4];
+  if (i > 5 && *fields[5])
+    settings.rate = g_ascii_strtoll (fields[5], NULL, 10);
+
+  if (!settings.encoding_format)
+    settings.encoding_format = get_file_extension (settings.dest_uri);
+
+  if (settings.encoding_format)
+    settings.profile = create_encoding_profile (settings.encoding_format);
+
+  if (!settings.profile) {
+    error ("Could not find any encoding format for %s", settings.dest_uri);
+    goto done;
+  }
+
+  if (!set_video_settings (&settings) || !set_audio_settings (&settings))
+    goto done;
+
+  job_id = gst_transcoder_pool_push (pool, settings.src_uri,
+      settings.dest_uri, settings.profile, 0);
+  ok ("Job %u: %s -> %s", job_id, settings.src_uri, settings.dest_uri);
+  res = TRUE;
+
+done:
+  if (settings.profile)
+    g_object_unref (settings.profile);
+  g_free (settings.src_uri);
+  g_free (settings.dest_uri);
+  g_strfreev (fields);
+
+  return res;
+}
+
+static gint
+run_batch (Settings * settings)
+{
+  gint res = 0;
+  gchar *contents, **lines;
+  GError *err = NULL;
+  GstTranscoderPool *pool;
+  GstStructure *stats;
+  GstClockTime elapsed, transcoded;
+  guint i, done, failed, recycled, invalid = 0;
+
+  if (!g_file_get_contents (settings->batch, &contents, NULL, &err)) {
+    error ("Could not read batch manifest: %s", err->message);
+    g_clear_error (&err);
+
+    return 1;
+  }
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  pool = gst_transcoder_pool_new (MAX (settings->jobs, 1));
+  gst_transcoder_pool_set_cpu_usage (pool, settings->cpu_usage);
+  gst_transcoder_pool_set_recycle (pool, settings->recycle);
+  gst_transcoder_pool_set_max_threads (pool, MAX (settings->threads, 0));
+  g_signal_connect (pool, "job-started", G_CALLBACK (_job_started_cb),
+      settings);
+  g_signal_connect (pool, "job-done", G_CALLBACK (_job_done_cb), NULL);
+  g_signal_connect (pool, "job-error", G_CALLBACK (_job_error_cb), NULL);
+
+  for (i = 0; lines[i]; i++) {
+    gchar *line = g_strstrip (lines[i]);
+
+    if (!*line || *line == '#')
+      continue;
+
+    if (!push_batch_job (pool, settings, line))
+      invalid++;
+  }
+  g_strfreev (lines);
+
+  gst_transcoder_pool_wait (pool);
+
+  stats = gst_transcoder_pool_get_stats (pool);
+  gst_structure_get (stats, "done", G_TYPE_UINT, &done,
+      "failed", G_TYPE_UINT, &failed,
+      "recycled", G_TYPE_UINT, &recycled,
+      "elapsed", GST_TYPE_CLOCK_TIME, &elapsed,
+      "transcoded-duration", GST_TYPE_CLOCK_TIME, &transcoded, NULL);
+  gst_structure_free (stats);
+  gst_object_unref (pool);
+
+  g_print ("\nTranscoded %u file(s) in %" GST_TIME_FORMAT "\n", done,
+      GST_TIME_ARGS (elapsed));
+  if (elapsed) {
+    g_print ("  %.2f files/hour, %.2fx realtime\n",
+        (gdouble) done * 3600 * GST_SECOND / elapsed,
+        (gdouble) transcoded / elapsed);
+  }
+  if (recycled)
+    g_print ("  %u job(s) reused the pipeline of a previous job\n", recycled);
+
+  if (failed || invalid) {
+    error ("  %u job(s) failed, %u invalid manifest line(s)", failed, invalid);
+    res = 1;
+  }
+
+  return res;
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -309,6 +499,32 @@ main (int argc, char *argv[])
           " or a single number (24 for 24fps))", NULL},
     {"video-encoder", 'v', 0, G_OPTION_ARG_STRING, &settings.size,
         "The video encoder to use.", NULL},
+    {"parallel-segments", 0, 0, G_OPTION_ARG_INT, &settings.parallel_segments,
+        "Split the input at keyframes in that many segments transcoded"
+          " in parallel", NULL},
+    {"batch", 'b', 0, G_OPTION_ARG_FILENAME, &settings.batch,
+        "Read the jobs to run from a CSV manifest", "<manifest>"},
+    {"jobs", 'j', 0, G_OPTION_ARG_INT, &settings.jobs,
+        "The number of batch jobs to run at the same time", NULL},
+    {"threads", 0, 0, G_OPTION_ARG_INT, &settings.threads,
+        "The number of threads the encoders and decoders of the batch jobs"
+          " share (default: the number of processors)", NULL},
+    {"recycle", 0, 0, G_OPTION_ARG_NONE, &settings.recycle,
+        "Reuse the pipeline of a finished batch job for the next one", NULL},
+    {"cpu-pressure", 0, 0, G_OPTION_ARG_DOUBLE, &settings.cpu_pressure,
+        "Slow down when tasks of the host are stalled waiting for a CPU"
+          " more than that percentage of the time", "<percent>"},
+    {"io-pressure", 0, 0, G_OPTION_ARG_DOUBLE, &settings.io_pressure,
+        "Slow down when tasks of the host are stalled waiting for I/O"
+          " more than that percentage of the time", "<percent>"},
+    {"memory-pressure", 0, 0, G_OPTION_ARG_DOUBLE, &settings.memory_pressure,
+        "Slow down when tasks of the host are stalled waiting for memory"
+          " more than that percentage of the time", "<percent>"},
+    {"select", 'S', 0, G_OPTION_ARG_STRING_ARRAY, &settings.selection,
+        "Only transcode the streams matching the selector, can be repeated."
+          " A selector is id:<stream-id>, a stream type (video, audio, text),"
+          " or a type followed by an index or a language code"
+          " (audio:1, audio:en)", "<selector>"},
     {NULL}
   };
 
@@ -334,6 +550,14 @@ main (int argc, char *argv[])
     return 0;
   }
 
+  if (settings.batch) {
+    g_option_context_free (ctx);
+    res = run_batch (&settings);
+    g_free (settings.batch);
+
+    return res;
+  }
+
   if (argc < 3 || argc > 4) {
     g_print ("%s", g_option_context_get_help (ctx, TRUE, NULL));
     g_option_context_free (ctx);
@@ -378,6 +602,12 @@ main (int argc, char *argv[])
   gst_transcoder_set_avoid_reencoding (transcoder, TRUE);
 
   gst_transcoder_set_cpu_usage (transcoder, settings.cpu_usage);
+  gst_transcoder_set_parallel_segments (transcoder,
+      MAX (settings.parallel_segments, 1));
+  gst_transcoder_set_stream_selection (transcoder,
+      (const gchar * const *) settings.selection);
+  gst_transcoder_set_pressure_thresholds (transcoder, settings.cpu_pressure,
+      settings.io_pressure, settings.memory_pressure);
   g_signal_connect (transcoder, "position-updated",
       G_CALLBACK (position_updated_cb), NULL);
   g_signal_connect (transcoder, "warning", G_CALLBACK (_warning_cb), NULL);
@@ -387,8 +617,17 @@ main (int argc, char *argv[])
 
   ok ("Starting transcoding...");
   gst_transcoder_run (transcoder, &err);
-  if (!err)
+  if (!err) {
+    guint skipped_streams = 0;
+    GstElement *pipeline = gst_transcoder_get_pipeline (transcoder);
+
     ok ("\nDONE.");
+    g_object_get (pipeline, "skipped-streams", &skipped_streams, NULL);
+    if (skipped_streams)
+      ok ("%u stream(s) not in the encoding format were skipped without"
+          " being decoded.", skipped_streams);
+    gst_object_unref (pipeline);
+  }
 
 done:
   g_free (settings.dest_uri);
@@ -1,6 +1,8 @@
 #include <string.h>
+#include <glib/gstdio.h>
 
 #include "utils.h"
+#include "../gst-libs/gst/transcoding/transcoder/gsttranscoder.h"
 
 void
 print (GstDebugColorFlags c, gboolean err, gboolean nline, const gchar * format,
@@ -102,56 +104,240 @@ get_file_extension (gchar * uri)
   return &uri[find + 1];
 }
 
-GList *
-get_usable_profiles (GstEncodingTarget * target)
+/*********** Usable profiles cache ***********/
+/* Expanding a profile in an encodebin to check whether it is usable is
+ * slow, the results are cached on disk, keyed by the plugins and the
+ * encoding target files installed */
+#define CACHE_GROUP "cache"
+
+static GMutex cache_lock;
+static GKeyFile *profiles_cache = NULL;
+static gchar *cache_filename = NULL;
+
+typedef struct
 {
-  GList *tmpprof, *usable_profiles = NULL;
+  GstEncodingProfile *profile;
+  gchar *group;
+} ProfileProbe;
 
-  for (tmpprof = (GList *) gst_encoding_target_get_profiles (target);
-      tmpprof; tmpprof = tmpprof->next) {
-    GstEncodingProfile *profile = tmpprof->data;
-    GstElement *tmpencodebin = gst_element_factory_make ("encodebin", NULL);
-
-    gst_encoding_profile_set_presence (profile, 1);
-    if (GST_IS_ENCODING_CONTAINER_PROFILE (profile)) {
-      GList *tmpsubprof;
-      for (tmpsubprof = (GList *)
-          gst_encoding_container_profile_get_profiles
-          (GST_ENCODING_CONTAINER_PROFILE (profile)); tmpsubprof;
-          tmpsubprof = tmpsubprof->next)
-        gst_encoding_profile_set_presence (tmpsubprof->data, 1);
+/* Identifies the state of the registry and of the encoding targets */
+static gchar *
+compute_cache_fingerprint (void)
+{
+  gchar *res;
+  GList *tmp, *plugins;
+  GChecksum *checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  gchar *version = gst_version_string ();
+
+  g_checksum_update (checksum, (const guchar *) version, -1);
+  g_free (version);
+
+  plugins = gst_registry_get_plugin_list (gst_registry_get ());
+  for (tmp = plugins; tmp; tmp = tmp->next) {
+    GStatBuf st;
+    gchar *entry;
+    const gchar *filename = gst_plugin_get_filename (tmp->data);
+
+    entry = g_strdup_printf ("%s:%s:%s:%" G_GINT64_FORMAT ";",
+        gst_plugin_get_name (tmp->data), gst_plugin_get_version (tmp->data),
+        GST_STR_NULL (filename), filename && !g_stat (filename, &st) ?
+        (gint64) st.st_mtime : (gint64) 0);
+    g_checksum_update (checksum, (const guchar *) entry, -1);
+    g_free (entry);
+  }
+  gst_plugin_list_free (plugins);
+
+  gst_transcoder_checksum_encoding_targets (checksum);
+
+  res = g_strdup (g_checksum_get_string (checksum));
+  g_checksum_free (checksum);
+
+  return res;
+}
+
+/* Must be called with the cache lock */
+static void
+load_profiles_cache (void)
+{
+  gchar *fingerprint, *cached;
+
+  if (profiles_cache)
+    return;
+
+  cache_filename = g_build_filename (g_get_user_cache_dir (),
+      "gst-transcoder", "usable-profiles.cache", NULL);
+  profiles_cache = g_key_file_new ();
+  fingerprint = compute_cache_fingerprint ();
+
+  g_key_file_load_from_file (profiles_cache, cache_filename,
+      G_KEY_FILE_NONE, NULL);
+  cached = g_key_file_get_string (profiles_cache, CACHE_GROUP, "fingerprint",
+      NULL);
+  if (g_strcmp0 (cached, fingerprint)) {
+    GST_INFO ("Usable profiles cache is outdated, probing all profiles");
+    g_key_file_free (profiles_cache);
+    profiles_cache = g_key_file_new ();
+    g_key_file_set_string (profiles_cache, CACHE_GROUP, "fingerprint",
+        fingerprint);
+  }
+
+  g_free (cached);
+  g_free (fingerprint);
+}
+
+static gchar *
+get_profile_group (GstEncodingTarget * target, GstEncodingProfile * profile)
+{
+  return g_strdup_printf ("%s/%s/%s", gst_encoding_target_get_category
+      (target), gst_encoding_target_get_name (target),
+      gst_encoding_profile_get_name (profile));
+}
+
+static void
+probe_profile (ProfileProbe * probe, gpointer udata)
+{
+  GValue item = G_VALUE_INIT;
+  GstIterator *it;
+  GPtrArray *factories = g_ptr_array_new ();
+  GstEncodingProfile *profile = probe->profile;
+  GstElement *tmpencodebin = gst_element_factory_make ("encodebin", NULL);
+
+  gst_encoding_profile_set_presence (profile, 1);
+  if (GST_IS_ENCODING_CONTAINER_PROFILE (profile)) {
+    GList *tmpsubprof;
+    for (tmpsubprof = (GList *)
+        gst_encoding_container_profile_get_profiles
+        (GST_ENCODING_CONTAINER_PROFILE (profile)); tmpsubprof;
+        tmpsubprof = tmpsubprof->next)
+      gst_encoding_profile_set_presence (tmpsubprof->data, 1);
+  }
+
+  g_object_set (tmpencodebin, "profile", profile, NULL);
+
+  /* The element factories the profile resolves to */
+  it = gst_bin_iterate_recurse (GST_BIN (tmpencodebin));
+  while (gst_iterator_next (it, &item) == GST_ITERATOR_OK) {
+    GstElementFactory *factory =
+        gst_element_get_factory (g_value_get_object (&item));
+
+    if (factory && !GST_IS_BIN (g_value_get_object (&item)))
+      g_ptr_array_add (factories, (gpointer)
+          gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory)));
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (it);
+  g_ptr_array_add (factories, NULL);
+
+  g_mutex_lock (&cache_lock);
+  /* The profile could be expended */
+  g_key_file_set_boolean (profiles_cache, probe->group, "usable",
+      GST_BIN (tmpencodebin)->children != NULL);
+  g_key_file_set_string_list (profiles_cache, probe->group, "factories",
+      (const gchar * const *) factories->pdata, factories->len - 1);
+  g_mutex_unlock (&cache_lock);
+
+  g_ptr_array_free (factories, TRUE);
+  gst_object_unref (tmpencodebin);
+  g_free (probe->group);
+  g_free (probe);
+}
+
+void
+probe_encoding_targets (GList * targets)
+{
+  GList *tmp, *tmpprof;
+  GThreadPool *pool = NULL;
+  gboolean updated = FALSE;
+
+  g_mutex_lock (&cache_lock);
+  load_profiles_cache ();
+  g_mutex_unlock (&cache_lock);
+
+  for (tmp = targets; tmp; tmp = tmp->next) {
+    for (tmpprof = (GList *) gst_encoding_target_get_profiles (tmp->data);
+        tmpprof; tmpprof = tmpprof->next) {
+      ProfileProbe *probe;
+      gchar *group = get_profile_group (tmp->data, tmpprof->data);
+
+      g_mutex_lock (&cache_lock);
+      if (g_key_file_has_group (profiles_cache, group)) {
+        g_mutex_unlock (&cache_lock);
+        g_free (group);
+        continue;
+      }
+      g_mutex_unlock (&cache_lock);
+
+      if (!pool)
+        pool = g_thread_pool_new ((GFunc) probe_profile, NULL,
+            g_get_num_processors (), FALSE, NULL);
+
+      probe = g_new0 (ProfileProbe, 1);
+      probe->profile = tmpprof->data;
+      probe->group = group;
+      g_thread_pool_push (pool, probe, NULL);
+      updated = TRUE;
     }
+  }
 
-    g_object_set (tmpencodebin, "profile", gst_object_ref (profile), NULL);
-    GST_DEBUG_BIN_TO_DOT_FILE_WITH_TS (GST_BIN (tmpencodebin),
-        GST_DEBUG_GRAPH_SHOW_ALL, gst_encoding_profile_get_name (profile));
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
 
-    /* The profile could be expended */
-    if (GST_BIN (tmpencodebin)->children)
-      usable_profiles = g_list_prepend (usable_profiles, profile);
+  if (updated) {
+    gchar *dirname = g_path_get_dirname (cache_filename);
 
-    gst_object_unref (tmpencodebin);
+    g_mkdir_with_parents (dirname, 0755);
+    g_mutex_lock (&cache_lock);
+    if (!g_key_file_save_to_file (profiles_cache, cache_filename, NULL))
+      GST_INFO ("Could not save usable profiles cache to %s", cache_filename);
+    g_mutex_unlock (&cache_lock);
+    g_free (dirname);
   }
+}
 
-  return usable_profiles;
+gchar **
+get_profile_factories (GstEncodingTarget * target,
+    GstEncodingProfile * profile)
+{
+  gchar **factories;
+  gchar *group = get_profile_group (target, profile);
+
+  g_mutex_lock (&cache_lock);
+  factories = profiles_cache ? g_key_file_get_string_list (profiles_cache,
+      group, "factories", NULL, NULL) : NULL;
+  g_mutex_unlock (&cache_lock);
+  g_free (group);
+
+  return factories;
 }
 
-GstEncodingProfile *
-create_encoding_profile (const gchar * pname)
+GList *
+get_usable_profiles (GstEncodingTarget * target)
 {
-  GstEncodingProfile *profile;
-  GValue value = G_VALUE_INIT;
+  GList *tmpprof, *usable_profiles = NULL;
+  GList targets = { target, NULL, NULL };
 
-  g_value_init (&value, GST_TYPE_ENCODING_PROFILE);
+  probe_encoding_targets (&targets);
 
-  if (!gst_value_deserialize (&value, pname)) {
-    g_value_reset (&value);
+  for (tmpprof = (GList *) gst_encoding_target_get_profiles (target);
+      tmpprof; tmpprof = tmpprof->next) {
+    gboolean usable;
+    gchar *group = get_profile_group (target, tmpprof->data);
 
-    return NULL;
+    g_mutex_lock (&cache_lock);
+    usable = g_key_file_get_boolean (profiles_cache, group, "usable", NULL);
+    g_mutex_unlock (&cache_lock);
+    g_free (group);
+
+    if (usable)
+      usable_profiles = g_list_prepend (usable_profiles, tmpprof->data);
   }
 
-  profile = g_value_dup_object (&value);
-  g_value_reset (&value);
+  return usable_profiles;
+}
 
-  return profile;
+GstEncodingProfile *
+create_encoding_profile (const gchar * pname)
+{
+  return gst_transcoder_profile_cache_get (pname);
 }
@@ -13,7 +13,9 @@ void error (const gchar * format, ...);
 gchar * ensure_uri (const gchar * location);
 gchar * get_file_extension (gchar * uri);
 
+void probe_encoding_targets (GList * targets);
 GList * get_usable_profiles (GstEncodingTarget * target);
+gchar ** get_profile_factories (GstEncodingTarget * target, GstEncodingProfile * profile);
 GstEncodingProfile * create_encoding_profile (const gchar * pname);
 
 #endif /*__GST_TRANSCODER_UTILS_H*/